@@ -0,0 +1,31 @@
+#!/bin/bash
+# 短连接（每个请求新建连接）压测接入路径：对比三种接入方式，以及每轮accept上限对长连接延迟的影响
+# 用法: bench/accept_bench.sh [连接数] [秒数] [reactor数]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-512}
+SECS=${2:-10}
+LOOPS=${3:-4}
+PORT=1397
+
+run() {
+    ./bin/server -p $PORT -l $LOOPS "$@" > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    printf "%-28s short: " "$*"
+    ./bench/loadgen -p $PORT -c $CONNS -t 4 -d $SECS -k 0
+    # 接入风暴期间长连接的延迟
+    ./bench/loadgen -p $PORT -c $CONNS -t 2 -d $SECS -k 0 > /dev/null &
+    local storm=$!
+    printf "%-28s keep-alive under storm: " ""
+    ./bench/loadgen -p $PORT -c 64 -t 2 -d $SECS
+    wait $storm
+    kill $pid
+    wait $pid 2>/dev/null
+}
+
+for mode in reuseport exclusive thread; do
+    run -a $mode
+done
+run -a reuseport -n 1
+run -a reuseport -n 1024
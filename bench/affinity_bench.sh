@@ -0,0 +1,30 @@
+#!/bin/bash
+# 对比不绑核、绑核、绑核 + SO_INCOMING_CPU引导的吞吐与延迟，并打印退出时日志中的迁移与跨节点计数
+# 用法: bench/affinity_bench.sh [reactor数] [连接数] [秒数]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+LOOPS=${1:-4}
+CONNS=${2:-256}
+SECS=${3:-10}
+PORT=1399
+CPUS="0-$((LOOPS - 1))"
+
+run() {
+    local before=$(cat log/*.log 2>/dev/null | wc -l)
+    ./bin/server -p $PORT -l $LOOPS "$@" > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    printf "%-32s keep-alive: " "$*"
+    ./bench/loadgen -p $PORT -c $CONNS -t 2 -d $SECS
+    printf "%-32s short:      " ""
+    ./bench/loadgen -p $PORT -c $CONNS -t 2 -d $SECS -k 0
+    kill $pid
+    wait $pid 2>/dev/null
+    # 本轮写入的迁移与引导计数
+    cat log/*.log | tail -n +$((before + 1)) | grep -E "Stats (reactor|placement)" | cut -d' ' -f4-
+}
+
+run
+run -c $CPUS
+run -c $CPUS -s 1
+run -c $CPUS -s 1 -a thread
@@ -0,0 +1,39 @@
+#!/bin/bash
+# 对比 epoll 与 io_uring 两种I/O后端：吞吐、延迟以及每个请求的系统调用次数
+# 系统调用次数用 perf stat -e raw_syscalls:sys_enter 统计（没有perf或无权限时跳过）
+# 用法: bench/backend_bench.sh [path] [连接数] [秒数] [reactor数]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+URL=${1:-/index.html}
+CONNS=${2:-256}
+SECS=${3:-10}
+LOOPS=${4:-4}
+PORT=1398
+PERF=$(command -v perf)
+
+run() {
+    local backend=$1
+    ./bin/server -p $PORT -l $LOOPS -b $backend > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    local perfPid=""
+    if [ -n "$PERF" ]; then
+        $PERF stat -e raw_syscalls:sys_enter -p $pid -o /tmp/backend_bench.perf sleep $SECS > /dev/null 2>&1 &
+        perfPid=$!
+    fi
+    local out
+    out=$(./bench/loadgen -p $PORT -c $CONNS -t 4 -d $SECS -u "$URL")
+    printf "%-6s %s\n" "$backend" "$out"
+    if [ -n "$perfPid" ] && wait $perfPid && [ -s /tmp/backend_bench.perf ]; then
+        local reqs sys
+        reqs=$(echo "$out" | sed -n 's/.*requests: \([0-9]*\).*/\1/p')
+        sys=$(grep sys_enter /tmp/backend_bench.perf | awk '{gsub(",", "", $1); print $1}')
+        [ -n "$sys" ] && [ "${reqs:-0}" -gt 0 ] && \
+            printf "       syscalls: %s  syscalls/req: %.2f\n" "$sys" "$(echo "$sys / $reqs" | bc -l)"
+    fi
+    kill $pid
+    wait $pid 2>/dev/null
+}
+
+run epoll
+run uring
@@ -0,0 +1,24 @@
+#!/bin/bash
+# 条件请求：同一个文件分别以普通GET与带If-None-Match（浏览器缓存命中）的GET压测，对比吞吐、延迟与流量，
+# 并打印退出时日志中条件请求与304的计数
+# 用法: bench/conditional_bench.sh [path] [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+URL_PATH=${1:-/index.html}
+CONNS=${2:-32}
+SECS=${3:-5}
+shift 3 2>/dev/null
+PORT=1404
+
+before=$(cat log/*.log 2>/dev/null | wc -l)
+./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+pid=$!
+sleep 1
+ETAG=$(curl -s -D - -o /dev/null http://127.0.0.1:$PORT$URL_PATH | grep -i "^etag:" | cut -d' ' -f2 | tr -d '\r')
+printf "%-12s " "200"
+./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u $URL_PATH
+printf "%-12s " "304"
+./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u $URL_PATH -H "If-None-Match: $ETAG"
+kill $pid
+wait $pid 2>/dev/null
+cat log/*.log | tail -n +$((before + 1)) | grep "Stats conditional" | cut -d' ' -f5-
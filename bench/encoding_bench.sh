@@ -0,0 +1,23 @@
+#!/bin/bash
+# 内容编码：同一个文本文件分别以不带与带Accept-Encoding的GET压测，对比原文件与缓存的gzip压缩结果的吞吐、延迟与流量，
+# 并打印退出时日志中的压缩与缓存命中计数（每个文件只应压缩一次）
+# 用法: bench/encoding_bench.sh [path] [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+URL_PATH=${1:-/css/bootstrap.min.css}
+CONNS=${2:-32}
+SECS=${3:-5}
+shift 3 2>/dev/null
+PORT=1405
+
+before=$(cat log/*.log 2>/dev/null | wc -l)
+./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+pid=$!
+sleep 1
+printf "%-12s " "identity"
+./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u $URL_PATH
+printf "%-12s " "gzip"
+./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u $URL_PATH -H "Accept-Encoding: gzip, deflate, br"
+kill $pid
+wait $pid 2>/dev/null
+cat log/*.log | tail -n +$((before + 1)) | grep "Stats encoding" | cut -d' ' -f5-
@@ -0,0 +1,39 @@
+#!/bin/bash
+# HTTP/2：同一个文件分别以HTTP/1.1（loadgen，每个连接一个请求在途）与h2c（h2load，每个连接多个流在途）压测，对比吞吐与延迟，
+# 并打印退出时日志中的HTTP/2连接数与流数；没有h2load（nghttp2-client）时用nghttp在一个连接上并发请求，
+# nghttp本身是瓶颈，此时报告总耗时与服务器的CPU时间
+# 用法: bench/h2_bench.sh [path] [连接数] [每个连接的并发流数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+URL_PATH=${1:-/index.html}
+CONNS=${2:-32}
+STREAMS=${3:-16}
+SECS=${4:-5}
+shift 4 2>/dev/null
+PORT=1406
+
+before=$(cat log/*.log 2>/dev/null | wc -l)
+./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+pid=$!
+sleep 1
+printf "%-12s " "http/1.1"
+./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u $URL_PATH
+if command -v h2load > /dev/null; then
+    printf "%-12s\n" "h2c x$STREAMS"
+    h2load -c $CONNS -m $STREAMS -D $SECS http://127.0.0.1:$PORT$URL_PATH | grep -E "^finished|^requests|^time for request"
+elif command -v nghttp > /dev/null; then
+    N=$((CONNS * STREAMS))
+    cpu0=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    start=$(date +%s.%N)
+    nghttp -n -m $N http://127.0.0.1:$PORT$URL_PATH
+    end=$(date +%s.%N)
+    cpu1=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    awk -v n=$N -v s=$start -v e=$end -v c=$((cpu1 - cpu0)) -v hz=$(getconf CLK_TCK) 'BEGIN {
+        printf "%-12s %d requests on 1 connection in %.3fs, server cpu %.0fms (%.1fus/request)\n",
+               "h2c nghttp", n, e - s, c * 1000 / hz, c * 1e6 / hz / n }'
+else
+    echo "h2load/nghttp not found (nghttp2-client)"
+fi
+kill $pid
+wait $pid 2>/dev/null
+cat log/*.log | tail -n +$((before + 1)) | grep "Stats h2" | cut -d' ' -f5-
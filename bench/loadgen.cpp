@@ -0,0 +1,246 @@
+/*
+HTTP/1.1 keep-alive 压测客户端：每个线程一个epoll，管理若干长连接，
+每个连接循环发送同一个GET请求并统计吞吐与延迟。
+-k 0 时为短连接：每个请求新建一个连接（Connection: close），用于压测接入路径，延迟包含建连时间。
+-P N 时为流水线：每个连接一次发出N个请求，N个响应全部收到后再发下一批，延迟从整批发出时算起。
+-H 添加请求头（可以多次使用），如 -H 'If-None-Match: "abc"'。
+用法: ./loadgen [-h host] [-p port] [-c 连接数] [-t 线程数] [-d 秒数] [-u path] [-k 0|1] [-P 流水线深度] [-H 请求头]
+*/
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Conn {
+    int fd;
+    std::string in;             // 收到但尚未解析完的数据
+    size_t sent;                // 当前一批请求已发送的字节数
+    int inflight;               // 当前一批中尚未收到响应的请求数
+    Clock::time_point start;    // 当前请求的发送时间
+    bool reused;                // 该连接上已经完成过请求
+};
+
+struct Result {
+    long requests = 0;
+    long errors = 0;
+    long retries = 0;
+    long bytes = 0;
+    std::vector<uint32_t> latencyUs;
+};
+
+static const char* g_host = "127.0.0.1";
+static int g_port = 1316;
+static int g_conns = 64;
+static int g_threads = 1;
+static int g_seconds = 10;
+static std::string g_path = "/index.html";
+static bool g_keepAlive = true;
+static int g_depth = 1;
+static std::string g_headers;   // -H指定的请求头，每个以\r\n结尾
+static std::string g_request;   // 一批请求，流水线深度为N时是同一个请求重复N次
+static std::atomic<bool> g_stop(false);
+
+static int Connect() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) { return -1; }
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    inet_pton(AF_INET, g_host, &addr.sin_addr);
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// 返回一个完整响应的长度，不完整返回0，出错返回-1；keepAlive不为空时返回服务器是否保持连接
+static long ResponseLen(const std::string& in, bool* keepAlive = nullptr) {
+    size_t headEnd = in.find("\r\n\r\n");
+    if(headEnd == std::string::npos) { return 0; }
+    long bodyLen = 0;
+    size_t pos = 0;
+    while(pos < headEnd) {
+        size_t eol = in.find("\r\n", pos);
+        if(eol - pos > 15 && strncasecmp(in.data() + pos, "Content-length:", 15) == 0) {
+            bodyLen = atol(in.data() + pos + 15);
+        }
+        if(keepAlive && eol - pos >= 17 && strncasecmp(in.data() + pos, "Connection: close", 17) == 0) {
+            *keepAlive = false;
+        }
+        pos = eol + 2;
+    }
+    if(in.compare(0, 9, "HTTP/1.1 ") != 0) { return -1; }
+    long total = headEnd + 4 + bodyLen;
+    return (long)in.size() >= total ? total : 0;
+}
+
+static bool SendRequest(Conn& c) {
+    while(c.sent < g_request.size()) {
+        ssize_t n = send(c.fd, g_request.data() + c.sent, g_request.size() - c.sent, MSG_NOSIGNAL);
+        if(n < 0) { return errno == EAGAIN; }
+        c.sent += n;
+    }
+    return true;
+}
+
+// 建立连接并发送第一个请求
+static bool Open(int epfd, std::vector<Conn>& cs, int i) {
+    cs[i].in.clear();
+    cs[i].sent = 0;
+    cs[i].inflight = g_depth;
+    cs[i].reused = false;
+    cs[i].start = Clock::now();
+    cs[i].fd = Connect();
+    if(cs[i].fd < 0) { return false; }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, cs[i].fd, &ev);
+    SendRequest(cs[i]);
+    return true;
+}
+
+static void Shut(int epfd, Conn& c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    c.fd = -1;
+}
+
+static void Worker(int conns, Result* res) {
+    int epfd = epoll_create1(0);
+    std::vector<Conn> cs(conns);
+    for(int i = 0; i < conns; i++) {
+        if(!Open(epfd, cs, i)) { res->errors++; }
+    }
+    std::vector<struct epoll_event> evs(256);
+    char buf[65536];
+    while(!g_stop) {
+        int n = epoll_wait(epfd, evs.data(), evs.size(), 100);
+        for(int i = 0; i < n; i++) {
+            int idx = evs[i].data.u32;
+            Conn& c = cs[idx];
+            if(c.fd < 0) { continue; }
+            ssize_t len;
+            while((len = recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+                c.in.append(buf, len);
+                res->bytes += len;
+            }
+            bool closed = (len == 0 || (len < 0 && errno != EAGAIN));
+            long total;
+            bool done = false;
+            bool keepAlive = g_keepAlive;
+            while((total = ResponseLen(c.in, &keepAlive)) > 0) {
+                c.in.erase(0, total);
+                auto now = Clock::now();
+                res->requests++;
+                res->latencyUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - c.start).count());
+                done = true;
+                c.reused = true;
+                if(!keepAlive) { break; }
+                if(--c.inflight > 0) { continue; }
+                c.start = now;
+                c.sent = 0;
+                c.inflight = g_depth;
+                SendRequest(c);
+            }
+            if(total < 0) { res->errors++; }
+            if(!keepAlive && done) {
+                // 短连接或服务器要求关闭（如优雅退出）：收到完整响应后换一个新连接
+                Shut(epfd, c);
+                if(!Open(epfd, cs, idx)) { res->errors++; }
+                continue;
+            }
+            if(closed) {
+                // 复用的空闲连接被服务器关闭（如优雅退出），请求尚未得到任何响应，像浏览器一样换新连接重发
+                bool retry = c.reused && c.in.empty();
+                Shut(epfd, c);
+                if(retry) {
+                    res->retries++;
+                    if(!Open(epfd, cs, idx)) { res->errors++; }
+                } else {
+                    res->errors++;
+                }
+            }
+        }
+    }
+    for(auto& c: cs) {
+        if(c.fd >= 0) { close(c.fd); }
+    }
+    close(epfd);
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while((opt = getopt(argc, argv, "h:p:c:t:d:u:k:P:H:")) != -1) {
+        switch(opt) {
+        case 'h': g_host = optarg; break;
+        case 'p': g_port = atoi(optarg); break;
+        case 'c': g_conns = atoi(optarg); break;
+        case 't': g_threads = atoi(optarg); break;
+        case 'd': g_seconds = atoi(optarg); break;
+        case 'u': g_path = optarg; break;
+        case 'k': g_keepAlive = atoi(optarg) != 0; break;
+        case 'P': g_depth = std::max(1, atoi(optarg)); break;
+        case 'H': g_headers += std::string(optarg) + "\r\n"; break;
+        default:
+            fprintf(stderr, "Usage: %s [-h host] [-p port] [-c conns] [-t threads] [-d seconds] [-u path] [-k 0|1] [-P depth] [-H header]\n", argv[0]);
+            return 1;
+        }
+    }
+    g_request = "GET " + g_path + " HTTP/1.1\r\nHost: " + g_host + "\r\nConnection: " +
+                (g_keepAlive ? "keep-alive" : "close") + "\r\n" + g_headers + "\r\n";
+    if(!g_keepAlive) { g_depth = 1; }
+    std::string one = g_request;
+    for(int i = 1; i < g_depth; i++) { g_request += one; }
+
+    std::vector<Result> results(g_threads);
+    std::vector<std::thread> threads;
+    auto begin = Clock::now();
+    for(int i = 0; i < g_threads; i++) {
+        int conns = g_conns / g_threads + (i < g_conns % g_threads ? 1 : 0);
+        threads.emplace_back(Worker, conns, &results[i]);
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(g_seconds));
+    g_stop = true;
+    for(auto& t: threads) { t.join(); }
+    double secs = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    Result all;
+    for(auto& r: results) {
+        all.requests += r.requests;
+        all.errors += r.errors;
+        all.retries += r.retries;
+        all.bytes += r.bytes;
+        all.latencyUs.insert(all.latencyUs.end(), r.latencyUs.begin(), r.latencyUs.end());
+    }
+    std::sort(all.latencyUs.begin(), all.latencyUs.end());
+    auto pct = [&](double p) -> uint32_t {
+        if(all.latencyUs.empty()) { return 0; }
+        return all.latencyUs[std::min(all.latencyUs.size() - 1, (size_t)(p * all.latencyUs.size()))];
+    };
+    printf("requests: %ld  errors: %ld  retries: %ld  req/s: %.0f  MB/s: %.1f  p50: %uus  p99: %uus  p999: %uus\n",
+           all.requests, all.errors, all.retries, all.requests / secs, all.bytes / secs / 1048576.0,
+           pct(0.50), pct(0.99), pct(0.999));
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+请求解析微基准：单线程反复解析同一个请求，对比原来基于std::regex的逐行解析
+（逻辑照搬自改写前的HttpRequest::parse）与现在的增量解析在各个扫描实现（逐字节/SSE4.2/AVX2）下
+每秒解析的请求数（单核）与平均每个请求的堆分配次数；请求分为典型的浏览器请求与带2KB左右Cookie的请求两种
+用法: bench/parser_bench [秒数]   需先 make -C bench parser_bench
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <regex>
+#include <string>
+#include <unordered_map>
+
+#include "../code/buffer/buffer.h"
+#include "../code/http/httprequest.h"
+
+using namespace std;
+
+// 统计堆分配次数（基准是单线程的）
+static size_t g_allocs = 0;
+void* operator new(size_t n) {
+    g_allocs++;
+    if(void* p = malloc(n)) { return p; }
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const char REQUEST[] =
+    "GET /images/profile-image.jpg HTTP/1.1\r\n"
+    "Host: 127.0.0.1:1316\r\n"
+    "Connection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+    "Referer: http://127.0.0.1:1316/\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Cookie: session=0123456789abcdef\r\n"
+    "\r\n";
+
+// 带多个跟踪Cookie与若干附加请求头的请求，请求头约2KB
+static string HeavyRequest() {
+    string req(REQUEST, sizeof(REQUEST) - 3);   // 去掉结尾的空行
+    req += "Cookie: ";
+    for(int i = 0; i < 24; i++) {
+        req += "_tr" + to_string(i) + "=GA1.2.1234567890.1700000000-abcdefABCDEF0123456789; ";
+    }
+    req += "lang=zh-CN\r\n";
+    req += "Sec-Ch-Ua: \"Chromium\";v=\"120\", \"Not?A_Brand\";v=\"24\"\r\n";
+    req += "Sec-Ch-Ua-Platform: \"Linux\"\r\n";
+    req += "Sec-Fetch-Dest: image\r\nSec-Fetch-Mode: no-cors\r\nSec-Fetch-Site: same-origin\r\n";
+    req += "If-None-Match: W/\"5f3a-18c2b6f4e10\"\r\nIf-Modified-Since: Tue, 12 Dec 2023 08:00:00 GMT\r\n";
+    req += "\r\n";
+    return req;
+}
+
+// 改写前的解析方式：每行拷贝成string，每次调用构造regex
+class RegexParser {
+public:
+    bool parse(Buffer& buff) {
+        const char CRLF[] = "\r\n";
+        method_ = path_ = version_ = "";
+        header_.clear();
+        state_ = REQUEST_LINE;
+        while(buff.ReadableBytes() && state_ != FINISH) {
+            const char* lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+            string line(buff.Peek(), lineEnd);
+            switch(state_) {
+            case REQUEST_LINE: {
+                regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+                smatch subMatch;
+                if(!regex_match(line, subMatch, patten)) { return false; }
+                method_ = subMatch[1];
+                path_ = subMatch[2];
+                version_ = subMatch[3];
+                state_ = HEADERS;
+                break;
+            }
+            case HEADERS: {
+                regex patten("^([^:]*): ?(.*)$");
+                smatch subMatch;
+                if(regex_match(line, subMatch, patten)) { header_[subMatch[1]] = subMatch[2]; }
+                else { state_ = BODY; }
+                if(buff.ReadableBytes() <= 2) { state_ = FINISH; }
+                break;
+            }
+            default:
+                state_ = FINISH;
+                break;
+            }
+            if(lineEnd == buff.BeginWrite()) { break; }
+            buff.RetrieveUntil(lineEnd + 2);
+        }
+        return true;
+    }
+    const string& path() const { return path_; }
+
+private:
+    enum { REQUEST_LINE, HEADERS, BODY, FINISH } state_;
+    string method_, path_, version_;
+    unordered_map<string, string> header_;
+};
+
+// 在secs秒内反复解析，返回每秒请求数，allocs为平均每个请求的堆分配次数；解析结果不对时返回-1
+template<typename F>
+static double Run(double secs, const string& req, F parseOne, double* allocs = nullptr) {
+    using Clock = chrono::steady_clock;
+    Buffer buff;
+    buff.Append(req.data(), req.size());    // 先让缓冲区与解析器的内存达到稳定大小
+    if(!parseOne(buff)) { return -1; }
+    buff.Retrieve(buff.ReadableBytes());
+    size_t allocs0 = g_allocs;
+    size_t n = 0;
+    auto start = Clock::now();
+    double elapsed = 0;
+    while(elapsed < secs) {
+        for(int i = 0; i < 1000; i++) {
+            buff.Append(req.data(), req.size());
+            if(!parseOne(buff)) { return -1; }
+            buff.Retrieve(buff.ReadableBytes());
+        }
+        n += 1000;
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+    }
+    if(allocs) { *allocs = (double)(g_allocs - allocs0) / n; }
+    return n / elapsed;
+}
+
+// 现在的解析器，整个请求一次到达
+static double RunIncremental(double secs, const string& req, double* allocs) {
+    HttpRequest request;
+    return Run(secs, req, [&](Buffer& buff) {
+        request.Init();
+        return request.parse(buff) == HttpRequest::PARSE_OK && request.path() == "/images/profile-image.jpg"
+            && request.IsKeepAlive() && request.GetHeader(HttpRequest::HOST) == "127.0.0.1:1316"
+            && request.GetHeader("Accept-Language") == "zh-CN,zh;q=0.9,en;q=0.8";
+    }, allocs);
+}
+
+// 同一个请求分三次到达，每次到达后都调用一次parse，后两次从上次扫描的位置继续
+static double RunSplit(double secs, const string& req) {
+    HttpRequest request;
+    return Run(secs, req, [&](Buffer& buff) {
+        string rest(buff.Peek(), buff.ReadableBytes());
+        buff.Retrieve(buff.ReadableBytes());
+        request.Init();
+        size_t total = rest.size();
+        size_t cut[] = { 0, total / 3, total * 2 / 3, total };
+        HttpRequest::PARSE_RESULT res = HttpRequest::PARSE_AGAIN;
+        for(int i = 0; i < 3; i++) {
+            buff.Append(rest.data() + cut[i], cut[i + 1] - cut[i]);
+            res = request.parse(buff);
+        }
+        return res == HttpRequest::PARSE_OK && request.path() == "/images/profile-image.jpg";
+    });
+}
+
+int main(int argc, char* argv[]) {
+    double secs = argc > 1 ? atof(argv[1]) : 3;
+    const string reqs[] = { string(REQUEST, sizeof(REQUEST) - 1), HeavyRequest() };
+    const char* impls[] = { "scalar", "sse4.2", "avx2" };
+    const char* best = HttpScan::Impl();
+    bool ok = true;
+
+    for(const string& req: reqs) {
+        printf("request: %zu bytes, %.1fs each\n", req.size(), secs);
+        RegexParser oldParser;
+        double oldAllocs = 0;
+        double oldRate = Run(secs, req, [&](Buffer& buff) {
+            return oldParser.parse(buff) && oldParser.path() == "/images/profile-image.jpg";
+        }, &oldAllocs);
+        printf("  %-22s %12.0f req/s           allocs/req: %.1f\n", "regex", oldRate, oldAllocs);
+        ok = ok && oldRate > 0;
+        for(const char* impl: impls) {
+            if(!HttpScan::Use(impl)) { continue; }
+            double allocs = 0;
+            double rate = RunIncremental(secs, req, &allocs);
+            double split = RunSplit(secs, req);
+            printf("  %-22s %12.0f req/s  (%.1fx)   allocs/req: %.1f   3 reads: %12.0f req/s\n",
+                   (string("incremental ") + impl).c_str(), rate, rate / oldRate, allocs, split);
+            ok = ok && rate > 0 && split > 0;
+        }
+        HttpScan::Use(best);
+    }
+    return ok ? 0 : 1;
+}
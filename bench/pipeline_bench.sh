@@ -0,0 +1,28 @@
+#!/bin/bash
+# HTTP/1.1流水线：每个连接一次发出1/4/16个请求，对比吞吐与整批的延迟，并打印退出时日志中按流水线处理的请求数
+# 用法: bench/pipeline_bench.sh [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-32}
+SECS=${2:-5}
+shift 2 2>/dev/null
+PORT=1403
+
+run() {
+    local depth=$1
+    shift
+    local before=$(cat log/*.log 2>/dev/null | wc -l)
+    ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    printf "%-20s " "-P $depth $*"
+    ./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -P $depth
+    kill $pid
+    wait $pid 2>/dev/null
+    printf "%-20s " ""
+    cat log/*.log | tail -n +$((before + 1)) | grep -o "pipelined=[0-9]*"
+}
+
+run 1 "$@"
+run 4 "$@"
+run 16 "$@"
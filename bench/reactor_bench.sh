@@ -0,0 +1,32 @@
+#!/bin/bash
+# 对比 reactor + 线程池 (-t N) 与 one loop per thread (-l N) 两种模型在 1/4/16 核下的吞吐
+# 服务器绑定在前N个核上，压测客户端绑定在其余核上（核数不足时与服务器共享）
+# 用法: bench/reactor_bench.sh [path] [连接数] [秒数]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+URL=${1:-/index.html}
+CONNS=${2:-256}
+SECS=${3:-10}
+PORT=1399
+NCPU=$(nproc)
+
+run() {
+    local cores=$1 mode=$2
+    local last=$((cores - 1))
+    [ $last -ge $NCPU ] && last=$((NCPU - 1))
+    local clientCpus="$((last + 1))-$((NCPU - 1))"
+    [ $((last + 1)) -ge $NCPU ] && clientCpus="0-$((NCPU - 1))"
+
+    taskset -c 0-$last ./bin/server -p $PORT $mode > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    printf "%2s cores %-6s " "$cores" "$mode"
+    taskset -c $clientCpus ./bench/loadgen -p $PORT -c $CONNS -t 4 -d $SECS -u "$URL"
+    kill $pid
+    wait $pid 2>/dev/null
+}
+
+for n in 1 4 16; do
+    run $n "-t $n"
+    run $n "-l $n"
+done
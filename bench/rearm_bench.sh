@@ -0,0 +1,56 @@
+#!/bin/bash
+# 对比EPOLLONESHOT每次重新注册与免重新注册（-e 1）两种连接模式下每个请求的系统调用数
+# 有perf时用perf stat统计全部系统调用（含线程池的futex）；否则用LD_PRELOAD的bench/syscount.so，
+# 只统计经过libc包装函数的调用，并单独列出epoll_ctl/epoll_wait/readv
+# 用法: bench/rearm_bench.sh [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-32}
+SECS=${2:-5}
+shift 2 2>/dev/null
+PORT=1401
+OUT=/tmp/rearm_bench_$$.txt
+PERF=$(command -v perf)
+
+# 每个请求的调用次数
+per() { awk -v n="$1" -v r="$2" 'BEGIN { if(r > 0) printf "%.2f", n / r; else printf "-" }'; }
+
+run() {
+    rm -f $OUT
+    if [ -n "$PERF" ]; then
+        ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    else
+        LD_PRELOAD=./bench/syscount.so SYSCOUNT_OUT=$OUT ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    fi
+    local pid=$!
+    sleep 1
+    local perfPid=""
+    if [ -n "$PERF" ]; then
+        $PERF stat -e raw_syscalls:sys_enter -p $pid -o $OUT sleep $SECS > /dev/null 2>&1 &
+        perfPid=$!
+    fi
+    local res
+    res=$(./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS)
+    [ -n "$perfPid" ] && wait $perfPid
+    kill $pid
+    wait $pid 2>/dev/null
+    local reqs
+    reqs=$(echo "$res" | grep -o "requests: [0-9]*" | cut -d' ' -f2)
+    printf "%-16s %s\n" "$*" "$res"
+    if [ -n "$PERF" ]; then
+        printf "%-16s syscalls/req: %s\n" "" "$(per "$(grep sys_enter $OUT | awk '{gsub(",", "", $1); print $1}')" "$reqs")"
+    else
+        printf "%-16s syscalls/req: %s  epoll_ctl/req: %s  epoll_wait/req: %s  readv/req: %s\n" "" \
+            "$(per "$(awk '$1 == "total" { print $2 }' $OUT)" "$reqs")" \
+            "$(per "$(awk '$1 == "epoll_ctl" { print $2 }' $OUT)" "$reqs")" \
+            "$(per "$(awk '$1 == "epoll_wait" { print $2 }' $OUT)" "$reqs")" \
+            "$(per "$(awk '$1 == "readv" { print $2 }' $OUT)" "$reqs")"
+    fi
+    rm -f $OUT
+}
+
+run -i 1 "$@"
+run -i 0 "$@"
+run -e 1 "$@"
+run -l 1 "$@"
+run -l 1 -e 1 "$@"
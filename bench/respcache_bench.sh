@@ -0,0 +1,48 @@
+#!/bin/bash
+# 完整响应缓存：同一个静态文件在不缓存响应（-j 0，只有打开文件缓存）与缓存响应两种情况下压测，mmap与sendfile两种发送方式各一次，
+# 对比吞吐、延迟、服务器每个请求的CPU时间；有syscount.so时另外列出每个请求的系统调用数与writev/sendfile/sendmsg次数
+# 用法: bench/respcache_bench.sh [path] [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+URL=${1:-/index.html}
+CONNS=${2:-32}
+SECS=${3:-5}
+shift 3 2>/dev/null
+PORT=1411
+OUT=/tmp/respcache_bench_$$.txt
+trap 'rm -f $OUT' EXIT
+
+per() { awk -v n="$1" -v r="$2" 'BEGIN { if(r > 0) printf "%.2f", n / r; else printf "-" }'; }
+count() { awk -v k="$1" '$1 == k { n = $2 } END { print n + 0 }' $OUT; }
+
+run() {
+    rm -f $OUT
+    if [ -f bench/syscount.so ]; then
+        LD_PRELOAD=./bench/syscount.so SYSCOUNT_OUT=$OUT ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    else
+        ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    fi
+    local pid=$!
+    sleep 1
+    local cpu0 cpu1 res reqs
+    cpu0=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    res=$(./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u $URL)
+    cpu1=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    kill $pid
+    wait $pid 2>/dev/null
+    reqs=$(echo "$res" | grep -o "requests: [0-9]*" | cut -d' ' -f2)
+    printf "%-22s %s\n" "$1 $2 $3 $4" "$res"
+    printf "%-22s cpu/req: %sus" "" "$(awk -v c=$((cpu1 - cpu0)) -v hz=$(getconf CLK_TCK) -v r="$reqs" \
+        'BEGIN { if(r > 0) printf "%.1f", c * 1e6 / hz / r; else printf "-" }')"
+    if [ -f $OUT ]; then
+        printf "  syscalls/req: %s  writev: %s  sendfile: %s  sendmsg: %s" \
+            "$(per "$(count total)" "$reqs")" "$(per "$(count writev)" "$reqs")" \
+            "$(per "$(count sendfile)" "$reqs")" "$(per "$(count sendmsg)" "$reqs")"
+    fi
+    echo
+}
+
+for mode in mmap sendfile; do
+    run -x $mode -j 0 "$@"
+    run -x $mode -j 16 "$@"
+done
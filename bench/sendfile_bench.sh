@@ -0,0 +1,53 @@
+#!/bin/bash
+# 静态文件的两种发送方式：1KB、64KB、10MB的文件分别以mmap + writev（-x mmap）与sendfile（-x sendfile）压测，
+# 对比吞吐、延迟与服务器每个请求的CPU时间；有syscount.so时另外列出每个请求的系统调用数与mmap/munmap/sendfile次数
+# 用法: bench/sendfile_bench.sh [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-32}
+SECS=${2:-5}
+shift 2 2>/dev/null
+PORT=1409
+OUT=/tmp/sendfile_bench_$$.txt
+
+for size in 1024 65536 10485760; do
+    head -c $size /dev/urandom > resources/bench_sendfile_$size.bin
+done
+trap 'rm -f resources/bench_sendfile_*.bin $OUT' EXIT
+
+per() { awk -v n="$1" -v r="$2" 'BEGIN { if(r > 0) printf "%.2f", n / r; else printf "-" }'; }
+count() { awk -v k="$1" '$1 == k { n = $2 } END { print n + 0 }' $OUT; }
+
+run() {
+    local size=$1
+    shift
+    rm -f $OUT
+    if [ -f bench/syscount.so ]; then
+        LD_PRELOAD=./bench/syscount.so SYSCOUNT_OUT=$OUT ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    else
+        ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    fi
+    local pid=$!
+    sleep 1
+    local cpu0 cpu1 res reqs
+    cpu0=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    res=$(./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS -u /bench_sendfile_$size.bin)
+    cpu1=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    kill $pid
+    wait $pid 2>/dev/null
+    reqs=$(echo "$res" | grep -o "requests: [0-9]*" | cut -d' ' -f2)
+    printf "%-9s %-12s %s\n" "$size" "$1 $2" "$res"
+    printf "%-22s cpu/req: %sus" "" "$(awk -v c=$((cpu1 - cpu0)) -v hz=$(getconf CLK_TCK) -v r="$reqs" \
+        'BEGIN { if(r > 0) printf "%.1f", c * 1e6 / hz / r; else printf "-" }')"
+    if [ -f $OUT ]; then
+        printf "  syscalls/req: %s  mmap+munmap/req: %s  sendfile/req: %s" \
+            "$(per "$(count total)" "$reqs")" "$(per "$(( $(count mmap) + $(count munmap) ))" "$reqs")" \
+            "$(per "$(count sendfile)" "$reqs")"
+    fi
+    echo
+}
+
+for size in 1024 65536 10485760; do
+    run $size -x mmap "$@"
+    run $size -x sendfile "$@"
+done
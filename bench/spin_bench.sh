@@ -0,0 +1,38 @@
+#!/bin/bash
+# 低延迟模式：对比直接阻塞与阻塞前自旋（-y）在少量连接下的延迟，打印退出时日志中自旋与处理事件的时间，
+# 以及压测结束后空闲期间服务器消耗的CPU（自旋预算应已降为0）
+# 服务器与压测客户端绑在不同的核上，否则自旋会抢走客户端的CPU
+# 用法: bench/spin_bench.sh [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-1}
+SECS=${2:-10}
+shift 2 2>/dev/null
+PORT=1402
+NCPU=$(nproc)
+SERVER_CPU=0
+CLIENT_CPU=$((NCPU > 1 ? 1 : 0))
+
+run() {
+    local before=$(cat log/*.log 2>/dev/null | wc -l)
+    taskset -c $SERVER_CPU ./bin/server -p $PORT -l 1 "$@" > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    printf "%-16s " "$*"
+    taskset -c $CLIENT_CPU ./bench/loadgen -p $PORT -c $CONNS -t 1 -d $SECS
+    sleep 1
+    # 空闲2秒内的CPU时间（时钟滴答，通常1滴答 = 10ms）
+    local t0 t1
+    t0=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    sleep 2
+    t1=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+    printf "%-16s idle cpu ticks in 2s: %d\n" "" $((t1 - t0))
+    kill $pid
+    wait $pid 2>/dev/null
+    cat log/*.log | tail -n +$((before + 1)) | grep -E "Stats reactor [0-9]+ spin" | cut -d' ' -f5-
+}
+
+run "$@"
+run -y 20 "$@"
+run -y 50 "$@"
+run -y 200 "$@"
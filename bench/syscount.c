@@ -0,0 +1,94 @@
+/*
+没有perf时统计服务器系统调用次数的LD_PRELOAD库：拦截服务器用到的libc系统调用包装函数并计数，
+进程退出时把各调用次数追加写到SYSCOUNT_OUT指定的文件（未设置时写到stderr）
+pthread内部的futex、io_uring_enter等不经过这些包装函数，不在统计之内
+用法: LD_PRELOAD=bench/syscount.so SYSCOUNT_OUT=/tmp/sys.txt ./bin/server ...
+*/
+#define _GNU_SOURCE     // RTLD_NEXT
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+enum { C_READ, C_WRITE, C_READV, C_WRITEV, C_EPOLL_WAIT, C_EPOLL_CTL, C_ACCEPT4, C_CLOSE,
+       C_SENDMSG, C_SEND, C_RECV, C_SETSOCKOPT, C_GETSOCKOPT, C_GETPEERNAME, C_SHUTDOWN,
+       C_MINCORE, C_OPEN, C_MMAP, C_MUNMAP, C_FCNTL, C_SENDFILE, C_STAT, C_FSTAT, C_COUNT };
+static const char* names[C_COUNT] = {
+    "read", "write", "readv", "writev", "epoll_wait", "epoll_ctl", "accept4", "close",
+    "sendmsg", "send", "recv", "setsockopt", "getsockopt", "getpeername", "shutdown",
+    "mincore", "open", "mmap", "munmap", "fcntl", "sendfile", "stat", "fstat" };
+static unsigned long counts[C_COUNT];
+
+#define COUNT(c) __atomic_fetch_add(&counts[c], 1, __ATOMIC_RELAXED)
+#define REAL(name) static __typeof__(&name) real; if(!real) { real = (__typeof__(&name))dlsym(RTLD_NEXT, #name); }
+
+ssize_t read(int fd, void* buf, size_t n) { REAL(read); COUNT(C_READ); return real(fd, buf, n); }
+ssize_t write(int fd, const void* buf, size_t n) { REAL(write); COUNT(C_WRITE); return real(fd, buf, n); }
+ssize_t readv(int fd, const struct iovec* iov, int cnt) { REAL(readv); COUNT(C_READV); return real(fd, iov, cnt); }
+ssize_t writev(int fd, const struct iovec* iov, int cnt) { REAL(writev); COUNT(C_WRITEV); return real(fd, iov, cnt); }
+int epoll_wait(int ep, struct epoll_event* ev, int n, int t) { REAL(epoll_wait); COUNT(C_EPOLL_WAIT); return real(ep, ev, n, t); }
+int epoll_ctl(int ep, int op, int fd, struct epoll_event* ev) { REAL(epoll_ctl); COUNT(C_EPOLL_CTL); return real(ep, op, fd, ev); }
+int accept4(int fd, struct sockaddr* a, socklen_t* l, int f) { REAL(accept4); COUNT(C_ACCEPT4); return real(fd, a, l, f); }
+int close(int fd) { REAL(close); COUNT(C_CLOSE); return real(fd); }
+ssize_t sendmsg(int fd, const struct msghdr* m, int f) { REAL(sendmsg); COUNT(C_SENDMSG); return real(fd, m, f); }
+ssize_t send(int fd, const void* b, size_t n, int f) { REAL(send); COUNT(C_SEND); return real(fd, b, n, f); }
+ssize_t recv(int fd, void* b, size_t n, int f) { REAL(recv); COUNT(C_RECV); return real(fd, b, n, f); }
+int setsockopt(int fd, int l, int o, const void* v, socklen_t n) { REAL(setsockopt); COUNT(C_SETSOCKOPT); return real(fd, l, o, v, n); }
+int getsockopt(int fd, int l, int o, void* v, socklen_t* n) { REAL(getsockopt); COUNT(C_GETSOCKOPT); return real(fd, l, o, v, n); }
+int getpeername(int fd, struct sockaddr* a, socklen_t* l) { REAL(getpeername); COUNT(C_GETPEERNAME); return real(fd, a, l); }
+int shutdown(int fd, int how) { REAL(shutdown); COUNT(C_SHUTDOWN); return real(fd, how); }
+int mincore(void* p, size_t n, unsigned char* v) { REAL(mincore); COUNT(C_MINCORE); return real(p, n, v); }
+void* mmap(void* p, size_t n, int prot, int f, int fd, off_t off) { REAL(mmap); COUNT(C_MMAP); return real(p, n, prot, f, fd, off); }
+int munmap(void* p, size_t n) { REAL(munmap); COUNT(C_MUNMAP); return real(p, n); }
+ssize_t sendfile(int out, int in, off_t* off, size_t n) { REAL(sendfile); COUNT(C_SENDFILE); return real(out, in, off, n); }
+// glibc 2.33起stat/fstat是导出的函数（之前是内联到__xstat的包装），更旧的glibc上这两项不计数
+int stat(const char* path, struct stat* st) { REAL(stat); COUNT(C_STAT); return real(path, st); }
+int fstat(int fd, struct stat* st) { REAL(fstat); COUNT(C_FSTAT); return real(fd, st); }
+
+int open(const char* path, int flags, ...) {
+    REAL(open);
+    COUNT(C_OPEN);
+    mode_t mode = 0;
+    if(flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    return real(path, flags, mode);
+}
+
+int fcntl(int fd, int cmd, ...) {
+    REAL(fcntl);
+    COUNT(C_FCNTL);
+    va_list ap;
+    va_start(ap, cmd);
+    long arg = va_arg(ap, long);
+    va_end(ap);
+    return real(fd, cmd, arg);
+}
+
+__attribute__((destructor)) static void Dump(void) {
+    char out[1024];
+    int len = 0;
+    unsigned long total = 0;
+    for(int i = 0; i < C_COUNT; i++) { total += counts[i]; }
+    len += snprintf(out + len, sizeof(out) - len, "total %lu\n", total);
+    for(int i = 0; i < C_COUNT && len < (int)sizeof(out); i++) {
+        if(counts[i]) { len += snprintf(out + len, sizeof(out) - len, "%s %lu\n", names[i], counts[i]); }
+    }
+    const char* path = getenv("SYSCOUNT_OUT");
+    FILE* fp = path ? fopen(path, "a") : stderr;
+    if(!fp) { return; }
+    fputs(out, fp);
+    if(fp != stderr) { fclose(fp); }
+}
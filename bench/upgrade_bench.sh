@@ -0,0 +1,26 @@
+#!/bin/bash
+# 压测期间做一次平滑升级：新进程经Unix域套接字接管监听套接字，旧进程优雅退出；errors应为0
+# 用法: bench/upgrade_bench.sh [连接数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-64}
+SECS=${2:-6}
+shift 2 2>/dev/null
+PORT=1398
+SOCK=/tmp/webserver_upgrade_$PORT.sock
+
+./bin/server -p $PORT -u $SOCK "$@" > /dev/null 2>&1 &
+old=$!
+sleep 1
+for keep in 1 0; do
+    ./bench/loadgen -p $PORT -c $CONNS -t 2 -d $SECS -k $keep &
+    lg=$!
+    sleep $((SECS / 2))
+    ./bin/server -p $PORT -u $SOCK "$@" > /dev/null 2>&1 &
+    new=$!
+    wait $lg
+    wait $old 2>/dev/null && echo "old server $old exited" || echo "old server $old exit status $?"
+    old=$new
+done
+kill $old
+wait $old 2>/dev/null
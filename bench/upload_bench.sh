@@ -0,0 +1,31 @@
+#!/bin/bash
+# 流式上传：向/upload发送一个大文件（默认1000MB），上传期间每0.2秒采样服务器的常驻内存（VmRSS），
+# 报告上传前与上传中的峰值（应与文件大小无关），并打印退出时日志中的上传统计；上传的文件随后删除
+# 用法: bench/upload_bench.sh [文件大小MB] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+MB=${1:-1000}
+shift 1 2>/dev/null
+PORT=1408
+
+rss() { awk '/^VmRSS/ { print $2 }' /proc/$1/status; }
+
+before=$(cat log/*.log 2>/dev/null | wc -l)
+./bin/server -p $PORT -f 1024 "$@" > /dev/null 2>&1 &
+pid=$!
+sleep 1
+base=$(rss $pid)
+./bench/uploadbench -p $PORT -s $MB &
+client=$!
+peak=$base
+while kill -0 $client 2>/dev/null; do
+    r=$(rss $pid)
+    [ -n "$r" ] && [ "$r" -gt "$peak" ] && peak=$r
+    sleep 0.2
+done
+wait $client
+echo "server VmRSS: before ${base}KB, peak during upload ${peak}KB (+$((peak - base))KB)"
+kill $pid
+wait $pid 2>/dev/null
+cat log/*.log | tail -n +$((before + 1)) | grep "Stats upload" | cut -d' ' -f5-
+rm -f uploads/*-bench.jpg
@@ -0,0 +1,96 @@
+/*
+上传压测客户端：向POST /upload流式发送一个multipart/form-data请求体，其中一个文件部分（bench.jpg）
+的内容边生成边发送，客户端自己的内存也与文件大小无关；统计发送的速率与服务器的响应码。
+用法: ./uploadbench [-h host] [-p port] [-s 文件大小MB] [-w 每次write的字节数]
+*/
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* g_host = "127.0.0.1";
+static int g_port = 1316;
+static size_t g_mb = 1000;
+static size_t g_write = 256 << 10;
+
+static bool SendAll(int fd, const char* p, size_t n) {
+    while(n > 0) {
+        ssize_t w = write(fd, p, n);
+        if(w < 0) {
+            if(errno == EINTR) { continue; }
+            return false;
+        }
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while((opt = getopt(argc, argv, "h:p:s:w:")) != -1) {
+        switch(opt) {
+        case 'h': g_host = optarg; break;
+        case 'p': g_port = atoi(optarg); break;
+        case 's': g_mb = atol(optarg); break;
+        case 'w': g_write = atol(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-h host] [-p port] [-s MB] [-w writeBytes]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(g_write == 0) { g_write = 1; }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    inet_pton(AF_INET, g_host, &addr.sin_addr);
+    if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return 1;
+    }
+
+    const std::string boundary = "----uploadbench7MA4YWxkTrZu0gW";
+    std::string prelude = "--" + boundary + "\r\n"
+        "Content-Disposition: form-data; name=\"file\"; filename=\"bench.jpg\"\r\n"
+        "Content-Type: image/jpeg\r\n\r\n";
+    std::string tail = "\r\n--" + boundary + "--\r\n";
+    size_t fileSize = g_mb << 20;
+    size_t bodyLen = prelude.size() + fileSize + tail.size();
+    char head[512];
+    int headLen = snprintf(head, sizeof(head),
+        "POST /upload HTTP/1.1\r\nHost: %s\r\nContent-Type: multipart/form-data; boundary=%s\r\n"
+        "Content-Length: %zu\r\nConnection: close\r\n\r\n", g_host, boundary.c_str(), bodyLen);
+
+    // 文件内容是重复的可打印字节，不含'\r'，不会被当作分隔符
+    std::vector<char> chunk(g_write);
+    for(size_t i = 0; i < chunk.size(); i++) { chunk[i] = 'A' + i % 26; }
+
+    auto start = Clock::now();
+    bool ok = SendAll(fd, head, headLen) && SendAll(fd, prelude.data(), prelude.size());
+    for(size_t sent = 0; ok && sent < fileSize; ) {
+        size_t n = std::min(chunk.size(), fileSize - sent);
+        ok = SendAll(fd, chunk.data(), n);
+        sent += n;
+    }
+    ok = ok && SendAll(fd, tail.data(), tail.size());
+    char resp[256] = { 0 };
+    ssize_t r = read(fd, resp, sizeof(resp) - 1);
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    close(fd);
+    const char* eol = r > 0 ? strstr(resp, "\r\n") : nullptr;
+    printf("upload %zu MB in %.2fs: %.0f MB/s, response: %.*s%s\n", g_mb, secs, g_mb / secs,
+           eol ? (int)(eol - resp) : 0, resp, ok ? "" : " (send failed)");
+    return ok && r > 0 && strncmp(resp + 9, "201", 3) == 0 ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#!/bin/bash
+# 若干慢客户端下载大文件的同时压测小文件：对比不限发送窗口与不同窗口/TCP_NOTSENT_LOWAT下小请求的延迟，
+# 以及慢连接在内核中积压的未发送数据量（ss的notsent）
+# 用法: bench/window_bench.sh [慢客户端数] [限速] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+SLOW=${1:-8}
+RATE=${2:-2M}
+SECS=${3:-10}
+shift 3 2>/dev/null
+PORT=1400
+BIG=resources/bench_window_big.bin
+
+head -c 64000000 /dev/urandom > $BIG
+trap 'rm -f $BIG' EXIT
+
+run() {
+    ./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+    local pid=$!
+    sleep 1
+    local slow=()
+    for ((i = 0; i < SLOW; i++)); do
+        curl -s -o /dev/null --limit-rate $RATE http://127.0.0.1:$PORT/$(basename $BIG) &
+        slow+=($!)
+    done
+    sleep 1
+    printf "%-30s " "$*"
+    ./bench/loadgen -p $PORT -c 32 -t 1 -d $SECS
+    printf "%-30s max notsent: " ""
+    ss -tni state established "( sport = :$PORT )" | grep -o "notsent:[0-9]*" | cut -d: -f2 | sort -n | tail -1
+    kill "${slow[@]}" $pid 2>/dev/null
+    wait 2>/dev/null
+}
+
+run -m 0 -o 0 "$@"
+run -m 256 -o 128 "$@"
+run -m 64 -o 16 "$@"
@@ -0,0 +1,24 @@
+#!/bin/bash
+# WebSocket广播：N个订阅连接加一个发布连接，发布连接按固定速率发消息，服务器扇出给路径上的所有连接，
+# 报告每秒投递的消息数、从发布到订阅连接收到的延迟、服务器的CPU时间，并打印退出时日志中的WebSocket统计
+# 用法: bench/ws_bench.sh [订阅连接数] [每秒发布的消息数] [秒数] [server参数...]   需在仓库根目录先 make，再 make -C bench
+cd "$(dirname "$0")/.." || exit 1
+
+CONNS=${1:-10000}
+RATE=${2:-20}
+SECS=${3:-5}
+shift 3 2>/dev/null
+PORT=1407
+
+ulimit -n $((CONNS * 2 + 1024)) 2>/dev/null || ulimit -n "$(ulimit -Hn)"
+before=$(cat log/*.log 2>/dev/null | wc -l)
+./bin/server -p $PORT "$@" > /dev/null 2>&1 &
+pid=$!
+sleep 1
+cpu0=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+./bench/wsbench -p $PORT -c $CONNS -r $RATE -d $SECS
+cpu1=$(awk '{ print $14 + $15 }' /proc/$pid/stat)
+awk -v c=$((cpu1 - cpu0)) -v hz=$(getconf CLK_TCK) 'BEGIN { printf "server cpu %.0fms (handshakes + fan-out)\n", c * 1000 / hz }'
+kill $pid
+wait $pid 2>/dev/null
+cat log/*.log | tail -n +$((before + 1)) | grep "Stats ws" | cut -d' ' -f5-
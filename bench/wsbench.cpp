@@ -0,0 +1,253 @@
+/*
+WebSocket 广播压测客户端：建立N个订阅连接（升级到WebSocket）与一个发布连接，
+发布连接按固定速率向路径发送文本消息，消息开头是发送时刻（steady_clock纳秒），
+服务器把每条消息广播给路径上的所有连接，统计每秒投递的消息数与从发送到各订阅连接收到的延迟。
+用法: ./wsbench [-h host] [-p port] [-c 订阅连接数] [-d 秒数] [-u path] [-r 每秒发布的消息数] [-s 消息长度]
+*/
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+struct Conn {
+    int fd;
+    bool open;          // 收到了101
+    std::string in;     // 收到但尚未解析完的数据
+};
+
+static const char* g_host = "127.0.0.1";
+static int g_port = 1316;
+static int g_conns = 1000;
+static int g_seconds = 10;
+static std::string g_path = "/ws";
+static int g_rate = 10;
+static size_t g_size = 64;
+
+static int Connect() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) { return -1; }
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    inet_pton(AF_INET, g_host, &addr.sin_addr);
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// 客户端帧必须加掩码，掩码取0时负载不变
+static std::string MaskedFrame(int opcode, const std::string& payload) {
+    std::string f;
+    f += (char)(0x80 | opcode);
+    if(payload.size() < 126) {
+        f += (char)(0x80 | payload.size());
+    } else {
+        f += (char)(0x80 | 126);
+        f += (char)(payload.size() >> 8);
+        f += (char)(payload.size() & 0xff);
+    }
+    f.append(4, '\0');
+    return f + payload;
+}
+
+static bool SendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while(sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EAGAIN) { continue; }
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// 解析in中完整的服务器帧：文本消息记录延迟，Ping回复Pong；返回false表示连接应关闭
+static bool OnFrames(Conn& c, std::vector<uint32_t>* latencyUs, long* pings) {
+    size_t pos = 0;
+    bool ok = true;
+    while(c.in.size() - pos >= 2) {
+        const uint8_t* p = (const uint8_t*)c.in.data() + pos;
+        size_t avail = c.in.size() - pos;
+        int opcode = p[0] & 0x0f;
+        uint64_t len = p[1] & 0x7f;
+        size_t head = 2;
+        if(len == 126) {
+            if(avail < 4) { break; }
+            len = (p[2] << 8) | p[3];
+            head = 4;
+        } else if(len == 127) {
+            if(avail < 10) { break; }
+            len = 0;
+            for(int i = 0; i < 8; i++) { len = (len << 8) | p[2 + i]; }
+            head = 10;
+        }
+        if(avail < head + len) { break; }
+        const char* payload = (const char*)p + head;
+        if(opcode == 1 || opcode == 2) {
+            int64_t sentNs = strtoll(std::string(payload, std::min<uint64_t>(len, 20)).c_str(), nullptr, 10);
+            latencyUs->push_back((NowNs() - sentNs) / 1000);
+        } else if(opcode == 9) {
+            (*pings)++;
+            SendAll(c.fd, MaskedFrame(10, std::string(payload, len)));
+        } else if(opcode == 8) {
+            ok = false;
+        }
+        pos += head + len;
+    }
+    c.in.erase(0, pos);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    int opt;
+    while((opt = getopt(argc, argv, "h:p:c:d:u:r:s:")) != -1) {
+        switch(opt) {
+        case 'h': g_host = optarg; break;
+        case 'p': g_port = atoi(optarg); break;
+        case 'c': g_conns = atoi(optarg); break;
+        case 'd': g_seconds = atoi(optarg); break;
+        case 'u': g_path = optarg; break;
+        case 'r': g_rate = std::max(1, atoi(optarg)); break;
+        case 's': g_size = std::max<size_t>(24, atol(optarg)); break;
+        default:
+            fprintf(stderr, "Usage: %s [-h host] [-p port] [-c conns] [-d seconds] [-u path] [-r msgs/s] [-s size]\n", argv[0]);
+            return 1;
+        }
+    }
+    std::string upgrade = "GET " + g_path + " HTTP/1.1\r\nHost: " + g_host +
+                          "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+    // 最后一个连接是发布连接，它也在频道中，同样接收广播
+    int epfd = epoll_create1(0);
+    std::vector<Conn> cs(g_conns + 1);
+    long errors = 0;
+    for(int i = 0; i <= g_conns; i++) {
+        cs[i].open = false;
+        cs[i].fd = Connect();
+        if(cs[i].fd < 0 || !SendAll(cs[i].fd, upgrade)) {
+            errors++;
+            continue;
+        }
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, cs[i].fd, &ev);
+    }
+    if(cs[g_conns].fd < 0) {
+        fprintf(stderr, "publisher connect failed\n");
+        return 1;
+    }
+
+    std::vector<uint32_t> latencyUs;
+    std::vector<struct epoll_event> evs(1024);
+    char buf[65536];
+    int opened = 0;
+    long published = 0, pings = 0;
+    auto handshakeEnd = Clock::now() + std::chrono::seconds(10);
+    Clock::time_point begin, end, next;
+    bool running = false;
+    while(true) {
+        auto now = Clock::now();
+        if(!running && (opened + errors > g_conns || now > handshakeEnd)) {
+            // 全部升级完成后开始发布
+            running = true;
+            begin = next = now;
+            end = begin + std::chrono::seconds(g_seconds);
+        }
+        if(running) {
+            if(now >= end) { break; }
+            while(next <= now) {
+                std::string msg = std::to_string(NowNs());
+                msg.resize(g_size, ' ');
+                if(!SendAll(cs[g_conns].fd, MaskedFrame(1, msg))) { errors++; }
+                published++;
+                next += std::chrono::nanoseconds(1000000000LL / g_rate);
+            }
+        }
+        int timeout = running ? std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count()) : 100;
+        int n = epoll_wait(epfd, evs.data(), evs.size(), timeout);
+        for(int i = 0; i < n; i++) {
+            Conn& c = cs[evs[i].data.u32];
+            if(c.fd < 0) { continue; }
+            ssize_t len;
+            while((len = recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+                c.in.append(buf, len);
+            }
+            bool ok = !(len == 0 || (len < 0 && errno != EAGAIN));
+            if(!c.open) {
+                size_t headEnd = c.in.find("\r\n\r\n");
+                if(headEnd != std::string::npos) {
+                    if(c.in.compare(0, 12, "HTTP/1.1 101") != 0) {
+                        ok = false;
+                    } else {
+                        c.open = true;
+                        opened++;
+                        c.in.erase(0, headEnd + 4);
+                    }
+                }
+            }
+            if(c.open && !OnFrames(c, &latencyUs, &pings)) { ok = false; }
+            if(!ok) {
+                errors++;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+    }
+    // 收完最后一条消息的投递
+    auto drainEnd = Clock::now() + std::chrono::milliseconds(500);
+    while(Clock::now() < drainEnd) {
+        int n = epoll_wait(epfd, evs.data(), evs.size(), 50);
+        for(int i = 0; i < n; i++) {
+            Conn& c = cs[evs[i].data.u32];
+            if(c.fd < 0) { continue; }
+            ssize_t len;
+            while((len = recv(c.fd, buf, sizeof(buf), 0)) > 0) {
+                c.in.append(buf, len);
+            }
+            if(c.open) { OnFrames(c, &latencyUs, &pings); }
+        }
+    }
+    double secs = std::chrono::duration<double>(end - begin).count();
+    for(auto& c: cs) {
+        if(c.fd >= 0) { close(c.fd); }
+    }
+    close(epfd);
+
+    std::sort(latencyUs.begin(), latencyUs.end());
+    auto pct = [&](double p) -> uint32_t {
+        if(latencyUs.empty()) { return 0; }
+        return latencyUs[std::min(latencyUs.size() - 1, (size_t)(p * latencyUs.size()))];
+    };
+    printf("conns: %d  published: %ld  delivered: %zu/%ld  errors: %ld  deliveries/s: %.0f  p50: %uus  p99: %uus  max: %uus\n",
+           opened, published, latencyUs.size(), published * opened, errors, latencyUs.size() / secs,
+           pct(0.50), pct(0.99), latencyUs.empty() ? 0 : latencyUs.back());
+    return 0;
+}
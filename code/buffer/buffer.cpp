@@ -42,6 +42,13 @@ void Buffer::HasWritten(size_t len)
     writePos_ += len;
 }
 
+// 撤回最后写入的len个字节，移回写下标
+void Buffer::Unwrite(size_t len) 
+{
+    assert(len <= ReadableBytes());
+    writePos_ -= len;
+}
+
 // 读取len长度，移动读下标
 void Buffer::Retrieve(size_t len) 
 {
@@ -110,7 +117,7 @@ void Append(const Buffer& buff)
 }
 
 // 将fd的内容读到缓冲区，即writable的位置
-ssize_t Buffer::ReadFd(int fd, int* Errno) {
+ssize_t Buffer::ReadFd(int fd, int* Errno, bool* full) {
     char buff[65535];   // 栈区
     struct iovec iov[2];    // 分散读，iovec表示一个io向量，包含了一个指针和一个长度，用于readv和writev
     size_t writeable = WritableBytes(); // 先记录能写多少
@@ -121,6 +128,7 @@ ssize_t Buffer::ReadFd(int fd, int* Errno) {
     iov[1].iov_len = sizeof(buff);
 
     ssize_t len = readv(fd, iov, 2);
+    if(full) { *full = len > 0 && static_cast<size_t>(len) == writeable + sizeof(buff); }
     if(len < 0) {
         *Errno = errno;
     } 
@@ -19,6 +19,7 @@ public:
     const char* Peek() const;   // 返回读的位置
     void EnsureWriteable(size_t len);   // 确保有足够的空间
     void HasWritten(size_t len);    // 写入len个字节
+    void Unwrite(size_t len);       // 撤回最后写入的len个字节
 
     void Retrieve(size_t len);  // 读走len个字节
     void RetrieveUntil(const char* end);    // 读走直到end
@@ -34,7 +35,7 @@ public:
     void Append(const void* data, size_t len);  // 添加字符串
     void Append(const Buffer& buff);    // 添加buffer
 
-    ssize_t ReadFd(int fd, int* Errno); // 从fd读
+    ssize_t ReadFd(int fd, int* Errno, bool* full = nullptr); // 从fd读，full: 是否读满了可用空间（内核中可能还有数据）
     ssize_t WriteFd(int fd, int* Errno);    // 写到fd
 
 private:
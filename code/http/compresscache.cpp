@@ -0,0 +1,114 @@
+#include "compresscache.h"
+#include <sys/mman.h>
+#include <zlib.h>
+#include "../log/log.h"
+#include "../server/serverstats.h"
+
+using namespace std;
+
+static const size_t ENTRY_COST = 128;   // 每个条目本身（路径、链表节点等）大致占用的字节数，计入容量
+
+CompressCache* CompressCache::Instance() {
+    static CompressCache cache;
+    return &cache;
+}
+
+static bool SameVersion(off_t size, ino_t ino, const struct timespec& mtim, const struct stat& st) {
+    return ino == st.st_ino && size == st.st_size && mtim.tv_sec == st.st_mtim.tv_sec
+        && mtim.tv_nsec == st.st_mtim.tv_nsec;
+}
+
+shared_ptr<const string> CompressCache::Get(const string& path, const struct stat& st, int fd, const char* map) {
+    if(capacity_ == 0 || (size_t)st.st_size < MIN_FILE || (size_t)st.st_size > MAX_FILE) { return nullptr; }
+    {
+        lock_guard<mutex> locker(mtx_);
+        auto it = cache_.find(path);
+        if(it != cache_.end() && SameVersion(it->second.size, it->second.ino, it->second.mtim, st)) {
+            Entry_& e = it->second;
+            lru_.splice(lru_.begin(), lru_, e.lru);
+            if(!e.pending && e.data) { ServerStats::Add(ServerStats::Instance()->encodeCacheHit); }
+            return e.data;  // 正在压缩时为nullptr
+        }
+        if(it == cache_.end()) {
+            lru_.push_front(path);
+            it = cache_.emplace(path, Entry_()).first;
+            bytes_ += path.size() + ENTRY_COST;
+        }
+        else {  // 文件已更新，丢掉旧版本的结果
+            bytes_ -= it->second.data ? it->second.data->size() : 0;
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+        }
+        Entry_& e = it->second;
+        e.ino = st.st_ino;
+        e.size = st.st_size;
+        e.mtim = st.st_mtim;
+        e.pending = true;
+        e.data = nullptr;
+        e.lru = lru_.begin();
+    }
+
+    // 压缩时不持有锁
+    shared_ptr<string> out = make_shared<string>();
+    bool ok = Compress_(path, fd, map, st.st_size, out.get());
+    if(ok && out->size() > (size_t)st.st_size * 9 / 10) { ok = false; }   // 压缩后没有小于原文件的90%，不值得
+    if(ok && out->size() > capacity_ / 4) { ok = false; }   // 放进缓存会挤掉太多其他文件，每次都要重新压缩
+    ServerStats::Add(ServerStats::Instance()->encodeCompress);
+    LOG_DEBUG("compress %s: %lld -> %zu%s", path.data(), (long long)st.st_size, out->size(), ok ? "" : " (skip)");
+
+    lock_guard<mutex> locker(mtx_);
+    auto it = cache_.find(path);
+    if(it == cache_.end() || !SameVersion(it->second.size, it->second.ino, it->second.mtim, st)) {
+        return ok ? out : nullptr;  // 压缩期间条目已被淘汰或文件又更新了，结果只用这一次
+    }
+    it->second.pending = false;
+    if(ok) {
+        it->second.data = out;
+        bytes_ += out->size();
+        Evict_();
+    }
+    return ok ? out : nullptr;
+}
+
+// 从最久没有用到的开始淘汰，正在压缩的条目跳过
+void CompressCache::Evict_() {
+    auto it = lru_.end();
+    while(bytes_ > capacity_ && it != lru_.begin()) {
+        --it;
+        auto entry = cache_.find(*it);
+        if(entry->second.pending) { continue; }
+        bytes_ -= it->size() + ENTRY_COST + (entry->second.data ? entry->second.data->size() : 0);
+        cache_.erase(entry);
+        it = lru_.erase(it);
+        ServerStats::Add(ServerStats::Instance()->encodeEvict);
+    }
+}
+
+// gzip格式（deflate压缩等级6），整个文件一次压缩；没有现成的映射时临时映射fd
+bool CompressCache::Compress_(const string& path, int fd, const char* map, size_t size, string* out) {
+    void* src = (void*)map;
+    if(!src) {
+        src = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(src == MAP_FAILED) { return false; }
+    }
+
+    z_stream zs = {};
+    if(deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        if(!map) { munmap(src, size); }
+        return false;
+    }
+    out->resize(deflateBound(&zs, size) + 32);
+    zs.next_in = (Bytef*)src;
+    zs.avail_in = size;
+    zs.next_out = (Bytef*)&(*out)[0];
+    zs.avail_out = out->size();
+    int ret = deflate(&zs, Z_FINISH);
+    out->resize(zs.total_out);
+    deflateEnd(&zs);
+    if(!map) { munmap(src, size); }
+    if(ret != Z_STREAM_END) {
+        LOG_WARN("compress %s failed: %d", path.data(), ret);
+        return false;
+    }
+    out->shrink_to_fit();
+    return true;
+}
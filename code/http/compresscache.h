@@ -0,0 +1,53 @@
+#ifndef COMPRESS_CACHE_H
+#define COMPRESS_CACHE_H
+
+#include <sys/stat.h>
+#include <time.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+文本类静态文件的gzip压缩结果缓存：按路径缓存，文件的版本（inode、大小、纳秒级修改时间）没变时直接复用，
+同一版本的文件只压缩一次；压缩后没有明显变小的文件也记下结果，不再重复尝试
+按压缩结果的总字节数限制容量，超过时淘汰最久没有用到的文件
+*/
+class CompressCache {
+public:
+    static CompressCache* Instance();
+
+    void SetCapacity(size_t bytes) { capacity_ = bytes; }   // 启动时设置，0为不压缩
+    size_t Capacity() const { return capacity_; }
+
+    // path为缓存的键，st为打开的文件fd的fstat结果；返回压缩后的内容，不值得压缩或压缩失败时返回nullptr
+    // 压缩的是已打开的这个文件（map不为空时直接用这份映射），不按路径重新打开，内容与st、ETag一定是同一版本
+    // 第一次请求时当场压缩；其他线程正在压缩同一文件时不等待，直接返回nullptr（这次发送原文件）
+    std::shared_ptr<const std::string> Get(const std::string& path, const struct stat& st, int fd, const char* map);
+
+    static const size_t MIN_FILE = 256;         // 更小的文件压缩收益抵不上响应头
+    static const size_t MAX_FILE = 8 << 20;     // 更大的文件不压缩，避免一次压缩长时间占着线程
+
+private:
+    CompressCache() : capacity_(32 << 20), bytes_(0) {}
+
+    struct Entry_ {
+        ino_t ino;
+        off_t size;
+        struct timespec mtim;
+        bool pending;                               // 正在压缩
+        std::shared_ptr<const std::string> data;    // 压缩结果，不值得压缩时为nullptr
+        std::list<std::string>::iterator lru;
+    };
+    static bool Compress_(const std::string& path, int fd, const char* map, size_t size, std::string* out);
+    void Evict_();
+
+    size_t capacity_;
+    std::mutex mtx_;
+    std::unordered_map<std::string, Entry_> cache_;
+    std::list<std::string> lru_;    // 最近用到的在前
+    size_t bytes_;                  // 压缩结果的总字节数
+};
+
+#endif //COMPRESS_CACHE_H
@@ -0,0 +1,274 @@
+#include "filecache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include "../log/log.h"
+#include "../server/serverstats.h"
+
+using namespace std;
+
+// 目录中文件的内容、元数据与目录项的变化，以及目录自身被删除或移走
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+FileCache::File::~File() {
+    if(map) { munmap(map, st.st_size); }
+    if(fd >= 0) { close(fd); }
+}
+
+FileCache* FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+FileCache::FileCache() : maxFiles_(0), maxBytes_(0), maxMap_(0), inotifyFd_(-1), stopFd_(-1) {}
+
+FileCache::~FileCache() {
+    if(watcher_) {
+        uint64_t one = 1;
+        ssize_t ret = write(stopFd_, &one, sizeof(one));
+        (void)ret;
+        watcher_->join();
+    }
+    if(inotifyFd_ >= 0) { close(inotifyFd_); }
+    if(stopFd_ >= 0) { close(stopFd_); }
+}
+
+bool FileCache::Init(const string& root, size_t maxFiles, size_t maxBytes) {
+    root_ = Key_(root);
+    while(root_.size() > 1 && root_.back() == '/') { root_.pop_back(); }
+    if(maxFiles == 0) { return true; }
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_CLOEXEC);
+    if(inotifyFd_ < 0 || stopFd_ < 0) { return false; }     // 由调用者记录日志，这时日志可能还没有初始化
+    maxFiles_ = maxFiles;
+    maxBytes_ = maxBytes;
+    maxMap_ = maxBytes / SHARDS / 4;    // 一个文件最多占分片容量的1/4
+    watcher_.reset(new thread(&FileCache::WatchLoop_, this));
+    return true;
+}
+
+string FileCache::Key_(const string& path) {
+    string key;
+    key.reserve(path.size());
+    for(char c: path) {
+        if(c == '/' && !key.empty() && key.back() == '/') { continue; }
+        key += c;
+    }
+    return key;
+}
+
+// 只按字面比较前缀，"<root>/../x"这样的路径实际在根目录之外，不缓存也不监视它经过的目录
+bool FileCache::InRoot_(const string& key) const {
+    if(key.size() <= root_.size() || key.compare(0, root_.size(), root_) != 0 || key[root_.size()] != '/') {
+        return false;
+    }
+    size_t begin = root_.size() + 1;
+    while(begin <= key.size()) {
+        size_t end = key.find('/', begin);
+        if(end == string::npos) { end = key.size(); }
+        if(key.compare(begin, end - begin, ".") == 0 || key.compare(begin, end - begin, "..") == 0) { return false; }
+        begin = end + 1;
+    }
+    return true;
+}
+
+FileCache::FilePtr FileCache::Get(const string& path, bool pin) {
+    string key = Key_(path);
+    if(maxFiles_ == 0 || !InRoot_(key)) {
+        return Open_(key);  // 不缓存或不在文档根目录下
+    }
+    Shard_& shard = ShardOf_(key);
+    uint64_t seq;
+    {
+        lock_guard<mutex> locker(shard.mtx);
+        auto it = shard.cache.find(key);
+        if(it != shard.cache.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+            it->second.pinned |= pin;
+            ServerStats::Add(ServerStats::Instance()->fileCacheHit);
+            return it->second.file;
+        }
+        seq = shard.seq;
+    }
+    ServerStats::Add(ServerStats::Instance()->fileCacheMiss);
+
+    // 先监视再打开：打开之后的变化一定会有事件；打开期间路径失效过（seq变了）时结果只用这一次
+    bool watched = Watch_(key);
+    FilePtr file = Open_(key);
+    if(!watched) { return file; }
+
+    lock_guard<mutex> locker(shard.mtx);
+    if(shard.seq != seq) { return file; }
+    auto it = shard.cache.find(key);
+    if(it != shard.cache.end()) { return it->second.file; }    // 其他线程同时打开并放进了缓存
+    shard.lru.push_front(key);
+    size_t bytes = file->map ? file->st.st_size : 0;
+    shard.cache.emplace(key, Entry_{ file, bytes, pin, shard.lru.begin() });
+    shard.bytes += bytes;
+    file->stale = false;
+    Evict_(shard);
+    return file;
+}
+
+// 普通文件打开后fstat并生成验证器，不超过maxMap_时映射整个文件；O_NONBLOCK避免打开FIFO时阻塞
+FileCache::FilePtr FileCache::Open_(const string& key) const {
+    shared_ptr<File> file = make_shared<File>();
+    file->fd = open(key.data(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if(file->fd < 0) {
+        file->err = errno;
+        return file;
+    }
+    if(fstat(file->fd, &file->st) < 0 || !S_ISREG(file->st.st_mode)) {
+        file->err = S_ISDIR(file->st.st_mode) ? EISDIR : ENOENT;
+        file->st = {};
+        close(file->fd);
+        file->fd = -1;
+        return file;
+    }
+    file->validator = FileValidator::Instance()->Get(key, file->st);
+    if(file->st.st_size > 0 && (size_t)file->st.st_size <= maxMap_) {
+        void* map = mmap(nullptr, file->st.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+        if(map != MAP_FAILED) { file->map = (char*)map; }
+    }
+    return file;
+}
+
+bool FileCache::Watch_(const string& key) {
+    lock_guard<mutex> locker(watchMtx_);
+    string dir = key.substr(0, key.rfind('/'));
+    while(true) {
+        if(watched_.count(dir)) { return true; }    // 已经监视的目录，它的上级目录也都在监视
+        int wd = inotify_add_watch(inotifyFd_, dir.data(), WATCH_MASK);
+        if(wd < 0) { return false; }    // 目录不存在，或超过max_user_watches
+        watched_[dir] = wd;
+        dirs_[wd].push_back(dir);
+        if(dir.size() <= root_.size()) { return true; }
+        dir.resize(dir.rfind('/'));
+    }
+}
+
+// 从最久没有用到的开始淘汰，固定的条目跳过；正在发送的响应仍持有被淘汰的文件，发完才关闭
+void FileCache::Evict_(Shard_& shard) {
+    size_t maxFiles = (maxFiles_ + SHARDS - 1) / SHARDS;
+    size_t maxBytes = maxBytes_ / SHARDS;
+    auto it = shard.lru.end();
+    while((shard.cache.size() > maxFiles || shard.bytes > maxBytes) && it != shard.lru.begin()) {
+        --it;
+        auto entry = shard.cache.find(*it);
+        if(entry->second.pinned) { continue; }
+        ++it;
+        Erase_(shard, entry);
+        ServerStats::Add(ServerStats::Instance()->fileCacheEvict);
+    }
+}
+
+void FileCache::Erase_(Shard_& shard, unordered_map<string, Entry_>::iterator it) {
+    it->second.file->stale = true;
+    shard.bytes -= it->second.bytes;
+    shard.lru.erase(it->second.lru);
+    shard.cache.erase(it);
+}
+
+void FileCache::Invalidate_(const string& key, bool isDir) {
+    if(!isDir) {
+        Shard_& shard = ShardOf_(key);
+        lock_guard<mutex> locker(shard.mtx);
+        shard.seq++;
+        auto it = shard.cache.find(key);
+        if(it != shard.cache.end()) {
+            Erase_(shard, it);
+            ServerStats::Add(ServerStats::Instance()->fileCacheInvalidate);
+        }
+        return;
+    }
+    string prefix = key + "/";
+    for(Shard_& shard: shards_) {
+        lock_guard<mutex> locker(shard.mtx);
+        shard.seq++;
+        for(auto it = shard.cache.begin(); it != shard.cache.end(); ) {
+            auto next = std::next(it);
+            if(it->first == key || it->first.compare(0, prefix.size(), prefix) == 0) {
+                Erase_(shard, it);
+                ServerStats::Add(ServerStats::Instance()->fileCacheInvalidate);
+            }
+            it = next;
+        }
+    }
+}
+
+// 调用时持有watchMtx_；之后同一路径上新建的目录在下次打开其中的文件时重新监视
+void FileCache::Unwatch_(const string& dir) {
+    string prefix = dir + "/";
+    for(auto it = watched_.begin(); it != watched_.end(); ) {
+        if(it->first != dir && it->first.compare(0, prefix.size(), prefix) != 0) {
+            ++it;
+            continue;
+        }
+        auto d = dirs_.find(it->second);
+        if(d != dirs_.end()) {
+            auto& names = d->second;
+            for(size_t i = 0; i < names.size(); i++) {
+                if(names[i] == it->first) { names.erase(names.begin() + i); break; }
+            }
+            if(names.empty()) {
+                inotify_rm_watch(inotifyFd_, d->first);     // 已被内核移除时返回EINVAL，忽略
+                dirs_.erase(d);
+            }
+        }
+        it = watched_.erase(it);
+    }
+}
+
+void FileCache::Flush_() {
+    for(Shard_& shard: shards_) {
+        lock_guard<mutex> locker(shard.mtx);
+        shard.seq++;
+        ServerStats::Add(ServerStats::Instance()->fileCacheInvalidate, shard.cache.size());
+        for(auto& entry: shard.cache) { entry.second.file->stale = true; }
+        shard.cache.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+void FileCache::WatchLoop_() {
+    alignas(struct inotify_event) char buf[16384];
+    struct pollfd fds[2] = { { inotifyFd_, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+    while(true) {
+        if(poll(fds, 2, -1) < 0 && errno != EINTR) { break; }
+        if(fds[1].revents) { break; }
+        ssize_t len;
+        while((len = read(inotifyFd_, buf, sizeof(buf))) > 0) {
+            for(char* p = buf; p < buf + len; ) {
+                const struct inotify_event* ev = (const struct inotify_event*)p;
+                p += sizeof(struct inotify_event) + ev->len;
+                if(ev->mask & IN_Q_OVERFLOW) {
+                    LOG_WARN("inotify queue overflow, file cache flushed");
+                    Flush_();
+                    continue;
+                }
+                lock_guard<mutex> locker(watchMtx_);
+                auto it = dirs_.find(ev->wd);
+                if(it == dirs_.end()) { continue; }
+                vector<string> dirs = it->second;
+                bool isDir = ev->mask & IN_ISDIR;
+                for(const string& dir: dirs) {
+                    if(ev->len > 0) {   // 目录中的一项
+                        string key = dir + "/" + ev->name;
+                        Invalidate_(key, isDir);
+                        if(isDir && (ev->mask & (IN_DELETE | IN_MOVED_FROM))) { Unwatch_(key); }
+                    }
+                    if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                        Invalidate_(dir, true);
+                        Unwatch_(dir);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <sys/stat.h>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "filevalidator.h"
+
+/*
+静态文件的打开文件缓存：按路径缓存打开的fd、fstat的结果、验证器与整个文件的只读映射，
+命中时请求不再stat/open/mmap/close/munmap；打开失败（不存在、是目录、没有权限）的结果也缓存，
+预先压缩的.br/.gz不存在时不用每次stat
+按路径的哈希分成SHARDS个分片，各有自己的锁与LRU链表，文件数与文件字节数的上限平均分给各分片
+文档根目录下用到的目录由inotify监视（第一次打开其中的文件时加入），目录中的文件被修改、替换、删除、
+改名或改权限时后台线程立即丢掉对应的条目，下一个请求重新打开，请求本身不再stat检查文件是否变化
+条目由shared_ptr引用计数，被淘汰或失效时正在发送它的响应仍持有它，fd与映射在最后一个引用释放时才关闭；
+替换文件（写新文件再rename）时旧文件的内容一直可用，原地截短正在发送的文件与不用缓存时一样不安全
+*/
+class FileCache {
+public:
+    struct File {
+        int fd;         // 打开的文件，打开失败或不是普通文件时为-1
+        int err;        // fd为-1时的原因：open的errno，不是普通文件时为EISDIR
+        struct stat st; // fd为-1时为0
+        FileValidator::Validator validator;
+        char* map;      // 整个文件的只读映射，空文件、太大或没有缓存时为nullptr
+        // 不在缓存中（失效、被淘汰或从来没有放进缓存），文件再变化时不会有人知道；由它生成的响应不能再缓存
+        mutable std::atomic<bool> stale;
+
+        File() : fd(-1), err(0), st(), validator(), map(nullptr), stale(true) {}
+        ~File();
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+    };
+    typedef std::shared_ptr<const File> FilePtr;
+
+    static FileCache* Instance();
+
+    // 启动时设置：root为文档根目录，只缓存其中的文件；maxFiles为0时不缓存，每次都重新打开
+    // inotify不可用时不缓存，返回false
+    bool Init(const std::string& root, size_t maxFiles, size_t maxBytes);
+    size_t MaxFiles() const { return maxFiles_; }
+    size_t MaxBytes() const { return maxBytes_; }
+
+    // 总是返回一个条目：命中时为缓存的条目，否则当场打开（不能缓存时只给这一次使用）
+    // pin为true时条目不会被淘汰（错误页），文件变化时照常失效
+    FilePtr Get(const std::string& path, bool pin = false);
+
+    static const size_t SHARDS = 16;
+
+private:
+    FileCache();
+    ~FileCache();
+
+    struct Entry_ {
+        FilePtr file;
+        size_t bytes;   // 计入容量的字节数（普通文件的大小）
+        bool pinned;
+        std::list<std::string>::iterator lru;
+    };
+    struct Shard_ {
+        std::mutex mtx;
+        std::unordered_map<std::string, Entry_> cache;
+        std::list<std::string> lru;     // 最近用到的在前
+        size_t bytes = 0;
+        uint64_t seq = 0;               // 分片中有路径失效的次数，打开期间有变化时结果不放进缓存
+    };
+
+    static std::string Key_(const std::string& path);   // 合并连续的'/'，同一文件的不同写法共用一个条目
+    bool InRoot_(const std::string& key) const;         // 在根目录下且没有"."、".."路径段
+    Shard_& ShardOf_(const std::string& key) { return shards_[std::hash<std::string>()(key) % SHARDS]; }
+    FilePtr Open_(const std::string& key) const;
+    bool Watch_(const std::string& key);    // 监视文件所在目录及到根目录的各级目录
+    void Evict_(Shard_& shard);
+    void Erase_(Shard_& shard, std::unordered_map<std::string, Entry_>::iterator it);
+    void Invalidate_(const std::string& key, bool isDir);   // isDir时还丢掉目录下的所有条目
+    void Unwatch_(const std::string& dir);  // 目录被删除或移走：不再监视它与它下面的目录
+    void Flush_();                          // 事件队列溢出，丢掉所有条目
+    void WatchLoop_();
+
+    std::string root_;      // 不以'/'结尾
+    size_t maxFiles_;
+    size_t maxBytes_;
+    size_t maxMap_;         // 更大的文件不映射，每个响应自己映射要发送的部分
+    Shard_ shards_[SHARDS];
+
+    int inotifyFd_;
+    int stopFd_;            // eventfd，析构时唤醒监视线程
+    std::mutex watchMtx_;
+    std::unordered_map<std::string, int> watched_;          // 监视的目录 -> wd
+    std::unordered_map<int, std::vector<std::string>> dirs_;    // wd -> 目录（同一目录可能有几种写法）
+    std::unique_ptr<std::thread> watcher_;
+};
+
+#endif //FILE_CACHE_H
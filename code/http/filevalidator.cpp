@@ -0,0 +1,61 @@
+#include "filevalidator.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+FileValidator* FileValidator::Instance() {
+    static FileValidator validator;
+    return &validator;
+}
+
+FileValidator::Validator FileValidator::Get(const string& path, const struct stat& st) {
+    lock_guard<mutex> locker(mtx_);
+    Entry_& e = cache_[path];
+    if(e.ino != st.st_ino || e.size != st.st_size || e.mtim.tv_sec != st.st_mtim.tv_sec
+       || e.mtim.tv_nsec != st.st_mtim.tv_nsec || e.v.etag[0] == '\0') {
+        Make_(st, &e);  // 第一次访问或文件已更新
+    }
+    return e.v;
+}
+
+void FileValidator::Make_(const struct stat& st, Entry_* e) {
+    e->ino = st.st_ino;
+    e->size = st.st_size;
+    e->mtim = st.st_mtim;
+    snprintf(e->v.etag, sizeof(e->v.etag), "\"%llx.%lx-%llx-%llx\"", (unsigned long long)st.st_mtim.tv_sec,
+             (unsigned long)st.st_mtim.tv_nsec, (unsigned long long)st.st_size, (unsigned long long)st.st_ino);
+    struct tm tm;
+    gmtime_r(&st.st_mtime, &tm);
+    strftime(e->v.lastModified, sizeof(e->v.lastModified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    e->v.mtime = st.st_mtime;
+}
+
+bool FileValidator::MatchEtag(string_view ifNoneMatch, const char* etag) {
+    string_view tag(etag);
+    while(!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        string_view item = ifNoneMatch.substr(0, comma);
+        while(!item.empty() && (item.front() == ' ' || item.front() == '\t')) { item.remove_prefix(1); }
+        while(!item.empty() && (item.back() == ' ' || item.back() == '\t')) { item.remove_suffix(1); }
+        if(item == "*") { return true; }
+        if(item.substr(0, 2) == "W/") { item.remove_prefix(2); }
+        if(item == tag) { return true; }
+        if(comma == string_view::npos) { break; }
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+time_t FileValidator::ParseHttpDate(string_view date) {
+    // 只接受IMF-fixdate（RFC 9110要求发送方使用的格式），如Sun, 06 Nov 1994 08:49:37 GMT
+    char buf[32];
+    if(date.size() != 29) { return -1; }
+    memcpy(buf, date.data(), date.size());
+    buf[date.size()] = '\0';
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(!end || *end != '\0') { return -1; }
+    return timegm(&tm);
+}
@@ -0,0 +1,49 @@
+#ifndef FILE_VALIDATOR_H
+#define FILE_VALIDATOR_H
+
+#include <sys/stat.h>
+#include <time.h>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+静态文件的验证器（ETag与Last-Modified）缓存：按路径缓存，文件的版本（inode、大小、纳秒级修改时间）
+没变时直接复用，变了才重新生成，每个请求不再格式化字符串与转换时间
+ETag由版本信息生成，文件被修改或替换为新文件时都会变化，作为强验证器使用
+*/
+class FileValidator {
+public:
+    struct Validator {
+        char etag[80];          // 带引号，如"6571a3c2.1f2e3d4c-e9b-2a0c1"
+        char lastModified[32];  // HTTP-date，如Sun, 06 Nov 1994 08:49:37 GMT
+        time_t mtime;           // 修改时间（秒），比较If-Modified-Since用
+    };
+
+    static FileValidator* Instance();
+
+    // path为stat时用的路径，st为本次stat的结果
+    Validator Get(const std::string& path, const struct stat& st);
+
+    // 请求的If-None-Match（逗号分隔的ETag列表或*）是否含有etag，按弱比较（忽略W/）
+    static bool MatchEtag(std::string_view ifNoneMatch, const char* etag);
+    // If-Modified-Since的IMF-fixdate，不是合法日期时返回-1
+    static time_t ParseHttpDate(std::string_view date);
+
+private:
+    FileValidator() = default;
+
+    struct Entry_ {
+        ino_t ino;
+        off_t size;
+        struct timespec mtim;
+        Validator v;
+    };
+    static void Make_(const struct stat& st, Entry_* e);
+
+    std::mutex mtx_;
+    std::unordered_map<std::string, Entry_> cache_;
+};
+
+#endif //FILE_VALIDATOR_H
@@ -0,0 +1,320 @@
+#include "handlers.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include "../server/serverstats.h"
+
+using namespace std;
+
+int StaticHandler::Handle(HttpRequest& req) const {
+    if(!alias_.empty()) {
+        req.path() = alias_;
+        return 200;
+    }
+    size_t query = req.path().find('?');
+    if(query != string::npos) { req.path().resize(query); }
+    if(DotSegment_(req.path())) {
+        LOG_WARN("Reject dot segment in path: %s", req.path().c_str());
+        return 400;
+    }
+    return 200;
+}
+
+bool StaticHandler::DotSegment_(const string& path) {
+    size_t begin = 0;
+    while(begin < path.size()) {
+        size_t end = path.find('/', begin);
+        if(end == string::npos) { end = path.size(); }
+        size_t len = end - begin;
+        if((len == 1 && path[begin] == '.') || (len == 2 && path[begin] == '.' && path[begin + 1] == '.')) { return true; }
+        begin = end + 1;
+    }
+    return false;
+}
+
+int UserHandler::Handle(HttpRequest& req) const {
+    if(UserVerify(req.GetPost("username"), req.GetPost("password"), isLogin_)) {
+        req.path() = "/welcome.html";
+    }
+    else {
+        req.path() = "/error.html";
+    }
+    return 200;
+}
+
+// 用户验证
+bool UserHandler::UserVerify(const string &name, const string &pwd, bool isLogin) {
+    if(name == "" || pwd == "") { return false; }
+    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
+    MYSQL* sql;
+    SqlConnRAII(&sql,  SqlConnPool::Instance());    // 获取数据库连接
+    assert(sql);    // 断言
+
+    bool flag = false;
+    char order[256] = { 0 };
+    MYSQL_RES *res = nullptr;       // 结果集
+
+    if(!isLogin) { flag = true; }
+    /* 查询用户及密码 */
+    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
+    LOG_DEBUG("%s", order);
+
+    // 查询
+    if(mysql_query(sql, order))
+    {
+        mysql_free_result(res); // 释放结果集
+        return false;
+    }
+    res = mysql_store_result(sql);
+
+    while(MYSQL_ROW row = mysql_fetch_row(res)) {
+        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
+        string password(row[1]);
+        /* 注册行为 且 用户名未被使用*/
+        if(isLogin) {
+            if(pwd == password) { flag = true; }
+            else {
+                flag = false;
+                LOG_INFO("pwd error!");
+            }
+        }
+        else {
+            flag = !(name == row[0]);
+            if(flag == false)LOG_INFO("user used!");
+        }
+    }
+    mysql_free_result(res);
+
+    /* 注册行为 且 用户名未被使用*/
+    if(!isLogin && flag == true) {
+        LOG_DEBUG("regirster!");
+        bzero(order, 256);
+        snprintf(order, 256,"INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
+        LOG_DEBUG( "%s", order);
+        if(mysql_query(sql, order)) {
+            LOG_DEBUG( "Insert error!");
+            flag = false;
+        }
+        flag = true;
+    }
+    // SqlConnPool::Instance()->FreeConn(sql);
+    LOG_DEBUG( "UserVerify success!!");
+    return flag;
+}
+
+// 暂存缓冲区的池：上传结束后归还给下一个上传，不为每个请求分配；最多留下MAX_STAGES个
+static const size_t MAX_STAGES = 8;
+static mutex stageMtx;
+static vector<unique_ptr<char[]>> stagePool;
+
+static char* TakeStage() {
+    {
+        lock_guard<mutex> locker(stageMtx);
+        if(!stagePool.empty()) {
+            char* p = stagePool.back().release();
+            stagePool.pop_back();
+            return p;
+        }
+    }
+    return new char[UploadHandler::STAGE_SIZE];
+}
+
+static void GiveStage(char* p) {
+    if(!p) { return; }
+    {
+        lock_guard<mutex> locker(stageMtx);
+        if(stagePool.size() < MAX_STAGES) {
+            stagePool.emplace_back(p);
+            return;
+        }
+    }
+    delete[] p;
+}
+
+// 上传的文件名：去掉目录，只保留字母、数字、'.'、'-'、'_'，扩展名须是图片类型；不接受时返回空
+static string SafeName(const string& filename) {
+    static const char* const EXTS[] = { "png", "jpg", "jpeg", "gif", "webp", "bmp", "ico" };
+    size_t slash = filename.find_last_of("/\\");
+    string name = filename.substr(slash == string::npos ? 0 : slash + 1);
+    for(char& c: name) {
+        if(!isalnum((unsigned char)c) && c != '.' && c != '-' && c != '_') { c = '_'; }
+    }
+    name.erase(0, name.find_first_not_of('.'));     // 不产生隐藏文件（临时文件以'.'开头）
+    if(name.size() > 128) { name.erase(0, name.size() - 128); }
+    size_t dot = name.rfind('.');
+    if(dot == string::npos) { return ""; }
+    string ext = name.substr(dot + 1);
+    for(char& c: ext) { c = tolower((unsigned char)c); }
+    for(const char* e: EXTS) {
+        if(ext == e) { return name; }
+    }
+    return "";
+}
+
+// 一个上传请求：请求体交给MultipartParser，文件部分写入临时文件
+class UploadHandler::Session_ {
+public:
+    Session_(const UploadHandler* h, string_view boundary) :
+        h_(h), parser_(boundary,
+            [this](const MultipartParser::Part& part) { return Begin_(part); },
+            [this](const char* data, size_t len) { return Data_(data, len); },
+            [this]() { return End_(); }),
+        fd_(-1), off_(0), fileLen_(0), total_(0), stage_(nullptr), staged_(0), finished_(false) {}
+    ~Session_();
+
+    int Feed(const char* data, size_t len);     // len为0表示请求体结束
+
+private:
+    int Begin_(const MultipartParser::Part& part);
+    int Data_(const char* data, size_t len);
+    int End_();
+    int Flush_();
+    int Write_(const char* data, size_t len);
+
+    const UploadHandler* h_;    // 注册在路由表中，一直有效
+    MultipartParser parser_;
+    int fd_;                // 正在写的文件，普通字段为-1
+    string tmp_, final_;    // 临时文件名与完成后的文件名
+    off_t off_;             // 当前文件已写入的长度
+    size_t fileLen_;        // 当前文件已收到的长度（含暂存的）
+    size_t total_;          // 已收到的请求体长度
+    char* stage_;           // 暂存缓冲区，第一次需要时从池中取
+    size_t staged_;
+    vector<string> files_;  // 已完成的文件，请求没有完整结束时删除
+    bool finished_;
+};
+
+UploadHandler::Session_::~Session_() {
+    if(fd_ >= 0) {
+        close(fd_);
+        unlink(tmp_.c_str());
+    }
+    if(!finished_) {
+        for(auto& f: files_) { unlink(f.c_str()); }
+        ServerStats::Add(ServerStats::Instance()->uploadFailed);
+    }
+    GiveStage(stage_);
+}
+
+int UploadHandler::Session_::Feed(const char* data, size_t len) {
+    if(len == 0) {
+        int code = parser_.Finish();
+        if(code) { return code; }
+        finished_ = true;
+        ServerStats::Add(ServerStats::Instance()->uploadFiles, files_.size());
+        for(auto& f: files_) { LOG_INFO("Uploaded %s", f.c_str()); }
+        return 0;
+    }
+    total_ += len;
+    if(total_ > h_->maxTotal_) { return 413; }  // 分块编码的请求体没有预先声明长度
+    return parser_.Feed(data, len);
+}
+
+int UploadHandler::Session_::Begin_(const MultipartParser::Part& part) {
+    if(part.filename.empty()) { return 0; }     // 普通字段，内容丢弃
+    string name = SafeName(part.filename);
+    if(name.empty()) { return 415; }
+    if(files_.size() >= MAX_FILES) { return 413; }
+    static atomic<uint64_t> seq{0};
+    char id[48];
+    snprintf(id, sizeof(id), "%lx-%llu", (long)time(nullptr), (unsigned long long)seq.fetch_add(1));
+    tmp_ = h_->dir_ + "." + id + ".part";
+    final_ = h_->dir_ + id + "-" + name;
+    fd_ = open(tmp_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if(fd_ < 0) {
+        LOG_ERROR("Upload open %s error: %d", tmp_.c_str(), errno);
+        return 500;
+    }
+    off_ = 0;
+    fileLen_ = staged_ = 0;
+    return 0;
+}
+
+// 大块直接从读缓冲区写盘，小块攒满暂存缓冲区再写，写入的次数与块的大小无关
+int UploadHandler::Session_::Data_(const char* data, size_t len) {
+    if(fd_ < 0) { return 0; }
+    fileLen_ += len;
+    if(fileLen_ > h_->maxFile_) { return 413; }
+    if(staged_ > 0 && (staged_ + len > STAGE_SIZE || len >= DIRECT_WRITE)) {
+        int code = Flush_();
+        if(code) { return code; }
+    }
+    if(len >= DIRECT_WRITE) { return Write_(data, len); }
+    if(!stage_) { stage_ = TakeStage(); }
+    memcpy(stage_ + staged_, data, len);
+    staged_ += len;
+    return 0;
+}
+
+int UploadHandler::Session_::End_() {
+    if(fd_ < 0) { return 0; }
+    int code = Flush_();
+    if(code) { return code; }
+    close(fd_);
+    fd_ = -1;
+    if(rename(tmp_.c_str(), final_.c_str()) < 0) {
+        LOG_ERROR("Upload rename %s error: %d", final_.c_str(), errno);
+        unlink(tmp_.c_str());
+        return 500;
+    }
+    files_.push_back(final_);
+    return 0;
+}
+
+int UploadHandler::Session_::Flush_() {
+    if(staged_ == 0) { return 0; }
+    size_t n = staged_;
+    staged_ = 0;
+    return Write_(stage_, n);
+}
+
+// 依次写在文件的末尾（直接写之前已经写出暂存的数据）
+int UploadHandler::Session_::Write_(const char* data, size_t len) {
+    while(len > 0) {
+        ssize_t n = pwrite(fd_, data, len, off_);
+        if(n < 0) {
+            if(errno == EINTR) { continue; }
+            LOG_ERROR("Upload write %s error: %d", tmp_.c_str(), errno);
+            return 500;
+        }
+        ServerStats::Add(ServerStats::Instance()->uploadBytes, n);
+        data += n;
+        len -= n;
+        off_ += n;
+    }
+    return 0;
+}
+
+UploadHandler::UploadHandler(string dir, size_t maxFile, size_t maxTotal) :
+    dir_(std::move(dir)), maxFile_(maxFile), maxTotal_(maxTotal)
+{
+    if(dir_.empty() || dir_.back() != '/') { dir_ += '/'; }
+    if(mkdir(dir_.c_str(), 0755) < 0 && errno != EEXIST) {
+        LOG_ERROR("Upload dir %s error: %d", dir_.c_str(), errno);
+    }
+}
+
+HttpHandler::BodyHandler UploadHandler::Body(const HttpRequest& req, int* code) const {
+    string_view boundary = MultipartParser::Boundary(req.GetHeader(HttpRequest::CONTENT_TYPE));
+    string length(req.GetHeader(HttpRequest::CONTENT_LENGTH));   // 解析请求头时已检查过是数字
+    if(boundary.empty()) { *code = 415; }
+    else if(strtoull(length.c_str(), nullptr, 10) > maxTotal_) { *code = 413; }  // 不必等请求体到达
+    if(*code) {
+        ServerStats::Add(ServerStats::Instance()->uploadFailed);
+        return nullptr;
+    }
+    shared_ptr<Session_> session = make_shared<Session_>(this, boundary);
+    return [session](const char* data, size_t len) { return session->Feed(data, len); };
+}
+
+int UploadHandler::Handle(HttpRequest& req) const {
+    if(req.BodyLength() == 0) { return 400; }   // 没有请求体，没有经过Body
+    req.path() = "/upload.html";
+    return 201;
+}
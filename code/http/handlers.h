@@ -0,0 +1,61 @@
+#ifndef HANDLERS_H
+#define HANDLERS_H
+
+#include <string>
+
+#include "router.h"
+#include "multipart.h"
+#include "httprequest.h"
+#include "../pool/sqlconnpool.h"
+
+// 静态文件：发送路径（去掉查询串）对应的文件；alias不为空时改为发送它，如"/"发送"/index.html"
+// 含"."、".."路径段的请求返回400，不会发送资源目录之外的文件
+class StaticHandler : public HttpHandler {
+public:
+    explicit StaticHandler(std::string alias = "") : alias_(std::move(alias)) {}
+    int Handle(HttpRequest& req) const override;
+
+private:
+    static bool DotSegment_(const std::string& path);   // 含有"."或".."路径段
+
+    std::string alias_;
+};
+
+// 登录/注册：表单中的用户名与密码到数据库验证，成功发送欢迎页，否则发送错误页
+class UserHandler : public HttpHandler {
+public:
+    explicit UserHandler(bool isLogin) : isLogin_(isLogin) {}
+    bool Blocking(const HttpRequest& req) const override { (void)req; return true; }    // 访问数据库
+    int Handle(HttpRequest& req) const override;
+
+private:
+    static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);
+
+    bool isLogin_;
+};
+
+/*
+上传：multipart/form-data请求体中的文件部分边到达边写入dir，不在内存中攒齐，内存占用与文件大小无关；
+大块直接从读缓冲区pwrite，小块先复制到池化的暂存缓冲区凑成大块再写。先写到临时文件，部分结束时改名，
+请求没有完整结束（超过限制、格式错误、连接断开）时删除本次写入的所有文件。只接受图片类型的文件名
+*/
+class UploadHandler : public HttpHandler {
+public:
+    static const size_t MAX_FILES = 16;             // 一个请求中文件的最大个数
+    static const size_t STAGE_SIZE = 256 << 10;     // 暂存缓冲区的大小
+    static const size_t DIRECT_WRITE = 64 << 10;    // 不小于这个长度的一段直接写盘
+
+    // maxFile为单个文件的最大长度，maxTotal为请求体的最大长度，超过返回413
+    UploadHandler(std::string dir, size_t maxFile, size_t maxTotal);
+    BodyHandler Body(const HttpRequest& req, int* code) const override;
+    int Handle(HttpRequest& req) const override;    // 请求体已经全部写完，发送上传页
+
+private:
+    class Session_;
+
+    std::string dir_;   // 以'/'结尾
+    size_t maxFile_;
+    size_t maxTotal_;
+};
+
+#endif //HANDLERS_H
@@ -0,0 +1,298 @@
+#include "hpack.h"
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+
+// 静态表（RFC 7541 附录A），下标从1开始
+static const struct { const char* name; const char* value; } STATIC_TABLE[] = {
+    { ":authority", "" }, { ":method", "GET" }, { ":method", "POST" },
+    { ":path", "/" }, { ":path", "/index.html" }, { ":scheme", "http" },
+    { ":scheme", "https" }, { ":status", "200" }, { ":status", "204" },
+    { ":status", "206" }, { ":status", "304" }, { ":status", "400" },
+    { ":status", "404" }, { ":status", "500" }, { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" }, { "accept-language", "" }, { "accept-ranges", "" },
+    { "accept", "" }, { "access-control-allow-origin", "" }, { "age", "" },
+    { "allow", "" }, { "authorization", "" }, { "cache-control", "" },
+    { "content-disposition", "" }, { "content-encoding", "" }, { "content-language", "" },
+    { "content-length", "" }, { "content-location", "" }, { "content-range", "" },
+    { "content-type", "" }, { "cookie", "" }, { "date", "" },
+    { "etag", "" }, { "expect", "" }, { "expires", "" },
+    { "from", "" }, { "host", "" }, { "if-match", "" },
+    { "if-modified-since", "" }, { "if-none-match", "" }, { "if-range", "" },
+    { "if-unmodified-since", "" }, { "last-modified", "" }, { "link", "" },
+    { "location", "" }, { "max-forwards", "" }, { "proxy-authenticate", "" },
+    { "proxy-authorization", "" }, { "range", "" }, { "referer", "" },
+    { "refresh", "" }, { "retry-after", "" }, { "server", "" },
+    { "set-cookie", "" }, { "strict-transport-security", "" }, { "transfer-encoding", "" },
+    { "user-agent", "" }, { "vary", "" }, { "via", "" },
+    { "www-authenticate", "" },
+};
+static const size_t STATIC_COUNT = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+// 哈夫曼编码表（RFC 7541 附录B）：每个符号的码字与位数，最后一个是EOS
+static const struct { uint32_t code; uint8_t bits; } HUFFMAN_CODES[257] = {
+    { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 },
+    { 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+    { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+    { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+    { 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 },
+    { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+    { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 },
+    { 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+    { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+    { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+    { 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 },
+    { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+    { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 },
+    { 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+    { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+    { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+    { 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 },
+    { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+    { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 },
+    { 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+    { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+    { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+    { 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 },
+    { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+    { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 },
+    { 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+    { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+    { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+    { 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 },
+    { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+    { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 },
+    { 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+    { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+    { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+    { 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 },
+    { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+    { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 },
+    { 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+    { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+    { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+    { 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 },
+    { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+    { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 },
+    { 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+    { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+    { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+    { 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 },
+    { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+    { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 },
+    { 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+    { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+    { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+    { 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 },
+    { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+    { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 },
+    { 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+    { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+    { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+    { 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 },
+    { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+    { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 },
+    { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+    { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+    { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+    { 0x3fffffff, 30 },
+};
+
+// 由编码表构造的解码树：内部节点的两个孩子，叶子记录符号（负数表示内部节点）
+struct HuffmanTree {
+    int16_t child[513][2];
+    int16_t sym[513];
+    HuffmanTree() {
+        memset(child, 0, sizeof(child));
+        for(int i = 0; i < 513; i++) { sym[i] = -1; }
+        int nodes = 1;
+        for(int s = 0; s < 257; s++) {
+            int node = 0;
+            for(int b = HUFFMAN_CODES[s].bits - 1; b >= 0; b--) {
+                int bit = (HUFFMAN_CODES[s].code >> b) & 1;
+                if(!child[node][bit]) { child[node][bit] = nodes++; }
+                node = child[node][bit];
+            }
+            sym[node] = s;
+        }
+    }
+};
+static const HuffmanTree HUFFMAN_TREE;
+
+bool Hpack::HuffmanDecode_(const uint8_t* p, size_t n, string* out) {
+    int node = 0;
+    int depth = 0;      // 当前码字已读的位数
+    bool ones = true;   // 当前码字已读的位全为1
+    for(size_t i = 0; i < n; i++) {
+        for(int b = 7; b >= 0; b--) {
+            int bit = (p[i] >> b) & 1;
+            node = HUFFMAN_TREE.child[node][bit];
+            if(node == 0) { return false; }
+            depth++;
+            ones = ones && bit;
+            int s = HUFFMAN_TREE.sym[node];
+            if(s >= 0) {
+                if(s == 256) { return false; }  // 字符串中不能出现EOS
+                out->push_back((char)s);
+                node = 0;
+                depth = 0;
+                ones = true;
+            }
+        }
+    }
+    return depth <= 7 && ones;     // 结尾的填充不超过7位，且是EOS的前缀（全1）
+}
+
+bool Hpack::DecodeInt_(const uint8_t*& p, const uint8_t* end, int prefix, uint64_t* value) {
+    if(p >= end) { return false; }
+    uint64_t mask = (1u << prefix) - 1;
+    *value = *p++ & mask;
+    if(*value < mask) { return true; }
+    for(int shift = 0; shift <= 28; shift += 7) {
+        if(p >= end) { return false; }
+        uint8_t b = *p++;
+        *value += (uint64_t)(b & 0x7f) << shift;
+        if(!(b & 0x80)) { return true; }
+    }
+    return false;   // 超过32位，不是合理的长度或下标
+}
+
+bool Hpack::DecodeString_(const uint8_t*& p, const uint8_t* end, string* out) {
+    if(p >= end) { return false; }
+    bool huffman = *p & 0x80;
+    uint64_t len;
+    if(!DecodeInt_(p, end, 7, &len) || len > (uint64_t)(end - p)) { return false; }
+    out->clear();
+    bool ok = huffman ? HuffmanDecode_(p, len, out) : (out->assign((const char*)p, len), true);
+    p += len;
+    return ok;
+}
+
+bool Hpack::Lookup_(uint64_t index, string_view* name, string_view* value) const {
+    if(index == 0) { return false; }
+    if(index <= STATIC_COUNT) {
+        *name = STATIC_TABLE[index - 1].name;
+        *value = STATIC_TABLE[index - 1].value;
+        return true;
+    }
+    index -= STATIC_COUNT + 1;
+    if(index >= table_.size()) { return false; }
+    *name = table_[index].name;
+    *value = table_[index].value;
+    return true;
+}
+
+void Hpack::Evict_(size_t maxSize) {
+    while(tableSize_ > maxSize) {
+        tableSize_ -= table_.back().name.size() + table_.back().value.size() + 32;
+        table_.pop_back();
+    }
+}
+
+// 比容量还大的条目使动态表清空，本身也不加入
+void Hpack::Insert_(string_view name, string_view value) {
+    size_t size = name.size() + value.size() + 32;
+    if(size > maxTableSize_) {
+        Evict_(0);
+        return;
+    }
+    Evict_(maxTableSize_ - size);
+    table_.push_front({ string(name), string(value) });
+    tableSize_ += size;
+}
+
+bool Hpack::Decode(const uint8_t* p, size_t n, size_t maxListSize, HeaderList* headers, bool* tooLarge) {
+    const uint8_t* end = p + n;
+    size_t listSize = 0;
+    bool fieldSeen = false;
+    *tooLarge = false;
+    while(p < end) {
+        uint8_t b = *p;
+        uint64_t index;
+        string_view name, value;
+        if(b & 0x80) 
+        {   // 索引的字段
+            if(!DecodeInt_(p, end, 7, &index) || !Lookup_(index, &name, &value)) { return false; }
+        }
+        else if((b & 0xe0) == 0x20) 
+        {   // 动态表大小更新，只能出现在头块开头
+            if(fieldSeen || !DecodeInt_(p, end, 5, &index) || index > MAX_TABLE_SIZE) { return false; }
+            maxTableSize_ = index;
+            Evict_(maxTableSize_);
+            continue;
+        }
+        else 
+        {   // 字面量：加入动态表（01）、不加入（0000）、永不索引（0001）
+            bool indexing = (b & 0xc0) == 0x40;
+            if(!DecodeInt_(p, end, indexing ? 6 : 4, &index)) { return false; }
+            if(index > 0) {
+                string_view v;
+                if(!Lookup_(index, &name, &v)) { return false; }
+                name_.assign(name.data(), name.size());     // 加入动态表时可能淘汰名字所在的条目
+            }
+            else if(!DecodeString_(p, end, &name_)) { return false; }
+            if(!DecodeString_(p, end, &value_)) { return false; }
+            name = name_;
+            value = value_;
+            if(indexing) { Insert_(name, value); }
+        }
+        fieldSeen = true;
+        listSize += name.size() + value.size() + 32;
+        if(listSize > maxListSize) { *tooLarge = true; }
+        if(!*tooLarge) { headers->emplace_back(string(name), string(value)); }
+    }
+    return true;
+}
+
+void Hpack::EncodeInt_(uint64_t value, int prefix, uint8_t first, string* out) {
+    uint64_t mask = (1u << prefix) - 1;
+    if(value < mask) {
+        out->push_back((char)(first | value));
+        return;
+    }
+    out->push_back((char)(first | mask));
+    value -= mask;
+    while(value >= 0x80) {
+        out->push_back((char)(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    out->push_back((char)value);
+}
+
+void Hpack::EncodeString_(string_view s, string* out) {
+    EncodeInt_(s.size(), 7, 0, out);
+    out->append(s.data(), s.size());
+}
+
+void Hpack::EncodeStatus(int code, string* out) {
+    static const int INDEXED[] = { 200, 204, 206, 304, 400, 404, 500 };    // 静态表8~14
+    for(int i = 0; i < 7; i++) {
+        if(INDEXED[i] == code) {
+            out->push_back((char)(0x80 | (8 + i)));
+            return;
+        }
+    }
+    char status[8];
+    snprintf(status, sizeof(status), "%03d", code % 1000);
+    EncodeInt_(8, 4, 0, out);   // 不加入动态表的字面量，名字为静态表8的:status
+    EncodeString_(status, out);
+}
+
+void Hpack::EncodeField(string_view name, string_view value, string* out) {
+    static const unordered_map<string_view, size_t> NAME_INDEX = [] {
+        unordered_map<string_view, size_t> m;
+        for(size_t i = STATIC_COUNT; i > 0; i--) { m[STATIC_TABLE[i - 1].name] = i; }  // 同名取最小的下标
+        return m;
+    }();
+    auto it = NAME_INDEX.find(name);
+    if(it != NAME_INDEX.end()) {
+        EncodeInt_(it->second, 4, 0, out);
+    }
+    else {
+        out->push_back(0);
+        EncodeString_(name, out);
+    }
+    EncodeString_(value, out);
+}
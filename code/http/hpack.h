@@ -0,0 +1,53 @@
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+HPACK（RFC 7541）头部压缩
+解码：请求的头块，静态表 + 容量有上限的动态表，字符串支持哈夫曼编码；每个连接一个解码器，按头块到达的顺序解码
+编码：响应头只用静态表与不加入动态表的字面量（字符串不做哈夫曼编码），不需要维护对方的动态表
+*/
+class Hpack {
+public:
+    typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+
+    static const size_t MAX_TABLE_SIZE = 4096;  // 动态表容量的上限，即SETTINGS_HEADER_TABLE_SIZE的默认值
+
+    Hpack() : tableSize_(0), maxTableSize_(MAX_TABLE_SIZE) {}
+
+    // 解码一个完整的头块，追加到headers；头部列表（名字、值各加32字节）超过maxListSize时不再追加，但照常解码以保持动态表同步，
+    // 并置*tooLarge；格式错误（连接错误COMPRESSION_ERROR）时返回false
+    bool Decode(const uint8_t* p, size_t n, size_t maxListSize, HeaderList* headers, bool* tooLarge);
+
+    static void EncodeStatus(int code, std::string* out);
+    static void EncodeField(std::string_view name, std::string_view value, std::string* out);   // name为小写
+
+private:
+    struct Entry_ {
+        std::string name;
+        std::string value;
+    };
+    bool Lookup_(uint64_t index, std::string_view* name, std::string_view* value) const;
+    void Insert_(std::string_view name, std::string_view value);
+    void Evict_(size_t maxSize);
+
+    static bool DecodeInt_(const uint8_t*& p, const uint8_t* end, int prefix, uint64_t* value);
+    static bool DecodeString_(const uint8_t*& p, const uint8_t* end, std::string* out);
+    static bool HuffmanDecode_(const uint8_t* p, size_t n, std::string* out);
+    static void EncodeInt_(uint64_t value, int prefix, uint8_t first, std::string* out);
+    static void EncodeString_(std::string_view s, std::string* out);
+
+    std::deque<Entry_> table_;  // 动态表，最新加入的在前
+    size_t tableSize_;          // 各条目名字与值的长度加32之和
+    size_t maxTableSize_;       // 对方通过动态表大小更新设置的容量，不超过MAX_TABLE_SIZE
+    std::string name_, value_;  // 解码时的临时字符串，复用容量
+};
+
+#endif //HPACK_H
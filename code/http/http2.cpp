@@ -0,0 +1,719 @@
+#include "http2.h"
+#include <string.h>
+#include <sys/mman.h>
+#include "httprequest.h"
+
+using namespace std;
+
+static const char PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+static const uint8_t FLAG_END_STREAM = 0x1;
+static const uint8_t FLAG_ACK = 0x1;
+static const uint8_t FLAG_END_HEADERS = 0x4;
+static const uint8_t FLAG_PADDED = 0x8;
+static const uint8_t FLAG_PRIORITY = 0x20;
+
+static const int64_t MAX_WINDOW = 0x7fffffff;
+static const size_t MAX_SEND_FRAME = 65536;     // 对方允许更大的帧时，DATA帧也不超过这个大小
+
+static uint32_t Read32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void Write32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void FrameHeader(uint8_t* h, size_t len, uint8_t type, uint8_t flags, uint32_t id) {
+    h[0] = len >> 16;
+    h[1] = len >> 8;
+    h[2] = len;
+    h[3] = type;
+    h[4] = flags;
+    Write32(h + 5, id);
+}
+
+Http2Session::Http2Session(SendFn send) : send_(std::move(send)) {
+    prefaceSeen_ = false;
+    settingsSeen_ = false;
+    goaway_ = false;
+    connError_ = false;
+    lastStreamId_ = 0;
+    blockStream_ = 0;
+    blockEndStream_ = false;
+    blockWeight_ = 16;
+    blockSelfDep_ = false;
+    connWindow_ = STREAM_WINDOW;
+    initialWindow_ = STREAM_WINDOW;
+    peerMaxFrame_ = MAX_FRAME;
+    connRecvWindow_ = STREAM_WINDOW;
+    connUnacked_ = 0;
+}
+
+int Http2Session::MatchPreface(const char* p, size_t n) {
+    size_t m = min(n, PREFACE_LEN);
+    if(memcmp(p, PREFACE, m) != 0) { return -1; }
+    return m == PREFACE_LEN ? 1 : 0;
+}
+
+void Http2Session::Start() {
+    uint8_t settings[12];
+    settings[0] = 0;
+    settings[1] = 3;    // SETTINGS_MAX_CONCURRENT_STREAMS
+    Write32(settings + 2, MAX_CONCURRENT_STREAMS);
+    settings[6] = 0;
+    settings[7] = 6;    // SETTINGS_MAX_HEADER_LIST_SIZE
+    Write32(settings + 8, MAX_HEADER_LIST);
+    SendFrame_(FRAME_SETTINGS, 0, 0, settings, sizeof(settings));
+    // 连接的接收窗口只能用WINDOW_UPDATE放大；流的窗口保持默认值，上传不多
+    SendWindowUpdate_(0, CONN_WINDOW - STREAM_WINDOW);
+    connRecvWindow_ = CONN_WINDOW;
+}
+
+// base64url，可以没有补齐的=
+static bool DecodeBase64Url(string_view s, string* out) {
+    uint32_t acc = 0;
+    int bits = 0;
+    for(char c: s) {
+        int v;
+        if(c >= 'A' && c <= 'Z') { v = c - 'A'; }
+        else if(c >= 'a' && c <= 'z') { v = c - 'a' + 26; }
+        else if(c >= '0' && c <= '9') { v = c - '0' + 52; }
+        else if(c == '-' || c == '+') { v = 62; }
+        else if(c == '_' || c == '/') { v = 63; }
+        else if(c == '=') { break; }
+        else { return false; }
+        acc = acc << 6 | v;
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            out->push_back((char)(acc >> bits));
+        }
+    }
+    return true;
+}
+
+bool Http2Session::Upgrade(string_view settings) {
+    string payload;
+    if(!DecodeBase64Url(settings, &payload) || payload.size() % 6 != 0) { return false; }
+    // 101响应即是对这些设置的确认，不发送SETTINGS ACK
+    if(ApplySettings_((const uint8_t*)payload.data(), payload.size()) != ERR_NONE) { return false; }
+    // 升级的请求是流1，请求已经完整，在HTTP/1.1中解析
+    Stream_& s = streams_[1];
+    s.remoteClosed = true;
+    s.window = initialWindow_;
+    lastStreamId_ = 1;
+    return true;
+}
+
+bool Http2Session::OnRead(Buffer& buff) {
+    if(connError_) {    // GOAWAY之后的数据不再处理
+        buff.RetrieveAll();
+        return false;
+    }
+    if(!prefaceSeen_) {
+        int m = MatchPreface(buff.Peek(), buff.ReadableBytes());
+        if(m < 0) {
+            LOG_WARN("h2: bad connection preface");
+            return ConnError_(ERR_PROTOCOL);
+        }
+        if(m == 0) { return true; }
+        buff.Retrieve(PREFACE_LEN);
+        prefaceSeen_ = true;
+    }
+    while(buff.ReadableBytes() >= 9) {
+        const uint8_t* h = (const uint8_t*)buff.Peek();
+        size_t len = (size_t)h[0] << 16 | (size_t)h[1] << 8 | h[2];
+        if(len > MAX_FRAME) { return ConnError_(ERR_FRAME_SIZE); }
+        if(buff.ReadableBytes() < 9 + len) { break; }
+        bool ok = OnFrame_(h[3], h[4], Read32(h + 5) & 0x7fffffff, h + 9, len);
+        buff.Retrieve(9 + len);
+        if(!ok) {
+            buff.RetrieveAll();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Http2Session::OnFrame_(uint8_t type, uint8_t flags, uint32_t id, const uint8_t* p, size_t len) {
+    if(!settingsSeen_ && type != FRAME_SETTINGS) { return ConnError_(ERR_PROTOCOL); }  // 客户端前言中的第一个帧必须是SETTINGS
+    if(blockStream_ && (type != FRAME_CONTINUATION || id != blockStream_)) { return ConnError_(ERR_PROTOCOL); }
+    switch(type) {
+    case FRAME_DATA:
+        return OnData_(flags, id, p, len);
+    case FRAME_HEADERS:
+        return OnHeaders_(flags, id, p, len);
+    case FRAME_PRIORITY:
+        if(id == 0) { return ConnError_(ERR_PROTOCOL); }
+        if(len != 5) {
+            ResetStream_(id, ERR_FRAME_SIZE);
+            return true;
+        }
+        if((Read32(p) & 0x7fffffff) == id) {
+            ResetStream_(id, ERR_PROTOCOL);
+            return true;
+        }
+        if(streams_.count(id)) { streams_[id].weight = p[4] + 1; }
+        return true;
+    case FRAME_RST_STREAM:
+        if(id == 0 || id > lastStreamId_) { return ConnError_(ERR_PROTOCOL); }
+        if(len != 4) { return ConnError_(ERR_FRAME_SIZE); }
+        streams_.erase(id);     // ready_与active_中的ID在取出时跳过
+        return true;
+    case FRAME_SETTINGS:
+        return OnSettings_(flags, id, p, len);
+    case FRAME_PUSH_PROMISE:
+        return ConnError_(ERR_PROTOCOL);
+    case FRAME_PING:
+        if(id != 0) { return ConnError_(ERR_PROTOCOL); }
+        if(len != 8) { return ConnError_(ERR_FRAME_SIZE); }
+        if(!(flags & FLAG_ACK)) { SendFrame_(FRAME_PING, FLAG_ACK, 0, p, len); }
+        return true;
+    case FRAME_GOAWAY:
+        if(id != 0) { return ConnError_(ERR_PROTOCOL); }
+        return true;    // 对方不再发起新的流，已有的流照常完成
+    case FRAME_WINDOW_UPDATE:
+        return OnWindowUpdate_(id, p, len);
+    case FRAME_CONTINUATION:
+        if(!blockStream_) { return ConnError_(ERR_PROTOCOL); }
+        block_.append((const char*)p, len);
+        if(block_.size() > MAX_HEADER_BLOCK) { return ConnError_(ERR_ENHANCE_YOUR_CALM); }
+        return (flags & FLAG_END_HEADERS) ? EndHeaderBlock_() : true;
+    default:
+        return true;    // 未知类型的帧忽略
+    }
+}
+
+bool Http2Session::StripPadding_(uint8_t flags, const uint8_t*& p, size_t& len) {
+    if(!(flags & FLAG_PADDED)) { return true; }
+    if(len < 1 || p[0] >= len) { return false; }
+    len -= 1 + p[0];
+    p++;
+    return true;
+}
+
+bool Http2Session::OnData_(uint8_t flags, uint32_t id, const uint8_t* p, size_t len) {
+    if(id == 0) { return ConnError_(ERR_PROTOCOL); }
+    // 流量控制按整个负载（含填充）计算，被忽略的DATA帧也占用连接的窗口
+    size_t frameLen = len;
+    connRecvWindow_ -= frameLen;
+    if(connRecvWindow_ < 0) { return ConnError_(ERR_FLOW_CONTROL); }
+    connUnacked_ += frameLen;
+    if(connUnacked_ >= CONN_WINDOW / 2) {
+        SendWindowUpdate_(0, connUnacked_);
+        connRecvWindow_ += connUnacked_;
+        connUnacked_ = 0;
+    }
+    if(!StripPadding_(flags, p, len)) { return ConnError_(ERR_PROTOCOL); }
+
+    auto it = streams_.find(id);
+    if(it == streams_.end()) {
+        if(id > lastStreamId_) { return ConnError_(ERR_PROTOCOL); }   // 空闲的流
+        return true;    // 已经关闭或重置的流，对方可能还没收到RST_STREAM
+    }
+    Stream_& s = it->second;
+    if(s.remoteClosed) {
+        ResetStream_(id, ERR_STREAM_CLOSED);
+        return true;
+    }
+    s.recvWindow -= frameLen;
+    if(s.recvWindow < 0) {
+        ResetStream_(id, ERR_FLOW_CONTROL);
+        return true;
+    }
+    if(!s.error) {
+        if(s.body.size() + len > HttpRequest::MAX_BODY) {
+            s.error = 413;  // 不再保存，直接响应
+            string().swap(s.body);
+            MarkReady_(id, s);
+        } else {
+            s.body.append((const char*)p, len);
+        }
+    }
+    if(flags & FLAG_END_STREAM) {
+        s.remoteClosed = true;
+        MarkReady_(id, s);
+        return true;
+    }
+    s.unacked += frameLen;
+    if(s.unacked >= STREAM_WINDOW / 2) {
+        SendWindowUpdate_(id, s.unacked);
+        s.recvWindow += s.unacked;
+        s.unacked = 0;
+    }
+    return true;
+}
+
+bool Http2Session::OnHeaders_(uint8_t flags, uint32_t id, const uint8_t* p, size_t len) {
+    if(id == 0) { return ConnError_(ERR_PROTOCOL); }
+    if(!StripPadding_(flags, p, len)) { return ConnError_(ERR_PROTOCOL); }
+    blockWeight_ = 16;
+    blockSelfDep_ = false;
+    if(flags & FLAG_PRIORITY) {
+        if(len < 5) { return ConnError_(ERR_FRAME_SIZE); }
+        blockSelfDep_ = (Read32(p) & 0x7fffffff) == id;
+        blockWeight_ = p[4] + 1;
+        p += 5;
+        len -= 5;
+    }
+    block_.assign((const char*)p, len);
+    blockStream_ = id;
+    blockEndStream_ = flags & FLAG_END_STREAM;
+    return (flags & FLAG_END_HEADERS) ? EndHeaderBlock_() : true;
+}
+
+// 头块已完整：新的请求，或请求体之后的尾部字段
+bool Http2Session::EndHeaderBlock_() {
+    uint32_t id = blockStream_;
+    blockStream_ = 0;
+    auto it = streams_.find(id);
+    if(it == streams_.end() && (id <= lastStreamId_ || !(id & 1))) { return ConnError_(ERR_PROTOCOL); }    // 新的流ID必须是递增的奇数
+    Hpack::HeaderList headers;
+    bool tooLarge = false;
+    // 即使流随后被拒绝也要解码，保持动态表与对方同步
+    if(!hpack_.Decode((const uint8_t*)block_.data(), block_.size(), MAX_HEADER_LIST, &headers, &tooLarge)) {
+        return ConnError_(ERR_COMPRESSION);
+    }
+    string().swap(block_);
+
+    if(it != streams_.end()) {  // 尾部字段，不使用
+        Stream_& s = it->second;
+        if(s.remoteClosed || !blockEndStream_) {
+            ResetStream_(id, s.remoteClosed ? ERR_STREAM_CLOSED : ERR_PROTOCOL);
+            return true;
+        }
+        s.remoteClosed = true;
+        MarkReady_(id, s);
+        return true;
+    }
+
+    lastStreamId_ = id;
+    if(goaway_) { return true; }    // GOAWAY之后的新流不处理
+    if(blockSelfDep_) {
+        ResetStream_(id, ERR_PROTOCOL);
+        return true;
+    }
+    if(streams_.size() >= MAX_CONCURRENT_STREAMS) {
+        ResetStream_(id, ERR_REFUSED_STREAM);
+        return true;
+    }
+    if(!tooLarge && !ValidHeaders_(headers)) {
+        LOG_DEBUG("h2: malformed request on stream %u", id);
+        ResetStream_(id, ERR_PROTOCOL);
+        return true;
+    }
+    Stream_& s = streams_[id];
+    s.window = initialWindow_;
+    s.weight = blockWeight_;
+    s.headers.swap(headers);
+    if(tooLarge) {
+        s.error = 431;
+        MarkReady_(id, s);
+    }
+    if(blockEndStream_) {
+        s.remoteClosed = true;
+        MarkReady_(id, s);
+    }
+    return true;
+}
+
+// 请求的头部是否合法（RFC 9113 8.2、8.3）
+bool Http2Session::ValidHeaders_(const Hpack::HeaderList& headers) {
+    bool regular = false, method = false, path = false, scheme = false, authority = false;
+    for(const auto& h: headers) {
+        const string& name = h.first;
+        if(name.empty()) { return false; }
+        for(char c: h.second) {
+            if(c == '\r' || c == '\n' || c == '\0') { return false; }
+        }
+        if(name[0] == ':') {
+            if(regular) { return false; }   // 伪头部必须在前
+            bool* seen = name == ":method" ? &method : name == ":path" ? &path
+                : name == ":scheme" ? &scheme : name == ":authority" ? &authority : nullptr;
+            if(!seen || *seen) { return false; }
+            *seen = true;
+            if(name == ":path" && h.second.empty()) { return false; }
+            continue;
+        }
+        regular = true;
+        for(char c: name) {
+            if((c >= 'A' && c <= 'Z') || c <= ' ' || c == ':' || c == 0x7f) { return false; }
+        }
+        if(name == "connection" || name == "keep-alive" || name == "proxy-connection"
+           || name == "transfer-encoding" || name == "upgrade") {
+            return false;
+        }
+        if(name == "te" && h.second != "trailers") { return false; }
+    }
+    return method && path && scheme;
+}
+
+bool Http2Session::OnSettings_(uint8_t flags, uint32_t id, const uint8_t* p, size_t len) {
+    if(id != 0) { return ConnError_(ERR_PROTOCOL); }
+    if(flags & FLAG_ACK) {
+        return len == 0 ? true : ConnError_(ERR_FRAME_SIZE);
+    }
+    if(len % 6 != 0) { return ConnError_(ERR_FRAME_SIZE); }
+    uint32_t error = ApplySettings_(p, len);
+    if(error != ERR_NONE) { return ConnError_(error); }
+    settingsSeen_ = true;
+    SendFrame_(FRAME_SETTINGS, FLAG_ACK, 0, nullptr, 0);
+    return true;
+}
+
+uint32_t Http2Session::ApplySettings_(const uint8_t* p, size_t len) {
+    for(size_t i = 0; i + 6 <= len; i += 6) {
+        uint16_t ident = p[i] << 8 | p[i + 1];
+        uint32_t value = Read32(p + i + 2);
+        switch(ident) {
+        case 2:     // SETTINGS_ENABLE_PUSH，本来就不推送
+            if(value > 1) { return ERR_PROTOCOL; }
+            break;
+        case 4: {   // SETTINGS_INITIAL_WINDOW_SIZE，差值作用于所有流的发送窗口
+            if(value > MAX_WINDOW) { return ERR_FLOW_CONTROL; }
+            int64_t delta = (int64_t)value - initialWindow_;
+            for(auto& kv: streams_) {
+                kv.second.window += delta;
+                if(kv.second.window > MAX_WINDOW) { return ERR_FLOW_CONTROL; }
+            }
+            initialWindow_ = value;
+            break;
+        }
+        case 5:     // SETTINGS_MAX_FRAME_SIZE
+            if(value < MAX_FRAME || value > 0xffffff) { return ERR_PROTOCOL; }
+            peerMaxFrame_ = value;
+            break;
+        default:    // 响应头不使用动态表，HEADER_TABLE_SIZE等不影响
+            break;
+        }
+    }
+    return ERR_NONE;
+}
+
+bool Http2Session::OnWindowUpdate_(uint32_t id, const uint8_t* p, size_t len) {
+    if(len != 4) { return ConnError_(ERR_FRAME_SIZE); }
+    uint32_t inc = Read32(p) & 0x7fffffff;
+    if(id == 0) {
+        if(inc == 0) { return ConnError_(ERR_PROTOCOL); }
+        connWindow_ += inc;
+        return connWindow_ > MAX_WINDOW ? ConnError_(ERR_FLOW_CONTROL) : true;
+    }
+    auto it = streams_.find(id);
+    if(it == streams_.end()) {
+        return id > lastStreamId_ ? ConnError_(ERR_PROTOCOL) : true;
+    }
+    if(inc == 0) {
+        ResetStream_(id, ERR_PROTOCOL);
+        return true;
+    }
+    it->second.window += inc;
+    if(it->second.window > MAX_WINDOW) { ResetStream_(id, ERR_FLOW_CONTROL); }
+    return true;
+}
+
+void Http2Session::MarkReady_(uint32_t id, Stream_& s) {
+    if(!s.ready && !s.responded) {
+        s.ready = true;
+        ready_.push_back(id);
+    }
+}
+
+uint32_t Http2Session::NextRequest(int* error) {
+    while(!ready_.empty()) {
+        uint32_t id = ready_.front();
+        ready_.pop_front();
+        auto it = streams_.find(id);
+        if(it == streams_.end()) { continue; }  // 已被重置
+        Stream_& s = it->second;
+        s.ready = false;
+        s.responded = true;     // 之后的帧（如请求体过大后继续到达的DATA）不再使它排队
+        *error = s.error;
+
+        // 转成HTTP/1.1请求：请求行，:authority作为Host，多个cookie合并为一行（RFC 9113 8.2.3）
+        string_view method, path, authority;
+        string cookie;
+        bool host = false, length = false;
+        request_.RetrieveAll();
+        for(const auto& h: s.headers) {
+            if(h.first == ":method") { method = h.second; }
+            else if(h.first == ":path") { path = h.second; }
+            else if(h.first == ":authority") { authority = h.second; }
+        }
+        request_.Append(method.data(), method.size());
+        request_.Append(" ");
+        request_.Append(path.data(), path.size());
+        request_.Append(" HTTP/1.1\r\n");
+        for(const auto& h: s.headers) {
+            const string& name = h.first;
+            if(name.empty() || name[0] == ':' || name == "te" || name == "expect") { continue; }    // 请求体已经完整，不需要100 Continue
+            if(name == "cookie") {
+                if(!cookie.empty()) { cookie += "; "; }
+                cookie += h.second;
+                continue;
+            }
+            if(name == "host") { host = true; }
+            if(name == "content-length") {
+                if(!s.error && h.second != to_string(s.body.size())) {
+                    ResetStream_(id, ERR_PROTOCOL);     // 与实际的请求体长度不一致
+                    break;
+                }
+                length = true;
+            }
+            request_.Append(name);
+            request_.Append(": ");
+            request_.Append(h.second);
+            request_.Append("\r\n");
+        }
+        if(!streams_.count(id)) { continue; }
+        if(!host && !authority.empty()) {
+            request_.Append("host: ");
+            request_.Append(authority.data(), authority.size());
+            request_.Append("\r\n");
+        }
+        if(!cookie.empty()) {
+            request_.Append("cookie: " + cookie + "\r\n");
+        }
+        if(!length && !s.body.empty()) {
+            request_.Append("content-length: " + to_string(s.body.size()) + "\r\n");
+        }
+        request_.Append("\r\n");
+        request_.Append(s.body);
+        Hpack::HeaderList().swap(s.headers);
+        string().swap(s.body);
+        return id;
+    }
+    return 0;
+}
+
+void Http2Session::Respond(uint32_t id, const Buffer& resp, const vector<HttpResponse::FilePart>& parts, bool headOnly) {
+    // 文件映射先交给会话，流已经不存在时随segs一起释放
+    vector<Segment_> segs;
+    for(const HttpResponse::FilePart& part: parts) {
+        shared_ptr<const void> owner = part.owner;
+        if(part.map) {
+            char* map = part.map;
+            size_t mapLen = part.mapLen;
+            owner = shared_ptr<const void>(map, [mapLen](const void* m) { munmap(const_cast<void*>(m), mapLen); });
+        }
+        segs.push_back({ part.data, part.len, owner, part.mapped });
+    }
+    auto it = streams_.find(id);
+    if(it == streams_.end()) { return; }
+    Stream_& s = it->second;
+
+    // 状态行与响应头
+    const char* p = resp.Peek();
+    size_t n = resp.ReadableBytes();
+    const char* end = (const char*)memmem(p, n, "\r\n\r\n", 4);
+    if(!end || n < 12) {
+        LOG_ERROR("h2: bad response on stream %u", id);
+        ResetStream_(id, ERR_INTERNAL);
+        return;
+    }
+    int code = atoi(p + 9);
+    headBlock_.clear();
+    Hpack::EncodeStatus(code, &headBlock_);
+    const char* line = (const char*)memchr(p, '\n', end - p);
+    if(!line) {
+        LOG_ERROR("h2: bad status line on stream %u", id);
+        ResetStream_(id, ERR_INTERNAL);
+        return;
+    }
+    line++;
+    string name;
+    while(line < end + 2) {
+        const char* eol = (const char*)memchr(line, '\r', end + 2 - line);
+        const char* colon = (const char*)memchr(line, ':', eol - line);
+        if(colon) {
+            name.assign(line, colon - line);
+            for(char& c: name) { c = tolower(c); }
+            const char* v = colon + 1;
+            while(v < eol && *v == ' ') { v++; }
+            if(name != "connection" && name != "keep-alive") {
+                Hpack::EncodeField(name, string_view(v, eol - v), &headBlock_);
+            }
+        }
+        line = eol + 2;
+    }
+
+    // 响应体：文件部分之间的内联内容（如multipart的分隔内容）复制到一个字符串中，文件部分不复制
+    size_t bodyStart = end + 4 - p;
+    size_t bodyLen = 0;
+    vector<Segment_> body;
+    shared_ptr<string> inlined = make_shared<string>();
+    vector<pair<size_t, size_t>> pieces;    // 内联内容在inlined中的{偏移, 长度}，nullptr段的位置
+    size_t pos = bodyStart;
+    for(size_t i = 0; i <= segs.size(); i++) {
+        size_t stop = i < segs.size() ? parts[i].pos : n;
+        if(stop > pos) {
+            pieces.push_back({ inlined->size(), stop - pos });
+            inlined->append(p + pos, stop - pos);
+            body.push_back({ nullptr, stop - pos, nullptr, false });
+            bodyLen += stop - pos;
+        }
+        pos = max(pos, stop);
+        if(i < segs.size()) {
+            body.push_back(segs[i]);
+            bodyLen += segs[i].len;
+        }
+    }
+    size_t k = 0;
+    for(Segment_& seg: body) {
+        if(!seg.data && k < pieces.size()) {
+            seg.data = inlined->data() + pieces[k++].first;
+            seg.owner = inlined;
+        }
+    }
+
+    s.responded = true;
+    bool empty = headOnly || bodyLen == 0 || code == 304 || code == 204;
+    SendHeaders_(id, empty);
+    if(empty) {
+        FinishStream_(id, s);
+        return;
+    }
+    for(Segment_& seg: body) {
+        if(seg.len > 0) { s.out.push_back(std::move(seg)); }
+    }
+    s.deficit = 0;
+    active_.push_back(id);
+}
+
+// 头块超过对方的最大帧时拆成HEADERS与CONTINUATION，中间不会插入其他帧
+void Http2Session::SendHeaders_(uint32_t id, bool endStream) {
+    size_t off = 0;
+    uint8_t type = FRAME_HEADERS;
+    do {
+        size_t len = min(headBlock_.size() - off, peerMaxFrame_);
+        bool last = off + len == headBlock_.size();
+        uint8_t flags = (last ? FLAG_END_HEADERS : 0) | (type == FRAME_HEADERS && endStream ? FLAG_END_STREAM : 0);
+        SendFrame_(type, flags, id, headBlock_.data() + off, len);
+        off += len;
+        type = FRAME_CONTINUATION;
+    } while(off < headBlock_.size());
+}
+
+// 响应已全部排队；对方还在发送请求体（如请求体过大）时用RST_STREAM(NO_ERROR)让它停止
+void Http2Session::FinishStream_(uint32_t id, Stream_& s) {
+    if(!s.remoteClosed) {
+        ResetStream_(id, ERR_NONE);
+        return;
+    }
+    streams_.erase(id);
+}
+
+// 加权轮转（deficit round robin）：每一轮每个流的额度增加frame*weight/16字节，额度为正时发送整帧，
+// 同一连接上的多个下载按权重分配带宽，小响应不会排在大文件之后
+size_t Http2Session::Fill(size_t budget) {
+    // h2c升级后等客户端的前言（SETTINGS）到达再发送响应体：那时客户端已处理完101，窗口等设置也已确定
+    if(!settingsSeen_) { return 0; }
+    size_t frame = min(peerMaxFrame_, MAX_SEND_FRAME);
+    size_t queued = 0;
+    uint8_t h[9];
+    bool progress = true;
+    while(progress && !active_.empty() && connWindow_ > 0 && queued < budget) {
+        progress = false;
+        size_t rounds = active_.size();
+        for(size_t r = 0; r < rounds && connWindow_ > 0 && queued < budget; r++) {
+            uint32_t id = active_.front();
+            active_.pop_front();
+            auto it = streams_.find(id);
+            if(it == streams_.end()) { continue; }  // 已被重置
+            Stream_& s = it->second;
+            if(s.window <= 0) {     // 等这个流的WINDOW_UPDATE
+                active_.push_back(id);
+                continue;
+            }
+            s.deficit += frame * s.weight / 16;
+            while(s.deficit > 0 && !s.out.empty() && s.window > 0 && connWindow_ > 0 && queued < budget) {
+                Segment_& seg = s.out.front();
+                size_t len = min({ seg.len, frame, (size_t)s.window, (size_t)connWindow_ });
+                bool last = len == seg.len && s.out.size() == 1;
+                FrameHeader(h, len, FRAME_DATA, last ? FLAG_END_STREAM : 0, id);
+                send_((const char*)h, sizeof(h), seg.data, len, seg.owner);
+                seg.data += len;
+                seg.len -= len;
+                if(seg.len == 0) { s.out.pop_front(); }
+                s.window -= len;
+                connWindow_ -= len;
+                s.deficit -= len;
+                queued += len + sizeof(h);
+                progress = true;
+            }
+            if(s.out.empty()) {
+                FinishStream_(id, s);
+            } else {
+                if(s.deficit > 0) { s.deficit = 0; }    // 因窗口或预算停下的流不积累额度
+                active_.push_back(id);
+            }
+        }
+    }
+    return queued;
+}
+
+bool Http2Session::CanFill() const {
+    if(!settingsSeen_ || connWindow_ <= 0) { return false; }
+    for(uint32_t id: active_) {
+        auto it = streams_.find(id);
+        if(it != streams_.end() && it->second.window > 0) { return true; }
+    }
+    return false;
+}
+
+bool Http2Session::FileCached() const {
+    for(uint32_t id: active_) {
+        auto it = streams_.find(id);
+        if(it == streams_.end()) { continue; }
+        for(const Segment_& seg: it->second.out) {
+            if(seg.mapped && !HttpResponse::PageCached(seg.data, seg.len)) { return false; }
+        }
+    }
+    return true;
+}
+
+void Http2Session::GoAway(uint32_t error) {
+    if(goaway_) { return; }
+    goaway_ = true;
+    uint8_t payload[8];
+    Write32(payload, lastStreamId_);
+    Write32(payload + 4, error);
+    SendFrame_(FRAME_GOAWAY, 0, 0, payload, sizeof(payload));
+}
+
+bool Http2Session::ConnError_(uint32_t error) {
+    LOG_DEBUG("h2: connection error %u", error);
+    GoAway(error);
+    connError_ = true;
+    return false;
+}
+
+void Http2Session::ResetStream_(uint32_t id, uint32_t error) {
+    uint8_t payload[4];
+    Write32(payload, error);
+    SendFrame_(FRAME_RST_STREAM, 0, id, payload, sizeof(payload));
+    streams_.erase(id);
+}
+
+void Http2Session::SendWindowUpdate_(uint32_t id, uint32_t increment) {
+    uint8_t payload[4];
+    Write32(payload, increment);
+    SendFrame_(FRAME_WINDOW_UPDATE, 0, id, payload, sizeof(payload));
+}
+
+// 控制帧与响应头连同帧头一起复制到写缓冲区
+void Http2Session::SendFrame_(uint8_t type, uint8_t flags, uint32_t id, const void* payload, size_t len) {
+    char frame[9 + 256];
+    FrameHeader((uint8_t*)frame, len, type, flags, id);
+    if(len <= sizeof(frame) - 9) {
+        if(len) { memcpy(frame + 9, payload, len); }
+        send_(frame, 9 + len, nullptr, 0, nullptr);
+        return;
+    }
+    string buf(frame, 9);
+    buf.append((const char*)payload, len);
+    send_(buf.data(), buf.size(), nullptr, 0, nullptr);
+}
@@ -0,0 +1,165 @@
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../buffer/buffer.h"
+#include "../log/log.h"
+#include "hpack.h"
+#include "httpresponse.h"
+
+/*
+一个HTTP/2（h2c）连接的会话：帧的收发、流的状态、流量控制与按权重的调度
+连接以前言（prior knowledge）或HTTP/1.1的Upgrade: h2c开始；每个流的请求转成HTTP/1.1格式交给HttpRequest解析，
+HttpResponse生成的HTTP/1.1响应头转成HEADERS帧，响应体（文件映射、压缩缓存、内联内容）不拷贝，直接作为DATA帧的负载发送
+帧通过构造时传入的SendFn排进HttpConn的发送队列；DATA帧受双方流量控制窗口限制，由Fill按流的权重轮流排队
+不支持服务器推送；流的依赖关系不处理，只按权重分配带宽
+*/
+class Http2Session {
+public:
+    // 排队一个帧：head（帧头与内联的负载）复制到写缓冲区，data零拷贝发送，由owner保持有效直到发完
+    typedef std::function<void(const char* head, size_t headLen, const char* data, size_t dataLen,
+                               std::shared_ptr<const void> owner)> SendFn;
+
+    enum FRAME_TYPE {
+        FRAME_DATA = 0,
+        FRAME_HEADERS,
+        FRAME_PRIORITY,
+        FRAME_RST_STREAM,
+        FRAME_SETTINGS,
+        FRAME_PUSH_PROMISE,
+        FRAME_PING,
+        FRAME_GOAWAY,
+        FRAME_WINDOW_UPDATE,
+        FRAME_CONTINUATION,
+    };
+
+    enum ERROR_CODE {
+        ERR_NONE = 0,
+        ERR_PROTOCOL,
+        ERR_INTERNAL,
+        ERR_FLOW_CONTROL,
+        ERR_SETTINGS_TIMEOUT,
+        ERR_STREAM_CLOSED,
+        ERR_FRAME_SIZE,
+        ERR_REFUSED_STREAM,
+        ERR_CANCEL,
+        ERR_COMPRESSION,
+        ERR_CONNECT,
+        ERR_ENHANCE_YOUR_CALM,
+    };
+
+    static constexpr size_t PREFACE_LEN = 24;
+    static const uint32_t MAX_CONCURRENT_STREAMS = 100;
+    static const size_t MAX_FRAME = 16384;          // 接收帧的最大负载，即SETTINGS_MAX_FRAME_SIZE的默认值
+    static const size_t MAX_HEADER_BLOCK = 65536;   // 一个头块（HEADERS加CONTINUATION）压缩后的最大长度，超过按连接错误处理
+    static const size_t MAX_HEADER_LIST = 16384;    // 解码后的头部列表的最大大小，超过返回431
+    static const int64_t CONN_WINDOW = 1 << 24;     // 连接的接收窗口
+    static const int64_t STREAM_WINDOW = 65535;     // 流的接收窗口（默认值，不另行通告）
+
+    explicit Http2Session(SendFn send);
+
+    // p开始的n个字节是否是客户端的连接前言：1是，0目前一致但还不完整，-1不是
+    static int MatchPreface(const char* p, size_t n);
+
+    void Start();   // 发送服务器的连接前言（SETTINGS）并放大连接的接收窗口
+    // h2c升级：应用HTTP2-Settings（base64url编码的SETTINGS负载），升级的请求成为流1；在Start之前调用，值不合法时返回false
+    bool Upgrade(std::string_view settings);
+
+    // 处理缓冲区中完整的帧（先是连接前言）；连接错误时排队GOAWAY并返回false，之后连接应在发完后关闭
+    bool OnRead(Buffer& buff);
+    // 取出下一个请求已完整的流，请求按HTTP/1.1格式写入RequestBuffer()，返回流ID；没有时返回0
+    // 请求体或请求头过大时*error为413或431，此时不必解析请求
+    uint32_t NextRequest(int* error);
+    Buffer& RequestBuffer() { return request_; }
+
+    // 流id的响应：resp为HttpResponse生成的HTTP/1.1响应（响应头与内联的响应体，生成前为空），parts为其中的文件部分，
+    // 文件映射交给会话；headOnly（HEAD请求）时只发送响应头
+    void Respond(uint32_t id, const Buffer& resp, const std::vector<HttpResponse::FilePart>& parts, bool headOnly);
+    Buffer& ResponseBuffer() { return response_; }
+
+    // 按权重在流量控制窗口与budget字节内排队DATA帧，返回排队的字节数
+    size_t Fill(size_t budget);
+    void GoAway(uint32_t error);    // 排队GOAWAY，之后不再接受新的流
+    bool Closing() const { return goaway_; }
+    bool HasStreams() const { return !streams_.empty(); }
+    bool CanFill() const;           // 有响应体待发送且流量控制窗口没有用完
+    bool FileCached() const;        // 待发送的文件内容是否都在页缓存中
+
+private:
+    struct Segment_ {   // 响应体中的一段
+        const char* data;
+        size_t len;
+        std::shared_ptr<const void> owner;
+        bool mapped;    // 在文件映射中（发送时可能缺页）
+    };
+    struct Stream_ {
+        bool remoteClosed = false;  // 收到END_STREAM，请求完整
+        bool ready = false;         // 在ready_中等待NextRequest
+        bool responded = false;     // 响应头已排队
+        int error = 0;              // 请求过大时的响应码
+        int weight = 16;
+        int64_t window = 0;         // 发送窗口
+        int64_t recvWindow = STREAM_WINDOW;
+        int64_t unacked = 0;        // 已接收、还没通过WINDOW_UPDATE归还的字节数
+        int64_t deficit = 0;        // 加权轮转的额度
+        Hpack::HeaderList headers;
+        std::string body;
+        std::deque<Segment_> out;   // 还没排队的响应体
+    };
+
+    bool OnFrame_(uint8_t type, uint8_t flags, uint32_t id, const uint8_t* p, size_t len);
+    bool OnData_(uint8_t flags, uint32_t id, const uint8_t* p, size_t len);
+    bool OnHeaders_(uint8_t flags, uint32_t id, const uint8_t* p, size_t len);
+    bool EndHeaderBlock_();
+    bool OnSettings_(uint8_t flags, uint32_t id, const uint8_t* p, size_t len);
+    uint32_t ApplySettings_(const uint8_t* p, size_t len);   // 返回错误码，ERR_NONE为合法
+    bool OnWindowUpdate_(uint32_t id, const uint8_t* p, size_t len);
+    bool StripPadding_(uint8_t flags, const uint8_t*& p, size_t& len);
+    static bool ValidHeaders_(const Hpack::HeaderList& headers);
+
+    bool ConnError_(uint32_t error);                // 连接错误：GOAWAY，返回false
+    void ResetStream_(uint32_t id, uint32_t error); // 流错误：RST_STREAM并丢弃流
+    void MarkReady_(uint32_t id, Stream_& s);
+    void FinishStream_(uint32_t id, Stream_& s);    // 响应已全部排队
+    void SendFrame_(uint8_t type, uint8_t flags, uint32_t id, const void* payload, size_t len);
+    void SendWindowUpdate_(uint32_t id, uint32_t increment);
+    void SendHeaders_(uint32_t id, bool endStream);
+
+    SendFn send_;
+    Hpack hpack_;
+    std::unordered_map<uint32_t, Stream_> streams_;
+    std::deque<uint32_t> ready_;    // 请求已完整的流，按完整的顺序
+    std::deque<uint32_t> active_;   // 有响应体待发送的流，轮流发送
+
+    bool prefaceSeen_;
+    bool settingsSeen_;     // 客户端前言中的SETTINGS已收到
+    bool goaway_;
+    bool connError_;
+    uint32_t lastStreamId_; // 收到的最大流ID
+
+    uint32_t blockStream_;  // 正在接收头块（等待CONTINUATION）的流，0为没有
+    bool blockEndStream_;
+    int blockWeight_;
+    bool blockSelfDep_;     // 流依赖于自身
+    std::string block_;
+
+    int64_t connWindow_;    // 连接的发送窗口
+    int64_t initialWindow_; // 对方的SETTINGS_INITIAL_WINDOW_SIZE
+    size_t peerMaxFrame_;   // 对方的SETTINGS_MAX_FRAME_SIZE
+    int64_t connRecvWindow_;
+    int64_t connUnacked_;
+
+    Buffer request_;        // NextRequest生成的HTTP/1.1请求
+    Buffer response_;       // HttpResponse生成的HTTP/1.1响应
+    std::string headBlock_; // 编码响应头的临时空间，复用容量
+};
+
+#endif //HTTP2_H
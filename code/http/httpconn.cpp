@@ -1,15 +1,31 @@
 #include "httpconn.h"
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include "../server/serverstats.h"
 using namespace std;
 
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+size_t HttpConn::sendWindow = 0;
+bool HttpConn::sendfile = false;
+std::atomic<bool> HttpConn::draining(false);
 
 HttpConn::HttpConn() 
 { 
     fd_ = -1;   // 文件描述符
     addr_ = { 0 };  // 地址
     isClose_ = true; // 是否关闭
+    parseOk_ = false;
+    errCode_ = 0;
+    streamId_ = 0;
+    wsState_ = WS_NONE;
+    idle_ = false;
+    tasks_ = 0;
+    edge_ = 0;
+    keepAlive_ = true;
+    readPaused_ = false;
+    toWrite_ = 0;
 };
 
 HttpConn::~HttpConn() 
@@ -27,7 +43,15 @@ void HttpConn::init(int fd, const sockaddr_in& addr)
     fd_ = fd;
     writeBuff_.RetrieveAll();   // 清空写缓冲区
     readBuff_.RetrieveAll();    // 清空读缓冲区
+    request_.Init();            // 上一个连接可能留下解析到一半的请求
+    ClearQueue_();              // 上一个连接可能有没发完的响应
+    h2_.reset();
+    ws_.reset();
+    wsState_ = WS_NONE;
+    keepAlive_ = true;
+    readPaused_ = false;
     isClose_ = false;   // 未关闭
+    idle_ = false;      // 第一个请求还在路上，不算空闲
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
@@ -35,6 +59,10 @@ void HttpConn::init(int fd, const sockaddr_in& addr)
 void HttpConn::Close() 
 {
     response_.UnmapFile();
+    ws_.reset();        // 先退出频道，之后不会再有广播投递进来
+    ClearQueue_();
+    h2_.reset();
+    request_.Init();    // 释放未完成的请求（如流式处理的请求体）占用的资源
     if(isClose_ == false)
     {
         isClose_ = true; 
@@ -44,6 +72,22 @@ void HttpConn::Close()
     }
 }
 
+// fd已经被关闭（如io_uring的链式close），不能再close一次，否则可能关掉复用了该fd的新连接
+void HttpConn::OnClosed()
+{
+    response_.UnmapFile();
+    ws_.reset();        // 先退出频道，之后不会再有广播投递进来
+    ClearQueue_();
+    h2_.reset();
+    request_.Init();    // 释放未完成的请求（如流式处理的请求体）占用的资源
+    if(isClose_ == false)
+    {
+        isClose_ = true;
+        userCount--;
+        LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+    }
+}
+
 int HttpConn::GetFd() const 
 {
     return fd_;
@@ -67,84 +111,447 @@ int HttpConn::GetPort() const
 // 读取数据
 ssize_t HttpConn::read(int* saveErrno) {
     ssize_t len = -1;
+    bool full = false;
+    readPaused_ = false;
     do {
-        len = readBuff_.ReadFd(fd_, saveErrno);
+        if(isET && readBuff_.ReadableBytes() >= READ_WINDOW) {
+            readPaused_ = true;     // 先处理已读到的，当作暂时读不到
+            *saveErrno = EAGAIN;
+            return len;
+        }
+        len = readBuff_.ReadFd(fd_, saveErrno, &full);
         if (len <= 0) {
             break;
         }
-    } while (isET); // ET:边沿触发要一次性全部读出
+    } while (isET && full); // ET:边沿触发要一次性全部读出；没读满说明内核缓冲区已经空了，不必再读到EAGAIN
     return len;
 }
 
 // 主要采用writev连续写函数
+// 一次最多写sendWindow字节：写完、窗口用完或缓冲区满（EAGAIN）即返回，剩余部分等下一次可写事件，
+// 慢客户端下载大文件时不会一直占着线程；ET与LT相同
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;
+    size_t budget = sendWindow > 0 ? sendWindow : SIZE_MAX;
+    if(h2_) {
+        // HTTP/2连接发送期间也会收到新的请求与WINDOW_UPDATE，顺带读出，在下一次process中处理
+        int readErrno = 0;
+        bool full = false;
+        readBuff_.ReadFd(fd_, &readErrno, &full);
+    }
     do 
     {
-        len = writev(fd_, iov_, iovCnt_);   // 将iov的内容写到fd中
-        if(len <= 0) {
-            *saveErrno = errno;
-            break;
+        if(!queue_.empty() && queue_.front().head == 0 && queue_.front().fd >= 0) 
+        {   // 文件段：内核直接从页缓存发送，偏移由队列记录
+            const Pending_& p = queue_.front();
+            off_t off = p.offset;
+            len = ::sendfile(fd_, p.fd, &off, std::min(p.fileLen, budget));
+            if(len == 0) { errno = EIO; len = -1; }     // 文件在发送期间被截短
         }
-        if(iov_[0].iov_len + iov_[1].iov_len  == 0) { break; } /* 传输结束 */
-        else if(static_cast<size_t>(len) > iov_[0].iov_len) 
+        else 
         {
-            // iov_[1].iov_base指向第二个iov的剩余内容
-            iov_[1].iov_base = (uint8_t*) iov_[1].iov_base + (len - iov_[0].iov_len);
-            // iov_[1].iov_len更新为剩余长度
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            
-            // 如果iov_[0].iov_len不为0,则表示第一个iov的内容已经全部写入
-            if(iov_[0].iov_len) 
-            {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
+            struct iovec iov[MAX_IOV];
+            bool more = false;
+            int cnt = FillIov_(iov, MAX_IOV, budget, &more);   // 排队的多个响应用一次writev发出
+            if(more) {
+                struct msghdr msg = {};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = cnt;
+                len = sendmsg(fd_, &msg, MSG_MORE);     // 响应头先留在内核中，与文件一起发出
+            } else {
+                len = writev(fd_, iov, cnt);   // 将iov的内容写到fd中
             }
         }
-        // len <= iov_[0].iov_len
-        else 
-        {
-            // 同理，更新iov_[0]的指针和长度，指向未写入的内容
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len; 
-            iov_[0].iov_len -= len; 
-            writeBuff_.Retrieve(len);
+        if(len <= 0) {
+            *saveErrno = errno;
+            break;
         }
-    } while(isET || ToWriteBytes() > 10240);
+        OnSent(len);
+        budget -= len;
+    } while(ToWriteBytes() > 0 && budget > 0);
     return len;
 }
 
-// 判断是否保持连接
-bool HttpConn::process() 
+// 已发送len字节，从队首开始依次扣除，发完的响应释放文件映射
+void HttpConn::OnSent(size_t len)
+{
+    assert(len <= toWrite_);
+    toWrite_ -= len;
+    while(!queue_.empty()) 
+    {
+        Pending_& p = queue_.front();
+        size_t n = std::min(len, p.head);   // 先是响应头
+        p.head -= n;
+        writeBuff_.Retrieve(n);
+        len -= n;
+        n = std::min(len, p.fileLen);       // 然后是文件
+        if(p.fd >= 0) { p.offset += n; }
+        else { p.file += n; }
+        p.fileLen -= n;
+        len -= n;
+        if(p.head > 0 || p.fileLen > 0) { break; }  // 这个响应还没发完
+        if(p.map) { munmap(p.map, p.mapLen); }
+        queue_.pop_front();
+    }
+    if(queue_.empty()) { writeBuff_.RetrieveAll(); }
+}
+
+// 100 Continue是临时响应，排在之前的响应之后，不影响连接是否保持
+void HttpConn::QueueContinue_()
+{
+    static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    writeBuff_.Append(CONTINUE, sizeof(CONTINUE) - 1);
+    queue_.push_back({ sizeof(CONTINUE) - 1, nullptr, 0, nullptr, 0 });
+    toWrite_ += sizeof(CONTINUE) - 1;
+}
+
+// 会话的帧排在发送队列中：帧头（与控制帧、响应头）放在writeBuff_，DATA帧的负载与广播的消息零拷贝，由owner持有到发完
+void HttpConn::QueueFrame_(const char* head, size_t headLen, const char* data, size_t dataLen, shared_ptr<const void> owner)
 {
-    request_.Init();
+    if(headLen > 0) { writeBuff_.Append(head, headLen); }
+    queue_.push_back({ headLen, const_cast<char*>(data), dataLen, nullptr, 0, std::move(owner) });
+    toWrite_ += headLen + dataLen;
+}
+
+std::unique_ptr<Http2Session> HttpConn::NewH2_()
+{
+    return std::unique_ptr<Http2Session>(new Http2Session([this](const char* head, size_t headLen, const char* data,
+                                                                 size_t dataLen, shared_ptr<const void> owner) {
+        QueueFrame_(head, headLen, data, dataLen, std::move(owner));
+    }));
+}
+
+// h2c升级（RFC 7540 3.2）：只升级没有请求体的请求，先发送101，随后的服务器前言与这个请求的响应都是HTTP/2帧
+bool HttpConn::UpgradeH2_()
+{
+    string_view upgrade = request_.GetHeader(HttpRequest::UPGRADE);
+    string_view settings = request_.GetHeader(HttpRequest::HTTP2_SETTINGS);
+    if(upgrade.empty() || settings.empty() || !request_.body().empty()) { return false; }
+    bool h2c = false;
+    while(!upgrade.empty() && !h2c) 
+    {   // 逗号分隔的协议列表
+        size_t comma = upgrade.find(',');
+        string_view token = upgrade.substr(0, comma);
+        while(!token.empty() && token.front() == ' ') { token.remove_prefix(1); }
+        while(!token.empty() && token.back() == ' ') { token.remove_suffix(1); }
+        h2c = token == "h2c";
+        upgrade = comma == string_view::npos ? string_view() : upgrade.substr(comma + 1);
+    }
+    if(!h2c) { return false; }
+    std::unique_ptr<Http2Session> h2 = NewH2_();
+    if(!h2->Upgrade(settings)) { return false; }
+    static const char SWITCHING[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    writeBuff_.Append(SWITCHING, sizeof(SWITCHING) - 1);
+    queue_.push_back({ sizeof(SWITCHING) - 1, nullptr, 0, nullptr, 0 });
+    toWrite_ += sizeof(SWITCHING) - 1;
+    h2_ = std::move(h2);
+    h2_->Start();
+    streamId_ = 1;
+    ServerStats::Add(ServerStats::Instance()->h2Connections);
+    return true;
+}
+
+// WebSocket握手（RFC 6455 4.2.2）：只有注册过的路径接受升级，其他路径上的升级请求按普通请求处理；
+// 握手请求头不合法时返回400。101之后读缓冲区中的数据都是帧，连接加入路径的频道
+bool HttpConn::UpgradeWs_()
+{
+    string_view key;
+    if(!request_.WebSocketUpgrade(&key) || !WebSocket::HasRoute(request_.path())) { return false; }
+    if(key.empty()) 
+    {
+        parseOk_ = false;
+        errCode_ = 400;
+        return false;
+    }
+    string resp = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    resp += WebSocket::AcceptKey(key);
+    resp += "\r\n\r\n";
+    QueueFrame_(resp.data(), resp.size(), nullptr, 0, nullptr);
+    ws_.reset(new WebSocket(request_.path(), fd_, [this](const char* head, size_t headLen, const char* data,
+                                                         size_t dataLen, shared_ptr<const void> owner) {
+        QueueFrame_(head, headLen, data, dataLen, std::move(owner));
+    }));
+    wsState_.store(WS_OPEN, std::memory_order_release);
+    ServerStats::Add(ServerStats::Instance()->wsConnections);
+    return true;
+}
+
+// 处理读缓冲区中的帧，再把收件箱中的消息排进发送队列；WebSocket连接没有要生成的响应，总是返回false
+bool HttpConn::ParseWs_()
+{
+    if(!ws_->OnRead(readBuff_) || !ws_->Flush(toWrite_)) 
+    {   // 关闭握手完成或出错，发完关闭帧后关闭连接
+        keepAlive_ = false;
+    }
+    return false;
+}
+
+void HttpConn::ClearQueue_()
+{
+    for(Pending_& p: queue_) {
+        if(p.map) { munmap(p.map, p.mapLen); }
+    }
+    queue_.clear();
+    toWrite_ = 0;
+    writeBuff_.RetrieveAll();
+}
+
+void HttpConn::OnRecv(const char* data, size_t len)
+{
+    readBuff_.Append(data, len);
+}
+
+int HttpConn::GetIov(struct iovec* iov, int maxIov, size_t maxBytes) const
+{
+    bool more = false;
+    return FillIov_(iov, maxIov, maxBytes, &more);
+}
+
+int HttpConn::FillIov_(struct iovec* iov, int maxIov, size_t maxBytes, bool* more) const
+{
+    int cnt = 0;
+    const char* head = writeBuff_.Peek();  // 各响应头在writeBuff_中首尾相接
+    for(const Pending_& p: queue_) {
+        if(cnt >= maxIov || maxBytes == 0) { break; }
+        if(p.head > 0) {
+            iov[cnt].iov_base = const_cast<char*>(head);
+            iov[cnt].iov_len = std::min(p.head, maxBytes);
+            maxBytes -= iov[cnt].iov_len;
+            head += p.head;
+            cnt++;
+        }
+        if(p.fd >= 0 && p.fileLen > 0) {
+            *more = maxBytes > 0;   // 响应头全部放进了iov
+            break;
+        }
+        if(p.fileLen > 0 && cnt < maxIov && maxBytes > 0) {
+            iov[cnt].iov_base = p.file;
+            iov[cnt].iov_len = std::min(p.fileLen, maxBytes);
+            maxBytes -= iov[cnt].iov_len;
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+bool HttpConn::FileCached() const
+{
+    for(const Pending_& p: queue_) {
+        if(p.fileLen > 0 && p.mapped && !HttpResponse::PageCached(p.file, p.fileLen)) { return false; }
+        if(p.fileLen > 0 && p.fd >= 0 && !HttpResponse::PageCached(p.fd, p.offset, p.fileLen)) { return false; }
+    }
+    return true;
+}
+
+static bool EdgeRunnable(uint64_t s) {
+    return (s & (HttpConn::EDGE_READ | HttpConn::EDGE_HUP)) ||
+           ((s & HttpConn::EDGE_WRITE) && (s & HttpConn::EDGE_WANT_WRITE));
+}
+
+// 不在等可写时的EPOLLOUT只记入，不分发
+bool HttpConn::EdgeLatch(uint64_t tag, uint32_t bits)
+{
+    uint64_t cur = edge_.load(std::memory_order_acquire);
+    uint64_t nxt;
+    do {
+        if((cur >> 32) != (tag >> 32)) { return false; }
+        nxt = cur | bits;
+        if(!(cur & EDGE_BUSY) && EdgeRunnable(nxt)) { nxt |= EDGE_BUSY; }
+    } while(!edge_.compare_exchange_weak(cur, nxt, std::memory_order_acq_rel, std::memory_order_acquire));
+    return !(cur & EDGE_BUSY) && (nxt & EDGE_BUSY);
+}
+
+bool HttpConn::EdgeAcquire(uint64_t tag)
+{
+    uint64_t cur = edge_.load(std::memory_order_acquire);
+    do {
+        if((cur >> 32) != (tag >> 32) || (cur & EDGE_BUSY)) { return false; }
+    } while(!edge_.compare_exchange_weak(cur, cur | EDGE_BUSY, std::memory_order_acq_rel, std::memory_order_acquire));
+    return true;
+}
+
+uint32_t HttpConn::EdgeTake()
+{
+    uint64_t events = EDGE_READ | EDGE_WRITE | EDGE_HUP;
+    return (uint32_t)(edge_.fetch_and(~events, std::memory_order_acq_rel) & events);
+}
+
+bool HttpConn::EdgeRelease()
+{
+    uint64_t cur = edge_.load(std::memory_order_acquire);
+    do {
+        if(EdgeRunnable(cur)) { return false; }
+    } while(!edge_.compare_exchange_weak(cur, cur & ~(uint64_t)EDGE_BUSY, std::memory_order_acq_rel, std::memory_order_acquire));
+    return true;
+}
+
+void HttpConn::EdgeWantWrite(bool want)
+{
+    if(want) { edge_.fetch_or(EDGE_WANT_WRITE, std::memory_order_acq_rel); }
+    else { edge_.fetch_and(~(uint64_t)EDGE_WANT_WRITE, std::memory_order_acq_rel); }
+}
+
+// 流水线：读缓冲区中完整的请求逐个生成响应，一起发送
+int HttpConn::process() 
+{
+    int n = 0;
+    while(ParseRequest()) 
+    {
+        MakeResponse();
+        n++;
+    }
+    return n;
+}
+
+bool HttpConn::ParseRequest(bool holdBody)
+{
+    if(!IsKeepAlive()) { return false; }    // 之后的请求不会再响应
+    if(h2_) { return ParseH2_(); }
+    if(ws_) { return ParseWs_(); }
+    if(queue_.size() >= (size_t)MAX_PIPELINE) { return false; }     // 先发完这一批
+    if(request_.IsFinish()) 
+    {   // 上一个请求已经响应，开始解析下一个；未完成的请求保留解析进度
+        request_.Init();
+    }
     if(readBuff_.ReadableBytes() <= 0) 
     {
         return false;
     }
-    else if(request_.parse(readBuff_)) 
+    if(!request_.InBody()) 
+    {   // 以HTTP/2连接前言开始的连接（prior knowledge）
+        int m = Http2Session::MatchPreface(readBuff_.Peek(), readBuff_.ReadableBytes());
+        if(m == 0) { return false; }
+        if(m > 0) 
+        {
+            h2_ = NewH2_();
+            h2_->Start();
+            ServerStats::Add(ServerStats::Instance()->h2Connections);
+            return ParseH2_();
+        }
+    }
+    HttpRequest::PARSE_RESULT res = request_.parse(readBuff_, holdBody);
+    if(res == HttpRequest::PARSE_AGAIN) 
+    {
+        if(request_.TakeContinue()) { QueueContinue_(); }
+        return false;
+    }
+    parseOk_ = (res == HttpRequest::PARSE_OK);
+    errCode_ = request_.ErrorCode();
+    if(parseOk_ && !UpgradeH2_() && UpgradeWs_()) { return ParseWs_(); }
+    return true;
+}
+
+// 处理读缓冲区中的帧，逐个取出请求已完整的流；没有时按预算排队响应体并返回false
+bool HttpConn::ParseH2_()
+{
+    if(!h2_->OnRead(readBuff_)) 
+    {   // 连接错误，发完GOAWAY后关闭
+        keepAlive_ = false;
+        return false;
+    }
+    if(draining) { h2_->GoAway(Http2Session::ERR_NONE); }   // 已经收到的流照常完成
+    int error = 0;
+    while((streamId_ = h2_->NextRequest(&error)) != 0) 
+    {
+        ServerStats::Add(ServerStats::Instance()->h2Streams);
+        request_.Init();
+        if(error) 
+        {   // 请求体或请求头过大，不解析
+            parseOk_ = false;
+            errCode_ = error;
+            return true;
+        }
+        HttpRequest::PARSE_RESULT res = request_.parse(h2_->RequestBuffer());
+        parseOk_ = (res == HttpRequest::PARSE_OK);
+        errCode_ = res == HttpRequest::PARSE_AGAIN ? 400 : request_.ErrorCode();
+        return true;
+    }
+    if(toWrite_ < H2_QUEUED) { h2_->Fill(H2_QUEUED - toWrite_); }
+    return false;
+}
+
+void HttpConn::InitResponse_()
+{
+    string_view inm = request_.GetHeader(HttpRequest::IF_NONE_MATCH);
+    string_view ims = request_.GetHeader(HttpRequest::IF_MODIFIED_SINCE);
+    if((!inm.empty() || !ims.empty()) && (request_.method() == "GET" || request_.method() == "HEAD")) 
+    {   // 条件请求
+        response_.SetConditional(inm, ims);
+        ServerStats::Add(ServerStats::Instance()->conditional);
+    }
+    if(request_.method() == "GET" || request_.method() == "HEAD") 
+    {
+        response_.SetAcceptEncoding(request_.GetHeader(HttpRequest::ACCEPT_ENCODING));
+    }
+    string_view range = request_.GetHeader(HttpRequest::RANGE);
+    if(!range.empty() && request_.method() == "GET") 
+    {   // 只有GET请求的Range有意义
+        response_.SetRange(range, request_.GetHeader(HttpRequest::IF_RANGE));
+    }
+}
+
+void HttpConn::MakeResponse()
+{
+    if(h2_ && streamId_) 
+    {
+        MakeH2Response_();
+        return;
+    }
+    if(parseOk_) 
     {    // 解析成功
+        int code = request_.Handle();   // 路由到的处理函数，登录/注册时访问数据库
         LOG_DEBUG("%s", request_.path().c_str());
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
+        response_.Init(srcDir, request_.path(), request_.IsKeepAlive() && IsKeepAlive(), code);
+        InitResponse_();
+        response_.SetHeadOnly(request_.method() == "HEAD");     // 流水线上HEAD的响应体会被当成下一个响应
     } 
     else 
     {
-        response_.Init(srcDir, request_.path(), false, 400);
+        response_.Init(srcDir, request_.path(), false, errCode_);
     }
 
-    response_.MakeResponse(writeBuff_); // 生成响应报文放入writeBuff_中
-    // 响应头
-    iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-
-    // 文件
-    if(response_.FileLen() > 0  && response_.File()) 
+    size_t before = writeBuff_.ReadableBytes();
+    // 生成响应报文追加到writeBuff_中，接在前面排队的响应头之后；GET/HEAD与出错的请求可以用完整响应缓存
+    response_.MakeResponse(writeBuff_, sendfile, !parseOk_ || request_.method() == "GET" || request_.method() == "HEAD");
+    if(response_.Code() == 304) { ServerStats::Add(ServerStats::Instance()->notModified); }
+    // 每段文件与它之前的响应头（或multipart分隔内容）排成一项；文件映射交给队列，response_处理下一个请求时不会解除它
+    size_t pos = before;
+    for(const HttpResponse::FilePart& part: response_.FileParts()) 
     {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+        queue_.push_back({ part.pos - pos, part.data, part.len, part.map, part.mapLen, part.owner, part.fd, part.offset, part.mapped });
+        toWrite_ += part.pos - pos + part.len;
+        pos = part.pos;
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen() , iovCnt_, ToWriteBytes());
-    return true;
+    if(writeBuff_.ReadableBytes() > pos || response_.FileParts().empty()) 
+    {   // 没有文件，或文件之后还有内容（multipart的结束分隔行）
+        queue_.push_back({ writeBuff_.ReadableBytes() - pos, nullptr, 0, nullptr, 0 });
+        toWrite_ += writeBuff_.ReadableBytes() - pos;
+    }
+    response_.ReleaseFile();
+    if(!response_.IsKeepAlive()) { keepAlive_ = false; }  // 这个响应之后关闭连接
+    LOG_DEBUG("%d responses, %zu to write", (int)queue_.size(), toWrite_);
 }
 
+// HTTP/2的流：响应同样先生成HTTP/1.1格式，由会话转成HEADERS帧，响应体留在会话中由Fill按流量控制发送；
+// 出错的请求只影响这个流，连接保持
+void HttpConn::MakeH2Response_()
+{
+    if(parseOk_) 
+    {
+        int code = request_.Handle();
+        LOG_DEBUG("h2 stream %u: %s", streamId_, request_.path().c_str());
+        response_.Init(srcDir, request_.path(), true, code);
+        InitResponse_();
+    } 
+    else 
+    {
+        response_.Init(srcDir, request_.path(), true, errCode_);
+    }
+    Buffer& out = h2_->ResponseBuffer();
+    out.RetrieveAll();
+    response_.MakeResponse(out);
+    if(response_.Code() == 304) { ServerStats::Add(ServerStats::Instance()->notModified); }
+    h2_->Respond(streamId_, out, response_.FileParts(), request_.method() == "HEAD");
+    response_.ReleaseFile();
+    streamId_ = 0;
+}
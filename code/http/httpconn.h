@@ -6,13 +6,22 @@
 #include <arpa/inet.h>   // sockaddr_in
 #include <stdlib.h>      // atoi()
 #include <errno.h>      
+#include <stdint.h>      // SIZE_MAX
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 
 #include "../log/log.h"
 #include "../buffer/buffer.h"
 #include "httprequest.h"
 #include "httpresponse.h"
+#include "http2.h"
+#include "websocket.h"
 /*
 进行读写数据并调用httprequest 来解析数据以及httpresponse来生成响应
+HTTP/2（h2c）连接由Http2Session收发帧，每个流的请求同样经httprequest解析、httpresponse生成响应
+升级为WebSocket的连接由WebSocket会话解析帧，广播的消息从会话的收件箱零拷贝地排进发送队列
 */
 class HttpConn {
 public:
@@ -21,25 +30,104 @@ public:
     
     void init(int sockFd, const sockaddr_in& addr); // 初始化
     ssize_t read(int* saveErrno);   // 读
-    ssize_t write(int* saveErrno);  // 写
+    // ET下读缓冲区中未处理的数据达到READ_WINDOW时停止读，剩下的留在内核中（TCP按窗口限速客户端）；
+    // 处理之后须接着读，不会再有新的边沿通知
+    bool ReadPaused() const { return readPaused_; }
+    // 写；sendfile模式下文件段之前的响应头以MSG_MORE发送（与文件的第一段合成满的报文），文件段用sendfile从fd发送
+    ssize_t write(int* saveErrno);
     void Close();                // 关闭
     int GetFd() const;         // 获取文件描述符
     int GetPort() const;    // 获取端口
     const char* GetIP() const;  // 获取IP
     sockaddr_in GetAddr() const;    // 获取地址
-    bool process(); // 处理请求
+    // 处理读缓冲区中所有完整的请求（HTTP/1.1流水线），响应按请求的顺序排队，返回排队的响应数；
+    // 返回0时也可能排队了100 Continue、HTTP/2或WebSocket的帧，ToWriteBytes()不为0时要发送
+    int process();
 
-    // 写的总长度
-    int ToWriteBytes() 
-    { 
-        return iov_[0].iov_len + iov_[1].iov_len; 
+    // process分为两步，reactor + 线程池模型下由reactor决定第二步在哪个线程执行
+    // 解析下一个请求，不访问数据库；请求还不完整（解析进度保留到下次）、已排队的响应达到上限
+    // 或已排队了要关闭连接的响应时返回false
+    bool ParseRequest(bool holdBody = false);     // holdBody见HttpRequest::parse
+    bool NeedBlocking() const { return request_.NeedBlocking(); }
+    bool BodyHeld() const { return !h2_ && !ws_ && request_.BodyHeld(); }  // 请求体要在线程池中读取与处理
+    void MakeResponse();    // 用户验证（如果需要）并生成响应，加入发送队列
+    bool FileCached() const;    // 队列中待发送的文件是否都在页缓存中
+
+    // 完成式I/O（io_uring）使用：收发由外部完成，HttpConn只负责缓冲与请求处理
+    void OnRecv(const char* data, size_t len);  // 收到的数据追加到读缓冲区
+    // 待发送部分的前maxBytes字节按顺序（响应头、文件、下一个响应头……）填入最多maxIov个iov，返回iov个数
+    int GetIov(struct iovec* iov, int maxIov, size_t maxBytes) const;
+    void OnSent(size_t len);                    // 已发送len字节
+    void OnClosed();                            // fd已由外部关闭，只做清理
+    // 读缓冲区中还有数据，或HTTP/2连接还有能发送的响应体（每次process排队一部分，期间仍处理新的请求），
+    // 或WebSocket连接的收件箱中有消息
+    bool HasReadBytes() const {
+        return readBuff_.ReadableBytes() > 0 || (h2_ && h2_->CanFill()) || (ws_ && ws_->HasInbox());
     }
 
+    // 写的总长度
+    size_t ToWriteBytes() const { return toWrite_; }
+
+    // 已排队的响应都保持连接；优雅退出期间不再保持连接，响应发完即关闭（HTTP/2连接等已接受的流都完成）
     bool IsKeepAlive() const {
-        return request_.IsKeepAlive();
+        return keepAlive_ && (!draining || (h2_ && h2_->HasStreams()));
+    }
+
+    // 空闲：keep-alive连接在等下一个请求，优雅退出时可以直接关闭；流式接收请求体的中途不算空闲
+    // 由reactor在分发事件前清除、在响应发完重新注册读事件前设置
+    void SetIdle(bool idle) {
+        idle_.store(idle && !request_.InBody() && !(h2_ && h2_->HasStreams()), std::memory_order_release);
     }
+    bool IsIdle() const { return idle_.load(std::memory_order_acquire); }
+
+    // 线程池中引用本连接的任务数：投递任务时加1，任务函数返回后减1；计数跟着对象走，init不清零。
+    // 非0时工作线程可能还在读写fd，超时不能关闭连接，否则fd被复用后会写到新连接上
+    void TaskBegin() { tasks_.fetch_add(1, std::memory_order_relaxed); }
+    void TaskEnd() { tasks_.fetch_sub(1, std::memory_order_release); }
+    bool InTask() const { return tasks_.load(std::memory_order_acquire) > 0; }
+
+    // 免重新注册的边沿触发模式：fd只注册一次EPOLLIN|EPOLLOUT|EPOLLET，不再epoll_ctl。
+    // reactor把就绪事件记入状态字，把连接从空闲改为EDGE_BUSY的线程成为持有者并处理它，
+    // 持有期间到来的事件只记入状态字，由持有者释放前重新检查；状态字高32位是连接的代数，过期的事件不会记入新连接
+    enum EDGE_STATE {
+        EDGE_BUSY = 1,          // 有线程持有连接
+        EDGE_READ = 2,          // 可读
+        EDGE_WRITE = 4,         // 可写
+        EDGE_WANT_WRITE = 8,    // 响应没发完，在等可写
+        EDGE_HUP = 16,          // 对端关闭或出错
+    };
+    void EdgeInit(uint64_t tag) { edge_.store(tag & ~0xFFFFFFFFULL, std::memory_order_release); }
+    bool EdgeLatch(uint64_t tag, uint32_t bits);    // 记入事件，返回true表示调用者成为持有者
+    bool EdgeAcquire(uint64_t tag);                 // 没有持有者时成为持有者（超时、优雅退出关闭连接前）
+    uint32_t EdgeTake();                            // 持有者取走已记入的事件
+    bool EdgeRelease();                             // 没有待处理的事件时释放；否则返回false，调用者继续持有
+    void EdgeWantWrite(bool want);
+    bool EdgeWantsWrite() const { return edge_.load(std::memory_order_acquire) & EDGE_WANT_WRITE; }
+
+    // 一次最多排队的项数，剩下的请求等这一批发完再处理；一般一个响应一项，多个范围的206每个范围一项
+    // WebSocket：收件箱由空变为非空时服务器通知处理该连接的线程（WebSocket::SetWaker）
+    // reactor + 线程池模型下，升级后的连接交回reactor线程处理（WS_INLINE），之后收件箱只在reactor线程中排进发送队列
+    enum WS_STATE {
+        WS_NONE = 0,
+        WS_OPEN,        // 已升级
+        WS_INLINE,      // 已由reactor线程接管
+    };
+    bool IsWebSocket() const { return wsState_.load(std::memory_order_acquire) != WS_NONE; }
+    bool WsInline() const { return wsState_.load(std::memory_order_acquire) == WS_INLINE; }
+    void SetWsInline() { if(IsWebSocket()) { wsState_.store(WS_INLINE, std::memory_order_release); } }
+    // 空闲超时时投递保活Ping；上一个Ping之后没有收到过任何帧时返回false，应关闭连接
+    bool WsPing() { return ws_ && ws_->Ping(); }
+
+    static const int MAX_PIPELINE = 32;
+    static const int MAX_IOV = MAX_PIPELINE * 2;    // 每项最多两段：响应头（或分隔内容）与文件
+    static const size_t H2_QUEUED = 256 << 10;      // HTTP/2连接每次最多排队的响应体字节数，之后的等这些发完
+    // 大于在内存中攒齐的最大请求（请求头加分块编码的原始请求体），流式的请求体（上传）边读边处理，内存与长度无关
+    static const size_t READ_WINDOW = 4 << 20;
 
     static bool isET;
+    static size_t sendWindow;   // 每次可写事件最多发送的字节数，0为不限
+    static bool sendfile;       // 静态文件用sendfile发送，不映射（HTTP/2与io_uring后端仍映射）
+    static std::atomic<bool> draining;  // 服务器正在优雅退出
     static const char* srcDir;
     static std::atomic<int> userCount;  // 原子，支持锁
     
@@ -48,16 +136,55 @@ private:
     int fd_;
     struct  sockaddr_in addr_;
 
+    // 排队的响应：响应头按顺序连续地放在writeBuff_中，文件映射由队列持有，发完后释放；
+    // 多个范围的206拆成多项，每项是一段分隔内容与一段文件
+    struct Pending_ {
+        size_t head;        // 响应头还没发送的字节数
+        char* file;         // 文件还没发送的部分，sendfile时为nullptr
+        size_t fileLen;
+        char* map;          // 本次响应自己的映射，没有文件、内容在压缩缓存或打开文件缓存的映射中、sendfile时为nullptr
+        size_t mapLen;
+        std::shared_ptr<const void> owner;  // 压缩结果（或HTTP/2的DATA帧）、打开文件缓存的条目（fd与映射）
+        int fd = -1;        // sendfile：文件还没发送的部分从offset开始
+        off_t offset = 0;
+        bool mapped = false;    // file在文件映射中
+    };
+    // 同GetIov，遇到sendfile的文件段时停在它之前；*more表示iov正好结束在文件段之前（文件紧接着发送）
+    int FillIov_(struct iovec* iov, int maxIov, size_t maxBytes, bool* more) const;
+    void ClearQueue_();
+    // 排队一个帧（HTTP/2、WebSocket）：head复制到writeBuff_，data零拷贝发送，由owner持有到发完
+    void QueueFrame_(const char* head, size_t headLen, const char* data, size_t dataLen, std::shared_ptr<const void> owner);
+    void QueueContinue_();  // 请求带有Expect: 100-continue，请求体到达之前先发送100 Continue
+    void InitResponse_();   // 解析成功的请求：条件请求、内容编码与Range
+    std::unique_ptr<Http2Session> NewH2_();
+    bool UpgradeH2_();      // 请求带有Upgrade: h2c时切换到HTTP/2，这个请求成为流1
+    bool ParseH2_();
+    void MakeH2Response_();
+    bool UpgradeWs_();      // 注册过的路径上的WebSocket握手，回复101
+    bool ParseWs_();
+
     bool isClose_;
+    bool parseOk_;
+    int errCode_;           // 解析失败时的响应码
+    bool keepAlive_;        // 已排队的响应都没有要求关闭连接
+    bool readPaused_;       // 上次读到READ_WINDOW停止，内核中可能还有数据
+    std::atomic<bool> idle_;
+    std::atomic<int> tasks_;
+    std::atomic<uint64_t> edge_;    // 代数 << 32 | EDGE_STATE
     
-    int iovCnt_;
-    struct iovec iov_[2];
+    std::deque<Pending_> queue_;    // 待发送的响应，按请求的顺序
+    size_t toWrite_;                // 队列中还没发送的总字节数
     
     Buffer readBuff_; // 读缓冲区
     Buffer writeBuff_; // 写缓冲区
 
     HttpRequest request_;
     HttpResponse response_;
+
+    std::unique_ptr<Http2Session> h2_;  // HTTP/1.1连接为空
+    uint32_t streamId_;                 // 正在生成响应的流
+    std::unique_ptr<WebSocket> ws_;     // 没有升级为WebSocket时为空
+    std::atomic<int> wsState_;          // WS_STATE，由其他线程读取
 };
 
 #endif
@@ -1,135 +1,434 @@
 #include "httprequest.h"
 using namespace std;
 
-// 默认html
-const unordered_set<string> HttpRequest::DEFAULT_HTML{
-            "/index", "/register", "/login",
-             "/welcome", "/video", "/picture", };
+unordered_map<string, HttpRequest::BodyHandlerFactory> HttpRequest::bodyHandlers_;
 
-// 默认html标签
-const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
-            {"/register.html", 0}, {"/login.html", 1},  };
+// 分块编码的解析位置
+enum { CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, CHUNK_TRAILER };
+
+void HttpRequest::AddBodyHandler(const string& path, BodyHandlerFactory factory) {
+    bodyHandlers_[path] = std::move(factory);
+}
 
 // 初始化
 void HttpRequest::Init() {
-    method_ = path_ = version_ = body_ = "";
+    method_ = path_ = version_ = "";
+    body_ = string_view();
+    if(bodyBuf_.capacity() > 64 * 1024) { string().swap(bodyBuf_); }   // 大的请求体不一直占着内存
+    bodyBuf_.clear();
+    headCopy_.clear();
+    handler_ = nullptr;     // 中止的流式处理随处理函数析构释放资源
     state_ = REQUEST_LINE;
-    header_.clear();
+    route_ = nullptr;
+    params_.count = 0;
+    errCode_ = 0;
+    scan_ = lineStart_ = headLen_ = contentLength_ = chunkLeft_ = bodyRead_ = 0;
+    hasLength_ = chunked_ = keepAlive_ = continue_ = false;
+    chunkState_ = CHUNK_SIZE;
+    head_ = nullptr;
+    fieldCount_ = 0;
+    overflow_.clear();
+    memset(known_, 0, sizeof(known_));
     post_.clear();
 }
 
+bool HttpRequest::TakeContinue() {
+    bool c = continue_;
+    continue_ = false;
+    return c;
+}
+
 // 是否保持连接
 bool HttpRequest::IsKeepAlive() const {
-    if(header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+    return keepAlive_;
+}
+
+// 只转换ASCII字母，不经过locale
+static inline char LowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// 不区分大小写比较
+static bool EqualNoCase(string_view a, string_view b) {
+    if(a.size() != b.size()) { return false; }
+    for(size_t i = 0; i < a.size(); i++) {
+        if(LowerAscii(a[i]) != LowerAscii(b[i])) { return false; }
+    }
+    return true;
+}
+
+// 逗号分隔的列表（如Connection: keep-alive, Upgrade）中是否含有token
+static bool HasToken(string_view list, string_view token) {
+    while(!list.empty()) {
+        size_t comma = list.find(',');
+        string_view item = list.substr(0, comma);
+        while(!item.empty() && (item.front() == ' ' || item.front() == '\t')) { item.remove_prefix(1); }
+        while(!item.empty() && (item.back() == ' ' || item.back() == '\t')) { item.remove_suffix(1); }
+        if(EqualNoCase(item, token)) { return true; }
+        if(comma == string_view::npos) { break; }
+        list.remove_prefix(comma + 1);
     }
     return false;
 }
 
+bool HttpRequest::WebSocketUpgrade(string_view* key) const {
+    *key = string_view();
+    if(method_ != "GET" || version_ != "1.1") { return false; }
+    if(!HasToken(GetHeader(UPGRADE), "websocket") || !HasToken(GetHeader(CONNECTION), "upgrade")) { return false; }
+    if(GetHeader(SEC_WEBSOCKET_VERSION) != "13") { return true; }
+    // 16字节的base64是22个字符加"=="
+    string_view k = GetHeader(SEC_WEBSOCKET_KEY);
+    if(k.size() != 24 || k.substr(22) != "==") { return true; }
+    for(size_t i = 0; i < 22; i++) {
+        char c = k[i];
+        bool b64 = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '/';
+        if(!b64) { return true; }
+    }
+    *key = k;
+    return true;
+}
+
+// 常用请求头的名字（小写），顺序与HEADER一致
+static constexpr string_view KNOWN_HEADER[HttpRequest::HEADER_COUNT] = {
+    "host", "connection", "content-length", "content-type", "transfer-encoding", "expect",
+    "accept-encoding", "if-none-match", "if-modified-since", "range", "if-range", "cookie", "upgrade",
+    "http2-settings", "sec-websocket-key", "sec-websocket-version",
+};
+
+// 完美哈希：首尾字符（不区分大小写）与长度映射到32个槽，常用请求头各占一个；
+// 槽位表在编译期建好，增加请求头后有冲突时编译失败，需要调整系数
+static constexpr size_t HeaderHash(string_view name) {
+    return (((unsigned char)name.front() | 0x20) * 4 + ((unsigned char)name.back() | 0x20) * 5 + name.size()) & 31;
+}
+
+struct HeaderSlots {
+    int8_t slot[32];    // 槽位对应的HEADER，-1为空
+    bool ok;            // 没有冲突
+};
+
+static constexpr HeaderSlots MakeHeaderSlots() {
+    HeaderSlots t = {};
+    for(int i = 0; i < 32; i++) { t.slot[i] = -1; }
+    t.ok = true;
+    for(int h = 0; h < HttpRequest::HEADER_COUNT; h++) {
+        size_t k = HeaderHash(KNOWN_HEADER[h]);
+        if(t.slot[k] >= 0) { t.ok = false; }
+        t.slot[k] = h;
+    }
+    return t;
+}
+
+static constexpr HeaderSlots HEADER_SLOTS = MakeHeaderSlots();
+static_assert(HEADER_SLOTS.ok, "known header names collide in HeaderHash");
+
+int HttpRequest::KnownHeader_(string_view name) {
+    if(name.empty()) { return -1; }
+    int h = HEADER_SLOTS.slot[HeaderHash(name)];
+    return (h >= 0 && EqualNoCase(name, KNOWN_HEADER[h])) ? h : -1;
+}
+
+string_view HttpRequest::GetHeader(HEADER h) const {
+    if(!head_ || known_[h] == 0) { return string_view(); }
+    return ValueOf_(FieldAt_(known_[h] - 1));
+}
+
+string_view HttpRequest::GetHeader(string_view key) const {
+    int h = KnownHeader_(key);
+    if(h >= 0) { return GetHeader((HEADER)h); }
+    if(!head_) { return string_view(); }
+    for(size_t i = 0; i < fieldCount_; i++) {
+        const Field_& f = FieldAt_(i);
+        if(EqualNoCase(string_view(head_ + f.name, f.nameLen), key)) { return ValueOf_(f); }
+    }
+    return string_view();
+}
+
 // 解析处理
-bool HttpRequest::parse(Buffer& buff) 
+HttpRequest::PARSE_RESULT HttpRequest::parse(Buffer& buff, bool holdBody) 
 {
-    const char CRLF[] = "\r\n";      // 行结束符标志(回车换行)
-    if(buff.ReadableBytes() <= 0) { // 没有可读的字节
-        return false;
-    }
-    // 读取数据
-    while(buff.ReadableBytes() && state_ != FINISH) {
-        // 从buff中的读指针开始到读指针结束，这块区域是未读取得数据并去处"\r\n"，返回有效数据得行末指针
-        const char* lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        // 转化为string类型
-        std::string line(buff.Peek(), lineEnd);
-        switch(state_)
-        {
-        /*
-            有限状态机，从请求行开始，每处理完后会自动转入到下一个状态    
-        */
-        case REQUEST_LINE:
-            if(!ParseRequestLine_(line)) 
-            {
-                return false;
-            }
-            ParsePath_();   // 解析路径
-            break;    
-        case HEADERS:
-            ParseHeader_(line);
-            if(buff.ReadableBytes() <= 2) { 
-                state_ = FINISH;
-            }
-            break;
-        case BODY:
-            ParseBody_(line);
-            break;
-        default:
+    if(state_ == FINISH) { return errCode_ ? PARSE_ERROR : PARSE_OK; }
+    const char* begin = buff.Peek();
+    size_t len = buff.ReadableBytes();
+    // 有限状态机，逐行处理请求行与请求头；行以"\r\n"结尾，也接受单独的"\n"
+    // 按FIELD字符集扫描，停在\r、\n或非法字节上，找行尾的同时校验了整行；最多扫描到请求头的长度上限
+    size_t limit = min(len, MAX_HEAD + 1);
+    while(state_ == REQUEST_LINE || state_ == HEADERS) {
+        size_t pos = scan_ < limit ? scan_ + HttpScan::Span(begin + scan_, limit - scan_, HttpScan::FIELD) : limit;
+        if(pos < limit && begin[pos] == '\r' && pos + 1 == len) {
+            scan_ = pos;    // \n还没到，下次从\r重新判断
+            return PARSE_AGAIN;
+        }
+        if(pos >= limit) {
+            scan_ = limit;  // 下次从这里继续找
+            if(state_ == REQUEST_LINE && len - lineStart_ > MAX_LINE) { return Fail_(buff, 414); }
+            if(len > MAX_HEAD) { return Fail_(buff, 431); }
+            return PARSE_AGAIN;
+        }
+        size_t start = lineStart_;
+        size_t end = pos;
+        if(begin[pos] == '\r' && begin[pos + 1] == '\n') { pos++; }
+        else if(begin[pos] != '\n') { return Fail_(buff, 400); }  // 单独的\r或控制字符
+        scan_ = lineStart_ = pos + 1;
+        string_view line(begin + start, end - start);
+        if(state_ == REQUEST_LINE && line.size() > MAX_LINE) { return Fail_(buff, 414); }
+        if(scan_ > MAX_HEAD) { return Fail_(buff, 431); }
+        if(state_ == REQUEST_LINE) {
+            if(line.empty()) { continue; }  // 请求之前多余的空行（如上一个请求体后面的"\r\n"）
+            if(!ParseRequestLine_(line)) { return Fail_(buff, 400); }
+            Route_();       // 查找路由
+            state_ = HEADERS;
+            continue;
+        }
+        if(line.empty()) {  // 空行，请求头结束
+            headLen_ = scan_;
+            state_ = BODY;
+            int code = StartBody_(buff);
+            if(code) { return Fail_(buff, code); }
+            begin = buff.Peek();    // 流式处理时请求头已经取走
+            len = buff.ReadableBytes();
             break;
         }
-        if(lineEnd == buff.BeginWrite()) { break; } // 读完了
-        buff.RetrieveUntil(lineEnd + 2);        // 跳过回车换行
+        int code = ParseHeader_(line, start);
+        if(code) { return Fail_(buff, code); }
     }
+    if(holdBody && BodyHeld()) { return PARSE_AGAIN; }
+    bool stream = (handler_ != nullptr);
+    bool done = false;
+    int code = ReadBody_(begin, len, &done);
+    if(code) { return Fail_(buff, code); }
+    if(stream) {
+        buff.Retrieve(scan_);   // 已交给处理函数的数据不再保留
+        scan_ = 0;
+    }
+    if(!done) { return PARSE_AGAIN; }
+    if(stream) {
+        handler_ = nullptr;
+    } else {
+        head_ = begin;
+        ParsePost_();   // 处理post请求
+        buff.Retrieve(scan_);   // 只取走这一个请求，读缓冲区只在追加时才会覆盖这块内存
+    }
+    state_ = FINISH;
     LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
-    return true;
+    return PARSE_OK;
 }
 
-// 解析路径
-void HttpRequest::ParsePath_() 
+// 请求头结束：检查Expect与请求体长度，路由或路径注册了流式处理时复制请求头并从读缓冲区取走
+int HttpRequest::StartBody_(Buffer& buff)
 {
-    if(path_ == "/") 
-    {
-        path_ = "/index.html"; 
+    if(chunked_ && hasLength_) { return 400; }  // 两者同时出现时长度有歧义（请求走私），拒绝
+    head_ = buff.Peek();
+    scan_ = headLen_;
+    bool hasBody = chunked_ || contentLength_ > 0;
+    string_view expect = GetHeader(EXPECT);
+    if(!expect.empty()) {
+        if(!EqualNoCase(expect, "100-continue")) { return 417; }
+        // 请求体已经开始到达时不必再发；HTTP/1.0的客户端不认识100
+        continue_ = hasBody && version_ == "1.1" && buff.ReadableBytes() == headLen_;
     }
-    else 
-    {
-        for(auto &item: DEFAULT_HTML) 
-        {
-            if(item == path_) 
-            {
-                path_ += ".html";
-                break;
-            }
-        }
+    if(!hasBody) { return 0; }
+    if(route_) {
+        int code = 0;
+        handler_ = route_->Body(*this, &code);
+        if(code) { return code; }
+    }
+    auto it = handler_ ? bodyHandlers_.end() : bodyHandlers_.find(path_);
+    if(it != bodyHandlers_.end()) { handler_ = it->second(*this); }
+    if(contentLength_ > (handler_ ? MAX_STREAM_BODY : MAX_BODY)) { return 413; }
+    if(handler_) {
+        headCopy_.assign(head_, headLen_);
+        head_ = headCopy_.data();
+        buff.Retrieve(headLen_);
+        scan_ = 0;
     }
+    return 0;
 }
 
-// 解析请求行
-bool HttpRequest::ParseRequestLine_(const string& line) 
+// 请求体的数据从begin + scan_开始，读完时置done；流式处理的结束也在这里通知处理函数
+int HttpRequest::ReadBody_(const char* begin, size_t len, bool* done)
 {
-    // 正则表达式, 匹配请求行, 例如: GET /index.html HTTP/1.1
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$"); 
-    smatch subMatch;
-    // 在匹配规则中，以括号()的方式来划分组别 一共三个括号 [0]表示整体
-    if(regex_match(line, subMatch, patten)) {      // 匹配指定字符串整体是否符合
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;   // 状态转换为下一个状态
-        return true;
+    int code = 0;
+    if(chunked_) {
+        code = ReadChunked_(begin, len, done);
+    } else if(handler_) {
+        size_t n = min(len - scan_, contentLength_ - bodyRead_);
+        if(n > 0) {
+            code = OnBody_(begin + scan_, n);
+            scan_ += n;
+        }
+        *done = (bodyRead_ == contentLength_);
+    } else if(len - headLen_ >= contentLength_) {
+        // 在内存中攒齐：请求体到齐之前不取走请求头，缓冲区扩容搬移数据后偏移依然有效；请求体不做拷贝
+        body_ = string_view(begin + headLen_, contentLength_);
+        scan_ = headLen_ + contentLength_;
+        bodyRead_ = contentLength_;
+        *done = true;
     }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    if(code == 0 && *done && handler_) { code = handler_(nullptr, 0); }
+    return code;
 }
 
-// 解析请求头
-void HttpRequest::ParseHeader_(const string& line) 
+// 分块编码：十六进制的块长度（可带;扩展）、CRLF、数据、CRLF，直到长度为0的块，之后是尾部字段与空行；
+// 行结尾同样接受单独的\n。块数据直接从读缓冲区交给OnBody_，尾部字段不使用
+int HttpRequest::ReadChunked_(const char* begin, size_t len, bool* done)
 {
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    //  匹配请求头, 例如: Host: www.baidu.com
-    if(regex_match(line, subMatch, patten)) 
-    {
-        header_[subMatch[1]] = subMatch[2]; // key-value
+    size_t limit = handler_ ? MAX_STREAM_BODY : MAX_BODY;
+    while(true) {
+        if(chunkState_ == CHUNK_DATA) {
+            size_t n = min(len - scan_, chunkLeft_);
+            if(n == 0) { return 0; }
+            int code = OnBody_(begin + scan_, n);
+            if(code) { return code; }
+            scan_ += n;
+            chunkLeft_ -= n;
+            if(chunkLeft_ > 0) { return 0; }
+            chunkState_ = CHUNK_DATA_END;
+            continue;
+        }
+        // 在内存中攒齐时原始数据也留在读缓冲区中，连同分块的开销一起限制
+        if(!handler_ && scan_ - headLen_ > MAX_BODY * 2) { return 413; }
+        const char* eol = (const char*)memchr(begin + scan_, '\n', len - scan_);
+        if(!eol) { return len - scan_ > MAX_CHUNK_LINE ? 400 : 0; }
+        string_view line(begin + scan_, eol - (begin + scan_));
+        if(line.size() > MAX_CHUNK_LINE) { return 400; }
+        if(!line.empty() && line.back() == '\r') { line.remove_suffix(1); }
+        scan_ = eol - begin + 1;
+        if(chunkState_ == CHUNK_DATA_END) {
+            if(!line.empty()) { return 400; }
+            chunkState_ = CHUNK_SIZE;
+        }
+        else if(chunkState_ == CHUNK_SIZE) {
+            size_t size = 0, i = 0;
+            for(; i < line.size() && isxdigit((unsigned char)line[i]); i++) {
+                size = size * 16 + ConverHex(line[i]);
+                if(size > limit) { return 413; }
+            }
+            if(i == 0 || (i < line.size() && line[i] != ';' && line[i] != ' ' && line[i] != '\t')) { return 400; }
+            if(bodyRead_ + size > limit) { return 413; }
+            chunkLeft_ = size;
+            chunkState_ = size > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+        }
+        else {  // CHUNK_TRAILER，chunkLeft_记录尾部字段的总长度
+            if(line.empty()) {
+                if(!handler_) { body_ = bodyBuf_; }
+                *done = true;
+                return 0;
+            }
+            chunkLeft_ += line.size();
+            if(chunkLeft_ > MAX_HEAD) { return 431; }
+        }
     }
-    else {
-        state_ = BODY;  // 状态转换为下一个状态
+}
+
+// 解码后的一段请求体
+int HttpRequest::OnBody_(const char* data, size_t len)
+{
+    bodyRead_ += len;
+    if(handler_) { return handler_(data, len); }
+    bodyBuf_.append(data, len);
+    return 0;
+}
+
+// 解析失败：连接将在响应后关闭，剩下的数据不再解析
+HttpRequest::PARSE_RESULT HttpRequest::Fail_(Buffer& buff, int code)
+{
+    LOG_WARN("Bad request %d: [%s], [%s]", code, method_.c_str(), path_.c_str());
+    errCode_ = code;
+    keepAlive_ = false;
+    continue_ = false;
+    handler_ = nullptr;
+    fieldCount_ = 0;
+    memset(known_, 0, sizeof(known_));
+    state_ = FINISH;
+    buff.Retrieve(buff.ReadableBytes());
+    return PARSE_ERROR;
+}
+
+// 查找路由：只用请求目标中查询串之前的部分，O(路径长度)，不分配内存
+void HttpRequest::Route_()
+{
+    string_view target = path_;
+    route_ = Router::Instance()->Find(method_, target.substr(0, target.find('?')), &params_);
+}
+
+int HttpRequest::Handle()
+{
+    if(!route_) { return 404; }
+    return route_->Handle(*this);
+}
+
+string_view HttpRequest::Param(string_view name) const
+{
+    for(size_t i = 0; i < params_.count; i++) {
+        if(params_.items[i].name == name) {
+            return string_view(path_).substr(params_.items[i].off, params_.items[i].len);
+        }
     }
+    return string_view();
+}
+
+// 解析请求行, 例如: GET /index.html HTTP/1.1
+bool HttpRequest::ParseRequestLine_(string_view line) 
+{
+    // 方法与请求目标各扫描一次，停下的位置必须是空格
+    size_t sp1 = HttpScan::Span(line.data(), line.size(), HttpScan::TOKEN);
+    if(sp1 == 0 || sp1 >= line.size() || line[sp1] != ' ') { return false; }
+    size_t sp2 = sp1 + 1 + HttpScan::Span(line.data() + sp1 + 1, line.size() - sp1 - 1, HttpScan::TARGET);
+    if(sp2 == sp1 + 1 || sp2 >= line.size() || line[sp2] != ' ') { return false; }
+    string_view method = line.substr(0, sp1);
+    string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    string_view version = line.substr(sp2 + 1);
+    // 只支持HTTP/1.0与HTTP/1.1
+    if(version != "HTTP/1.1" && version != "HTTP/1.0") { return false; }
+    method_.assign(method.data(), method.size());
+    path_.assign(target.data(), target.size());
+    version_.assign(version.data() + 5, 3);
+    keepAlive_ = (version_ == "1.1");   // HTTP/1.1默认保持连接，HTTP/1.0需要Connection: keep-alive
+    return true;
 }
 
-// 解析请求体
-void HttpRequest::ParseBody_(const string& line) 
+// 解析请求头, 例如: Host: www.baidu.com
+int HttpRequest::ParseHeader_(string_view line, size_t off) 
 {
-    body_ = line;   // 请求体
-    ParsePost_();   // 处理post请求
-    state_ = FINISH;    // 状态转换为下一个状态
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    // 名字之后必须紧跟冒号，冒号前的空格与续行都会停在别的字节上；值的字节在找行尾时已经校验过
+    size_t colon = HttpScan::Span(line.data(), line.size(), HttpScan::TOKEN);
+    if(colon == 0 || colon >= line.size() || line[colon] != ':') { return 400; }
+    string_view name = line.substr(0, colon);
+    size_t vb = colon + 1, ve = line.size();
+    while(vb < ve && (line[vb] == ' ' || line[vb] == '\t')) { vb++; }
+    while(ve > vb && (line[ve - 1] == ' ' || line[ve - 1] == '\t')) { ve--; }
+    string_view value = line.substr(vb, ve - vb);
+    if(fieldCount_ >= MAX_HEADERS) { return 431; }
+    Field_ f = { (uint32_t)off, (uint32_t)name.size(), (uint32_t)(off + vb), (uint32_t)value.size() };
+    if(fieldCount_ < INLINE_HEADERS) { fields_[fieldCount_] = f; }
+    else { overflow_.push_back(f); }
+    fieldCount_++;
+    int h = KnownHeader_(name);
+    if(h < 0) { return 0; }
+    if(known_[h] == 0) { known_[h] = fieldCount_; }
+
+    // 影响解析本身的请求头在这里处理
+    if(h == CONNECTION) {
+        if(HasToken(value, "close")) { keepAlive_ = false; }
+        else if(HasToken(value, "keep-alive")) { keepAlive_ = true; }
+    }
+    else if(h == CONTENT_LENGTH) {
+        if(value.empty()) { return 400; }
+        size_t n = 0;
+        for(char ch: value) {
+            if(ch < '0' || ch > '9') { return 400; }
+            n = n * 10 + (ch - '0');
+            if(n > MAX_STREAM_BODY) { return 413; }    // 具体上限在请求头结束后按是否流式处理判断
+        }
+        if(hasLength_ && n != contentLength_) { return 400; }
+        hasLength_ = true;
+        contentLength_ = n;
+    }
+    else if(h == TRANSFER_ENCODING) {
+        if(!EqualNoCase(value, "chunked")) { return 501; }  // 只支持分块编码，不支持gzip等
+        chunked_ = true;
+    }
+    return 0;
 }
 
 // 16进制转化为10进制
@@ -137,139 +436,57 @@ int HttpRequest::ConverHex(char ch)
 {
     if(ch >= 'A' && ch <= 'F') return ch -'A' + 10;
     if(ch >= 'a' && ch <= 'f') return ch -'a' + 10;
-    return ch;
+    if(ch >= '0' && ch <= '9') return ch - '0';
+    return -1;
 }
 
 // 处理post请求
 void HttpRequest::ParsePost_() 
 {
-    if(method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded") {
+    string_view type = GetHeader(CONTENT_TYPE);
+    type = type.substr(0, type.find(';'));  // 忽略charset等参数
+    if(method_ == "POST" && EqualNoCase(type, "application/x-www-form-urlencoded")) {
         ParseFromUrlencoded_();     // POST请求体示例
-        if(DEFAULT_HTML_TAG.count(path_)) 
-        { // 如果是登录/注册的path
-            int tag = DEFAULT_HTML_TAG.find(path_)->second; 
-            LOG_DEBUG("Tag:%d", tag);
-            if(tag == 0 || tag == 1) {
-                bool isLogin = (tag == 1);  // 为1则是登录
-                if(UserVerify(post_["username"], post_["password"], isLogin)) {
-                    path_ = "/welcome.html";
-                } 
-                else {
-                    path_ = "/error.html";
-                }
-            }
-        }
     }   
 }
 
-// 从url中解析编码
-void HttpRequest::ParseFromUrlencoded_() {
-    if(body_.size() == 0) { return; }
-
-    string key, value;
-    int num = 0;
-    int n = body_.size();
-    int i = 0, j = 0;
-
-    // 从body中解析键值对
-    for(; i < n; i++) {
-        char ch = body_[i];
-        switch (ch) {
-        // key
-        case '=': // 键值对连接符
-            key = body_.substr(j, i - j);
-            j = i + 1;
-            break;
-        // 键值对中的空格换为+或者%20
-        case '+':
-            body_[i] = ' ';
-            break;
-        case '%':
-            num = ConverHex(body_[i + 1]) * 16 + ConverHex(body_[i + 2]);
-            body_[i + 2] = num % 10 + '0';
-            body_[i + 1] = num / 10 + '0';
+// 解码表单中的一个名字或值：'+'为空格，%XX为一个字节，不完整的转义原样保留
+string HttpRequest::UrlDecode_(string_view s) {
+    string out;
+    out.reserve(s.size());
+    size_t i = 0;
+    while(i < s.size()) {
+        size_t n = HttpScan::Span(s.data() + i, s.size() - i, HttpScan::URLENCODED);   // 直接跳到下一个特殊字符
+        out.append(s.data() + i, n);
+        i += n;
+        if(i >= s.size()) { break; }
+        char ch = s[i++];
+        if(ch == '+') {
+            out += ' ';
+        } else if(ch == '%' && i + 2 <= s.size() && isxdigit((unsigned char)s[i]) && isxdigit((unsigned char)s[i + 1])) {
+            out += (char)(ConverHex(s[i]) * 16 + ConverHex(s[i + 1]));
             i += 2;
-            break;
-        // 键值对连接符
-        case '&':
-            value = body_.substr(j, i - j);
-            j = i + 1;
-            post_[key] = value;
-            LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
-            break;
-        default:
-            break;
+        } else {
+            out += ch;
         }
     }
-    assert(j <= i);
-    if(post_.count(key) == 0 && j < i) {
-        value = body_.substr(j, i - j);
-        post_[key] = value;
-    }
+    return out;
 }
 
-// 用户验证
-bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin) {
-    if(name == "" || pwd == "") { return false; }
-    LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-    MYSQL* sql;
-    SqlConnRAII(&sql,  SqlConnPool::Instance());    // 获取数据库连接
-    assert(sql);    // 断言
-    
-    bool flag = false;
-    unsigned int j = 0;
-    char order[256] = { 0 };
-    MYSQL_FIELD *fields = nullptr;  // 字段
-    MYSQL_RES *res = nullptr;       // 结果集
-    
-    if(!isLogin) { flag = true; }
-    /* 查询用户及密码 */
-    snprintf(order, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    LOG_DEBUG("%s", order);
-
-    // 查询
-    if(mysql_query(sql, order)) 
-    { 
-        mysql_free_result(res); // 释放结果集
-        return false; 
-    }
-    res = mysql_store_result(sql);
-    j = mysql_num_fields(res);
-    fields = mysql_fetch_fields(res);
-
-    while(MYSQL_ROW row = mysql_fetch_row(res)) {
-        LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        string password(row[1]);
-        /* 注册行为 且 用户名未被使用*/
-        if(isLogin) {
-            if(pwd == password) { flag = true; }
-            else {
-                flag = false;
-                LOG_INFO("pwd error!");
-            }
-        } 
-        else { 
-            flag = !(name == row[0]); 
-            if(flag == false)LOG_INFO("user used!");
-        }
-    }
-    mysql_free_result(res);
-
-    /* 注册行为 且 用户名未被使用*/
-    if(!isLogin && flag == true) {
-        LOG_DEBUG("regirster!");
-        bzero(order, 256);
-        snprintf(order, 256,"INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        LOG_DEBUG( "%s", order);
-        if(mysql_query(sql, order)) { 
-            LOG_DEBUG( "Insert error!");
-            flag = false; 
-        }
-        flag = true;
+// 从url中解析编码：直接在请求体（读缓冲区）上按'&'与'='切分，只把解码后的名字与值拷贝出来
+void HttpRequest::ParseFromUrlencoded_() {
+    string_view body = body_;
+    while(!body.empty()) {
+        size_t amp = body.find('&');
+        string_view pair = body.substr(0, amp);
+        body.remove_prefix(amp == string_view::npos ? body.size() : amp + 1);
+        if(pair.empty()) { continue; }
+        size_t eq = pair.find('=');
+        string key = UrlDecode_(pair.substr(0, eq));
+        string value = eq == string_view::npos ? string() : UrlDecode_(pair.substr(eq + 1));
+        LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
+        post_[key] = std::move(value);
     }
-    // SqlConnPool::Instance()->FreeConn(sql);
-    LOG_DEBUG( "UserVerify success!!");
-    return flag;
 }
 
 std::string HttpRequest::path() const{
@@ -2,13 +2,16 @@
 #define HTTP_REQUEST_H
 
 #include <unordered_map>
-#include <unordered_set>
 #include <string>
-#include <regex>    // 正则表达式
+#include <string_view>
+#include <vector>
+#include <functional>
 #include <errno.h>     
 #include <mysql/mysql.h>  //mysql
 
 #include "../buffer/buffer.h"
+#include "httpscan.h"
+#include "router.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 
@@ -21,12 +24,77 @@ public:
         BODY,
         FINISH,        
     };
-    
+
+    enum PARSE_RESULT   // parse的返回值
+    {
+        PARSE_AGAIN,    // 请求还不完整，等待更多数据
+        PARSE_OK,       // 解析出一个完整的请求
+        PARSE_ERROR,    // 请求有误，错误码见ErrorCode()
+    };
+
+    enum HEADER     // 常用请求头，解析时用完美哈希定位到固定的槽位，按名字查找不再逐个比较
+    {
+        HOST,
+        CONNECTION,
+        CONTENT_LENGTH,
+        CONTENT_TYPE,
+        TRANSFER_ENCODING,
+        EXPECT,
+        ACCEPT_ENCODING,
+        IF_NONE_MATCH,
+        IF_MODIFIED_SINCE,
+        RANGE,
+        IF_RANGE,
+        COOKIE,
+        UPGRADE,
+        HTTP2_SETTINGS,
+        SEC_WEBSOCKET_KEY,
+        SEC_WEBSOCKET_VERSION,
+        HEADER_COUNT,
+    };
+
+    static const size_t MAX_LINE = 8192;        // 请求行的最大长度，超过返回414
+    static const size_t MAX_HEAD = 16384;       // 请求行加请求头的最大长度，超过返回431
+    static const size_t MAX_HEADERS = 64;       // 请求头的最大个数，超过返回431
+    static const size_t INLINE_HEADERS = 24;    // 请求对象中直接存放的请求头个数，更多的放到overflow_
+    static const size_t MAX_BODY = 1 << 20;     // 在内存中攒齐的请求体的最大长度，超过返回413
+    static const size_t MAX_STREAM_BODY = 1ull << 30;   // 流式处理的请求体的最大长度，超过返回413
+    static const size_t HOLD_BODY = 64 << 10;   // holdBody时更长的请求体不在调用线程中处理
+    static const size_t MAX_CHUNK_LINE = 1024;  // 分块编码中块长度行（含扩展）与尾部字段行的最大长度
+
+    // 流式请求体：请求体每到达一段就调用一次（分块编码时已解码），最后以(nullptr, 0)调用一次表示结束；
+    // 返回0继续，否则中止请求并以返回值作为响应码。数据只在调用期间有效
+    typedef std::function<int(const char* data, size_t len)> BodyHandler;
+    // 请求头解析完、请求体到达之前调用，可用GetHeader等查看请求头；返回空时照常在内存中攒齐请求体
+    typedef std::function<BodyHandler(const HttpRequest& req)> BodyHandlerFactory;
+    // 为请求路径注册流式请求体的处理，只在启动时（创建线程之前）调用
+    static void AddBodyHandler(const std::string& path, BodyHandlerFactory factory);
+
     HttpRequest() { Init(); }
     ~HttpRequest() = default;
 
     void Init();
-    bool parse(Buffer& buff);   
+    // 增量解析：数据不完整时记下已扫描的位置并返回PARSE_AGAIN，下次从断点继续，不重复扫描；
+    // 请求体按Content-Length或分块编码（Transfer-Encoding: chunked）读取。
+    // 在内存中攒齐的请求只在完整到达后才从buff中取走，后面的数据留给下一个请求；
+    // 流式处理的请求体到达一段就交给处理函数并从buff中取走一段。
+    // holdBody为true时，请求体要交给流式处理函数（可能写盘）或长于HOLD_BODY的请求在请求头之后停下，返回PARSE_AGAIN，
+    // 由调用者换到线程池中不带holdBody继续解析（混合模式中reactor线程不做阻塞的I/O）
+    PARSE_RESULT parse(Buffer& buff, bool holdBody = false);
+    bool IsFinish() const { return state_ == FINISH; }
+    bool InBody() const { return state_ == BODY; }      // 请求头已解析，请求体还没读完
+    bool BodyHeld() const { return state_ == BODY && (handler_ || contentLength_ > HOLD_BODY); }  // 见parse的holdBody
+    int ErrorCode() const { return errCode_; }  // 解析失败时的响应码
+    // 请求带有Expect: 100-continue、请求头已被接受而请求体还没开始到达时返回一次true，调用者应发送100 Continue
+    bool TakeContinue();
+
+    // 请求头的值与请求体直接指向读缓冲区，不做拷贝：只在解析完成之后、下一次向读缓冲区追加数据之前有效
+    // （分块编码的请求体解码到请求自己的内存中，流式处理的请求复制了请求头）；
+    // 名字不区分大小写，没有该请求头时返回空；同名的请求头有多个时返回第一个
+    std::string_view GetHeader(std::string_view key) const;
+    std::string_view GetHeader(HEADER h) const;
+    std::string_view body() const { return body_; }     // 流式处理的请求体不在这里
+    size_t BodyLength() const { return bodyRead_; }     // 已读到的（解码后的）请求体长度，流式处理时也有效
 
     std::string path() const; // 获取路径
     std::string& path();      // 获取路径
@@ -36,27 +104,68 @@ public:
     std::string GetPost(const char* key) const; // 获取post请求
 
     bool IsKeepAlive() const;
+    // WebSocket握手（RFC 6455 4.2.1）：HTTP/1.1的GET请求带有Connection: Upgrade与Upgrade: websocket时返回true；
+    // Sec-WebSocket-Version为13且Sec-WebSocket-Key是16字节的base64时*key为它，否则*key为空，应返回400
+    bool WebSocketUpgrade(std::string_view* key) const;
+
+    // 请求行解析后按方法与路径（不含查询串）查找路由，处理函数会阻塞（如登录/注册访问数据库）时
+    // 返回true，由调用者决定在哪个线程执行Handle
+    bool NeedBlocking() const { return route_ && route_->Blocking(*this); }
+    int Handle();       // 执行路由到的处理函数（可能改写path），返回响应码；没有匹配的路由时返回404
+    // 路由模式中的参数，如"/user/:id"中的id；指向path，只在处理函数改写path之前有效，没有时返回空
+    std::string_view Param(std::string_view name) const;
 
 private:
-    bool ParseRequestLine_(const std::string& line);    // 处理请求行
-    void ParseHeader_(const std::string& line);         // 处理请求头
-    void ParseBody_(const std::string& line);           // 处理请求体
+    struct Field_   // 一个请求头，名字和值在读缓冲区中相对读指针的偏移
+    {
+        uint32_t name, nameLen, value, valueLen;
+    };
+    const Field_& FieldAt_(size_t i) const { return i < INLINE_HEADERS ? fields_[i] : overflow_[i - INLINE_HEADERS]; }
+    std::string_view ValueOf_(const Field_& f) const { return std::string_view(head_ + f.value, f.valueLen); }
+    static int KnownHeader_(std::string_view name);     // 常用请求头的HEADER，不是时返回-1
+
+    bool ParseRequestLine_(std::string_view line);      // 处理请求行
+    int ParseHeader_(std::string_view line, size_t off);// 处理请求头，off为该行相对读指针的偏移；成功返回0，否则返回响应码
+    int StartBody_(Buffer& buff);                       // 请求头结束，决定请求体的读法；成功返回0，否则返回响应码
+    int ReadBody_(const char* begin, size_t len, bool* done);   // 从begin + scan_读请求体；成功返回0，否则返回响应码
+    int ReadChunked_(const char* begin, size_t len, bool* done);
+    int OnBody_(const char* data, size_t len);          // 解码后的一段请求体，交给处理函数或攒到bodyBuf_中
+    PARSE_RESULT Fail_(Buffer& buff, int code);         // 解析失败，丢弃读缓冲区中的数据
 
-    void ParsePath_();                                  // 处理请求路径
+    void Route_();                                      // 按请求路径查找处理函数
     void ParsePost_();                                  // 处理Post事件
     void ParseFromUrlencoded_();                        // 从url种解析编码
-
-    // 从url中解析编码
-    static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);  // 用户验证
+    static std::string UrlDecode_(std::string_view s);  // 解码表单中的名字或值
 
     PARSE_STATE state_; // 解析状态
-    std::string method_, path_, version_, body_;    // 方法，路径，版本，请求体
-    std::unordered_map<std::string, std::string> header_;   // 请求头
+    int errCode_;       // 解析失败时的响应码，成功为0
+    size_t scan_;       // 已经扫描过的字节数（相对读指针）
+    size_t lineStart_;  // 当前行的开头（相对读指针）
+    size_t headLen_;    // 请求行与请求头（含空行）的长度
+    size_t contentLength_;  // 请求体长度
+    bool hasLength_;    // 有Content-Length请求头
+    bool chunked_;      // 分块编码的请求体
+    bool keepAlive_;    // 解析请求头时确定是否保持连接
+    bool continue_;     // 需要发送100 Continue
+    int chunkState_;    // 分块编码的解析位置，见ReadChunked_
+    size_t chunkLeft_;  // 当前块还没读的字节数
+    size_t bodyRead_;   // 已读到的（解码后的）请求体长度
+    const char* head_;  // 请求头所在的内存，Field_的偏移相对于它
+    std::string method_, path_, version_;   // 方法，路径，版本
+    std::string_view body_;         // 请求体
+    std::string bodyBuf_;           // 分块编码的请求体解码到这里
+    std::string headCopy_;          // 流式处理时请求头复制到这里，读缓冲区中的请求头随即取走
+    BodyHandler handler_;           // 本请求的流式处理函数
+    Field_ fields_[INLINE_HEADERS]; // 请求头，只记录位置；一般的请求不需要分配内存
+    std::vector<Field_> overflow_;  // 超过INLINE_HEADERS个的请求头，复用容量
+    size_t fieldCount_;             // 请求头的个数
+    uint8_t known_[HEADER_COUNT];   // 常用请求头（第一次出现）的下标加1，0表示没有
     std::unordered_map<std::string, std::string> post_;    // post请求
+    const HttpHandler* route_;      // 路由到的处理函数，没有匹配时为nullptr
+    Router::Params params_;         // 路由模式中的参数，值在path_中
 
-    static const std::unordered_set<std::string> DEFAULT_HTML;  // 默认html
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG; // 默认html标签
-    static int ConverHex(char ch);  // 16进制转换为10进制
+    static std::unordered_map<std::string, BodyHandlerFactory> bodyHandlers_;  // 按路径注册的流式请求体处理
+    static int ConverHex(char ch);  // 16进制转换为10进制，不是16进制数字时返回-1
 };
 
 #endif
@@ -1,4 +1,14 @@
 #include "httpresponse.h"
+#include <strings.h>   // strncasecmp
+#include <sys/syscall.h>
+#include <atomic>
+#include "../server/serverstats.h"
+
+#ifndef SYS_cachestat
+#define SYS_CACHESTAT 451   // 各架构统一的编号，旧的内核头文件中没有
+#else
+#define SYS_CACHESTAT SYS_cachestat
+#endif
 
 using namespace std;
 
@@ -20,23 +30,53 @@ const unordered_map<string, string> HttpResponse::SUFFIX_TYPE =
     { ".mpeg",  "video/mpeg" },
     { ".mpg",   "video/mpeg" },
     { ".avi",   "video/x-msvideo" },
+    { ".mp4",   "video/mp4" },
+    { ".webm",  "video/webm" },
     { ".gz",    "application/x-gzip" },
     { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
+    { ".json",  "application/json" },
+    { ".svg",   "image/svg+xml" },
+    { ".ico",   "image/x-icon" },
+    { ".webp",  "image/webp" },
+    { ".woff",  "font/woff" },
+    { ".woff2", "font/woff2" },
+    { ".ttf",   "font/ttf" },
+    { ".otf",   "font/otf" },
+    { ".eot",   "application/vnd.ms-fontobject" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     { 200, "OK" },
+    { 201, "Created" },
+    { 206, "Partial Content" },
+    { 304, "Not Modified" },
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 413, "Payload Too Large" },
+    { 414, "URI Too Long" },
+    { 415, "Unsupported Media Type" },
+    { 416, "Range Not Satisfiable" },
+    { 417, "Expectation Failed" },
+    { 431, "Request Header Fields Too Large" },
+    { 500, "Internal Server Error" },
+    { 501, "Not Implemented" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 400, "/400.html" },
     { 403, "/403.html" },
     { 404, "/404.html" },
+    { 413, "/400.html" },
+    { 414, "/400.html" },
+    { 415, "/400.html" },
+    { 416, "/400.html" },
+    { 417, "/400.html" },
+    { 431, "/400.html" },
+    { 500, "/400.html" },
+    { 501, "/400.html" },
 };
 
 HttpResponse::HttpResponse() 
@@ -44,8 +84,13 @@ HttpResponse::HttpResponse()
     code_ = -1;
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
-    mmFile_ = nullptr; 
     mmFileStat_ = { 0 };
+    fileSize_ = 0;
+    hasValidator_ = false;
+    encoding_ = nullptr;
+    vary_ = false;
+    headOnly_ = false;
+    sendfile_ = false;
 };
 
 HttpResponse::~HttpResponse() 
@@ -57,21 +102,65 @@ HttpResponse::~HttpResponse()
 void HttpResponse::Init(const string& srcDir, string& path, bool isKeepAlive, int code)
 {
     assert(srcDir != "");
-    if(mmFile_) { UnmapFile(); }// 如果文件映射到内存，解除映射
+    UnmapFile();    // 如果文件映射到内存，解除映射
     code_ = code;
     isKeepAlive_ = isKeepAlive;
     path_ = path;
     srcDir_ = srcDir;
-    mmFile_ = nullptr; 
     mmFileStat_ = { 0 };
+    fileSize_ = 0;
+    hasValidator_ = false;
+    ifNoneMatch_ = ifModifiedSince_ = string_view();
+    range_ = ifRange_ = string_view();
+    ranges_.clear();
+    acceptEncoding_ = string_view();
+    encoding_ = nullptr;
+    encoded_.reset();
+    vary_ = false;
+    headOnly_ = false;
+}
+
+void HttpResponse::SetConditional(string_view ifNoneMatch, string_view ifModifiedSince)
+{
+    ifNoneMatch_ = ifNoneMatch;
+    ifModifiedSince_ = ifModifiedSince;
+}
+
+void HttpResponse::SetRange(string_view range, string_view ifRange)
+{
+    range_ = range;
+    ifRange_ = ifRange;
+}
+
+void HttpResponse::SetAcceptEncoding(string_view acceptEncoding)
+{
+    acceptEncoding_ = acceptEncoding;
+}
+
+void HttpResponse::SetHeadOnly(bool headOnly)
+{
+    headOnly_ = headOnly;
 }
 
 // 生成响应
-void HttpResponse::MakeResponse(Buffer& buff) 
+void HttpResponse::MakeResponse(Buffer& buff, bool sendfile, bool useCache) 
 {
-    /* 判断请求的资源文件 */
-    if(stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
-        code_ = 404;
+    sendfile_ = sendfile;
+    size_t start = buff.ReadableBytes();
+    // 完整响应缓存只用于没有条件头与Range的请求，这时响应只由文件与变体决定
+    useCache = useCache && ResponseCache::Instance()->Capacity() > 0 && ifNoneMatch_.empty() 
+               && ifModifiedSince_.empty() && range_.empty();
+    if(useCache && FromCache_(buff, code_ >= 400)) { return; }
+    /* 判断请求的资源文件；请求本身有误（解析失败）时直接返回错误页，不访问请求的文件 */
+    filePath_ = srcDir_ + path_;
+    if(code_ >= 400) 
+    {
+        file_.reset();
+        mmFileStat_ = { 0 };
+    }
+    // 不存在、是目录或打不开
+    else if(!OpenFile_(filePath_)) {
+        code_ = file_->err == EACCES ? 403 : 404;
     }
     // 没有权限
     else if(!(mmFileStat_.st_mode & S_IROTH)) 
@@ -79,26 +168,152 @@ void HttpResponse::MakeResponse(Buffer& buff)
         code_ = 403;
     }
     // 请求成功
-    else if(code_ == -1) 
-    { 
-        code_ = 200; 
+    else
+    {
+        if(code_ == -1) { code_ = 200; }
+        if(code_ == 200) 
+        {
+            SelectEncoding_();
+            validator_ = file_->validator;
+            if(encoded_) 
+            {   // 压缩结果与原文件的ETag不同
+                size_t len = strlen(validator_.etag);
+                snprintf(validator_.etag + len - 1, sizeof(validator_.etag) - len + 1, "-gzip\"");
+            }
+            hasValidator_ = true;
+            fileSize_ = encoded_ ? encoded_->size() : mmFileStat_.st_size;
+            if(NotModified_()) { code_ = 304; }    // 浏览器缓存的仍是最新版本
+            else if(!range_.empty() && IfRangeMatch_() && ParseRange_() && code_ == 416) 
+            {   // 错误页不是请求的文件，不带它的验证器
+                hasValidator_ = false;
+            }
+        }
     }
+    if(useCache && code_ >= 400 && FromCache_(buff, true)) { return; }  // 错误页的响应与请求的文件无关
     ErrorHtml_();   // 错误处理
     AddStateLine_(buff);    // 添加状态行
     AddHeader_(buff);    // 添加头部
     AddContent_(buff);  // 添加内容
+    if(useCache) { ToCache_(buff, start); }     // HEAD与GET共用条目，去掉响应体之前放进缓存
+    if(headOnly_) { DropBody_(buff, start); }
+    file_.reset();      // 空闲的连接不占着被淘汰的文件
+    deps_.clear();
+}
+
+// 命中时整个响应作为一段“文件”，由缓存的条目持有；查找不访问文件系统
+bool HttpResponse::FromCache_(const Buffer& buff, bool error)
+{
+    if(error) 
+    {
+        if(CODE_PATH.count(code_) == 0) { return false; }
+        cacheKey_.assign("\t");
+        cacheKey_ += to_string(code_);
+    }
+    else 
+    {
+        if((code_ != -1 && code_ != 200) || path_.empty() || path_[0] != '/') { return false; }
+        cacheKey_.assign(path_);
+        cacheKey_ += '\t';
+        cacheKey_.append(acceptEncoding_.data(), acceptEncoding_.size());
+    }
+    cacheKey_ += isKeepAlive_ ? '1' : '0';
+    ResponseCache::ResponsePtr resp = ResponseCache::Instance()->Get(cacheKey_);
+    if(!resp) { return false; }
+    code_ = resp->code;
+    size_t len = headOnly_ ? resp->headLen : resp->bytes.size();
+    parts_.push_back({ buff.ReadableBytes(), const_cast<char*>(resp->bytes.data()), len, nullptr, 0, resp });
+    file_.reset();
+    deps_.clear();
+    return true;
+}
+
+// 200与有错误页的错误响应，响应体是一整段文件（或为空）；cacheKey_是FromCache_查找时的键
+void HttpResponse::ToCache_(const Buffer& buff, size_t start)
+{
+    bool error = CODE_PATH.count(code_) == 1;
+    if((code_ != 200 && !error) || parts_.size() > 1 || (parts_.empty() && fileSize_ > 0)) { return; }
+    const char* head = buff.Peek() + start;
+    size_t inlineLen = buff.ReadableBytes() - start;    // 响应头，没有错误页文件时还有内联的错误信息
+    size_t bodyLen = parts_.empty() ? 0 : parts_[0].len;
+    if(inlineLen + bodyLen > ResponseCache::Instance()->MaxResponse()) { return; }
+    auto first = error ? deps_.end() - 1 : deps_.begin();   // 错误页的响应只依赖错误页，不依赖请求的（不存在的）文件
+    for(auto it = first; it != deps_.end(); ++it) {
+        if((*it)->stale) { return; }    // 没有放进打开文件缓存，变化时不会知道
+    }
+    if(error) 
+    {   // 错误页的响应与请求的路径无关
+        cacheKey_.assign("\t");
+        cacheKey_ += to_string(code_);
+        cacheKey_ += isKeepAlive_ ? '1' : '0';
+    }
+
+    shared_ptr<ResponseCache::Response> resp = make_shared<ResponseCache::Response>();
+    resp->code = code_;
+    resp->headLen = (const char*)memmem(head, inlineLen, "\r\n\r\n", 4) + 4 - head;
+    resp->bytes.reserve(inlineLen + bodyLen);
+    resp->bytes.append(head, inlineLen);
+    if(bodyLen > 0 && parts_[0].data) { resp->bytes.append(parts_[0].data, bodyLen); }
+    else if(bodyLen > 0) 
+    {   // sendfile的段没有映射，从文件中读出
+        resp->bytes.resize(inlineLen + bodyLen);
+        for(size_t done = 0; done < bodyLen; ) {
+            ssize_t n = pread(parts_[0].fd, &resp->bytes[inlineLen + done], bodyLen - done, parts_[0].offset + done);
+            if(n <= 0) { return; }
+            done += n;
+        }
+    }
+    resp->deps.assign(first, deps_.end());
+    ResponseCache::Instance()->Put(cacheKey_, std::move(resp), error);
+}
+
+// 用mincore检查映射的每一页是否已在页缓存中，不在的页在发送时会缺页，阻塞在磁盘读上
+bool HttpResponse::PageCached(const char* addr, size_t len)
+{
+    if(!addr || len == 0) { return true; }
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    // mincore要求起始地址按页对齐；映射本身从页边界开始，向下对齐不会越出映射
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(pageSize - 1);
+    size_t pages = ((uintptr_t)addr + len - start + pageSize - 1) / pageSize;
+    unsigned char vec[1024];
+    for(size_t off = 0; off < pages; off += sizeof(vec)) {
+        size_t n = min(sizeof(vec), pages - off);
+        if(mincore((void*)(start + off * pageSize), n * pageSize, vec) < 0) { return false; }
+        for(size_t i = 0; i < n; i++) {
+            if(!(vec[i] & 1)) { return false; }
+        }
+    }
+    return true;
 }
 
-// 获取文件
-char* HttpResponse::File() 
+// sendfile没有映射可以用mincore，改用cachestat（Linux 6.5）统计这一段中已在页缓存的页；内核不支持时当作不在
+bool HttpResponse::PageCached(int fd, off_t offset, size_t len)
 {
-    return mmFile_;
+    if(fd < 0 || len == 0) { return true; }
+    struct { uint64_t off, len; } range = { (uint64_t)offset, len };
+    struct { uint64_t cache, dirty, writeback, evicted, recentlyEvicted; } cs;
+    if(syscall(SYS_CACHESTAT, fd, &range, &cs, 0) < 0) { return false; }
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    uint64_t first = offset / pageSize, last = (offset + len - 1) / pageSize;
+    return cs.cache >= last - first + 1;
 }
 
-// 获取文件大小
-size_t HttpResponse::FileLen() const 
+// 从打开文件缓存取得文件，命中时不stat也不open；打开失败时mmFileStat_为0
+bool HttpResponse::OpenFile_(const string& path, bool pin)
 {
-    return mmFileStat_.st_size;
+    file_ = FileCache::Instance()->Get(path, pin);
+    deps_.push_back(file_);
+    mmFileStat_ = file_->st;
+    return file_->fd >= 0;
+}
+
+// 响应头以空行结束，之后的内联内容（错误页、multipart的分隔内容）撤回，文件段不再发送
+void HttpResponse::DropBody_(Buffer& buff, size_t start)
+{
+    const char* head = buff.Peek() + start;
+    const char* end = (const char*)memmem(head, buff.ReadableBytes() - start, "\r\n\r\n", 4);
+    assert(end);
+    buff.Unwrite(buff.BeginWriteConst() - (end + 4));
+    UnmapFile();
 }
 
 // 获取文件类型
@@ -107,7 +322,11 @@ void HttpResponse::ErrorHtml_()
     if(CODE_PATH.count(code_) == 1) 
     {
         path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        filePath_ = srcDir_ + path_;
+        OpenFile_(filePath_, true);     // 错误页固定在打开文件缓存中
+        // 错误页不压缩；选中的压缩版本（416时）不再发送，只保留Vary
+        encoding_ = nullptr;
+        encoded_.reset();
     }
 }
 
@@ -137,39 +356,290 @@ void HttpResponse::AddHeader_(Buffer& buff)
     } else{
         buff.Append("close\r\n");
     }
+    if(hasValidator_) {
+        buff.Append("ETag: ");
+        buff.Append(validator_.etag, strlen(validator_.etag));
+        buff.Append("\r\nLast-Modified: ");
+        buff.Append(validator_.lastModified, strlen(validator_.lastModified));
+        buff.Append("\r\n", 2);
+    }
+    if(vary_) { buff.Append("Vary: Accept-Encoding\r\n"); }
+    if(code_ == 304) { return; }
+    if(encoding_) { buff.Append("Content-Encoding: " + string(encoding_) + "\r\n"); }
+    if(hasValidator_) { buff.Append("Accept-Ranges: bytes\r\n"); }
+    // 416的长度是选中的表示（按Accept-Encoding选出的压缩版本或原文件）的长度，即Range所针对的内容，不是错误页的长度
+    if(code_ == 416) { buff.Append("Content-Range: bytes */" + to_string(fileSize_) + "\r\n"); }
+    if(code_ == 206 && ranges_.size() > 1) { return; }     // 多个范围时的Content-type由AddMultipart_添加
     buff.Append("Content-type: " + GetFileType_() + "\r\n");
 }
 
+// 有If-None-Match时只看它；否则看If-Modified-Since（精度为秒）
+bool HttpResponse::NotModified_() const
+{
+    if(!ifNoneMatch_.empty()) {
+        return FileValidator::MatchEtag(ifNoneMatch_, validator_.etag);
+    }
+    if(!ifModifiedSince_.empty()) {
+        time_t since = FileValidator::ParseHttpDate(ifModifiedSince_);
+        return since >= 0 && validator_.mtime <= since;
+    }
+    return false;
+}
+
+// If-Range中的ETag按强比较（弱ETag不匹配），日期要与Last-Modified完全相同；不匹配时忽略Range，发送整个文件
+bool HttpResponse::IfRangeMatch_() const
+{
+    if(ifRange_.empty()) { return true; }
+    if(ifRange_[0] == '"') { return ifRange_ == validator_.etag; }
+    time_t date = FileValidator::ParseHttpDate(ifRange_);
+    return date >= 0 && date == validator_.mtime;
+}
+
+// 读一个十进制数，没有数字或超过18位时返回false
+static bool ParseRangeNum(string_view& s, size_t* num)
+{
+    size_t i = 0;
+    *num = 0;
+    while(i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        if(i == 18) { return false; }
+        *num = *num * 10 + (s[i] - '0');
+        i++;
+    }
+    s.remove_prefix(i);
+    return i > 0;
+}
+
+static void SkipOws(string_view& s)
+{
+    while(!s.empty() && (s[0] == ' ' || s[0] == '\t')) { s.remove_prefix(1); }
+}
+
+// bytes=first-last、first-或-suffix，逗号分隔；超出文件的范围丢弃，一个都不剩时为416
+// 语法错误、范围过多或重叠使总长度超过文件大小时忽略Range，按200发送整个文件
+bool HttpResponse::ParseRange_()
+{
+    string_view s = range_;
+    if(s.size() < 6 || strncasecmp(s.data(), "bytes=", 6) != 0) { return false; }
+    s.remove_prefix(6);
+    size_t total = 0;
+    bool any = false;
+    ranges_.clear();
+    while(true) {
+        SkipOws(s);
+        if(!s.empty() && s[0] != ',') {
+            size_t first = 0, last = 0;
+            if(s[0] == '-') 
+            {   // 最后suffix个字节
+                s.remove_prefix(1);
+                if(!ParseRangeNum(s, &last)) { return false; }
+                first = fileSize_ - min(last, fileSize_);
+                last = fileSize_ - 1;
+                if(first > last || fileSize_ == 0) { first = fileSize_; }  // 长度为0，不可满足
+            }
+            else 
+            {
+                if(!ParseRangeNum(s, &first) || s.empty() || s[0] != '-') { return false; }
+                s.remove_prefix(1);
+                last = SIZE_MAX;
+                if(!s.empty() && s[0] >= '0' && s[0] <= '9' && !ParseRangeNum(s, &last)) { return false; }
+                if(last < first) { return false; }
+                last = min(last, fileSize_ - 1);
+            }
+            any = true;
+            if(first < fileSize_) {
+                if(ranges_.size() >= MAX_RANGES) { return false; }
+                ranges_.push_back({ first, last - first + 1 });
+                total += last - first + 1;
+            }
+            SkipOws(s);
+        }
+        if(s.empty()) { break; }
+        if(s[0] != ',') { return false; }
+        s.remove_prefix(1);
+    }
+    if(!any) { return false; }
+    if(total > fileSize_) {
+        ranges_.clear();
+        return false;
+    }
+    code_ = ranges_.empty() ? 416 : 206;
+    return true;
+}
+
+// 文件中[offset, offset + len)的一段：sendfile时只记下fd与偏移；缓存中有整个文件的映射时直接引用它；
+// 否则只映射这一段所在的页，映射的起点按页对齐。各段持有缓存的条目，fd与映射在发完之前不会释放
+bool HttpResponse::FilePart_(size_t offset, size_t len)
+{
+    if(sendfile_) {
+        parts_.push_back({ 0, nullptr, len, nullptr, 0, file_, file_->fd, (off_t)offset });
+        return true;
+    }
+    if(file_->map) {
+        parts_.push_back({ 0, file_->map + offset, len, nullptr, 0, file_, -1, 0, true });
+        return true;
+    }
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t start = offset & ~(pageSize - 1);
+    size_t mapLen = offset - start + len;
+    //将文件映射到内存提高文件的访问速度  MAP_PRIVATE 建立一个写入时拷贝的私有映射
+    void* mmRet = mmap(0, mapLen, PROT_READ, MAP_PRIVATE, file_->fd, start);
+    if(mmRet == MAP_FAILED) { return false; }
+    parts_.push_back({ 0, (char*)mmRet + (offset - start), len, (char*)mmRet, mapLen, nullptr, -1, 0, true });
+    return true;
+}
+
 // 添加内容
 void HttpResponse::AddContent_(Buffer& buff) 
 {
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    if(srcFd < 0) 
+    if(code_ == 304) 
+    {   // 没有响应体
+        buff.Append("\r\n", 2);
+        return;
+    }
+    if(encoded_) 
+    {   // 直接发送缓存的压缩结果
+        buff.Append("Content-length: " + to_string(encoded_->size()) + "\r\n\r\n");
+        parts_.push_back({ buff.ReadableBytes(), (char*)encoded_->data(), encoded_->size(), nullptr, 0, encoded_ });
+        return;
+    }
+    if(!file_ || file_->fd < 0) 
     { 
         ErrorContent(buff, "File NotFound!");
         return; 
     }
 
-    //将文件映射到内存提高文件的访问速度  MAP_PRIVATE 建立一个写入时拷贝的私有映射
-    LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1) 
+    // 各个范围或整个文件
+    LOG_DEBUG("file path %s", filePath_.data());
+    bool ok = true;
+    if(code_ == 206) {
+        for(size_t i = 0; i < ranges_.size() && ok; i++) {
+            ok = FilePart_(ranges_[i].first, ranges_[i].second);
+        }
+    }
+    else if(mmFileStat_.st_size > 0) {
+        ok = FilePart_(0, mmFileStat_.st_size);
+    }
+    if(!ok) 
     {
+        UnmapFile();
         ErrorContent(buff, "File NotFound!");
         return; 
     }
-    mmFile_ = (char*)mmRet; // 指向映射的内存地址
-    close(srcFd); // 关闭文件描述符
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    if(code_ == 206 && ranges_.size() > 1) {
+        AddMultipart_(buff);
+        return;
+    }
+    if(code_ == 206) {
+        buff.Append("Content-Range: bytes " + to_string(ranges_[0].first) + "-" + 
+                    to_string(ranges_[0].first + ranges_[0].second - 1) + "/" + to_string(fileSize_) + "\r\n");
+    }
+    size_t len = parts_.empty() ? 0 : parts_[0].len;
+    buff.Append("Content-length: " + to_string(len) + "\r\n\r\n");
+    if(!parts_.empty()) { parts_[0].pos = buff.ReadableBytes(); }
+}
+
+// multipart/byteranges：每个范围前是分隔行与它的Content-type、Content-Range，最后是结束分隔行
+void HttpResponse::AddMultipart_(Buffer& buff)
+{
+    static atomic<uint64_t> seq(time(nullptr));
+    uint64_t x = seq.fetch_add(0x9e3779b97f4a7c15ULL, memory_order_relaxed);   // splitmix64，分隔符每个响应不同
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    char boundary[32];
+    snprintf(boundary, sizeof(boundary), "%016llx", (unsigned long long)x);
+    string type = GetFileType_();
+
+    char partHead[256];
+    auto format = [&](size_t i) {
+        return snprintf(partHead, sizeof(partHead), "%s--%s\r\nContent-type: %s\r\nContent-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                        i == 0 ? "" : "\r\n", boundary, type.c_str(), ranges_[i].first,
+                        ranges_[i].first + ranges_[i].second - 1, fileSize_);
+    };
+    size_t len = 2 + 2 + strlen(boundary) + 4;     // \r\n--boundary--\r\n
+    for(size_t i = 0; i < ranges_.size(); i++) {
+        len += format(i) + ranges_[i].second;
+    }
+    buff.Append("Content-type: multipart/byteranges; boundary=" + string(boundary) + "\r\n");
+    buff.Append("Content-length: " + to_string(len) + "\r\n\r\n");
+    for(size_t i = 0; i < ranges_.size(); i++) {
+        buff.Append(partHead, format(i));
+        parts_[i].pos = buff.ReadableBytes();
+    }
+    buff.Append("\r\n--" + string(boundary) + "--\r\n");
+}
+
+static string_view TrimOws(string_view s)
+{
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) { s.remove_prefix(1); }
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) { s.remove_suffix(1); }
+    return s;
+}
+
+// coding在Accept-Encoding中可以接受：单独列出时看它的q是否为0，没有列出时看*
+bool HttpResponse::Accepts_(string_view acceptEncoding, string_view coding)
+{
+    int listed = -1, star = -1;
+    while(!acceptEncoding.empty()) {
+        size_t comma = acceptEncoding.find(',');
+        string_view item = acceptEncoding.substr(0, comma);
+        acceptEncoding = comma == string_view::npos ? string_view() : acceptEncoding.substr(comma + 1);
+        size_t semi = item.find(';');
+        string_view name = TrimOws(item.substr(0, semi));
+        bool ok = true;
+        if(semi != string_view::npos) {
+            string_view param = TrimOws(item.substr(semi + 1));
+            if(param.size() > 2 && (param[0] | 0x20) == 'q' && param[1] == '=') {
+                ok = param.find_first_not_of("0.", 2) != string_view::npos;  // q=0、q=0.000为不可接受
+            }
+        }
+        if(name.size() == coding.size() && strncasecmp(name.data(), coding.data(), name.size()) == 0) { listed = ok; }
+        else if(name == "*") { star = ok; }
+    }
+    return listed >= 0 ? listed : star == 1;
+}
+
+// 文本、脚本、矢量图与未压缩的字体格式，woff/woff2与图片视频本身已经压缩过
+bool HttpResponse::Compressible_(const string& type)
+{
+    return type.compare(0, 5, "text/") == 0 || type == "application/json" || type == "application/xml"
+        || type == "application/xhtml+xml" || type == "image/svg+xml" || type == "image/x-icon"
+        || type == "font/ttf" || type == "font/otf" || type == "application/vnd.ms-fontobject";
+}
+
+// 可压缩的文件按br、gzip的顺序找同目录下预先压缩的文件（不比原文件旧），都没有时用压缩缓存
+void HttpResponse::SelectEncoding_()
+{
+    vary_ = Compressible_(GetFileType_());
+    if(!vary_ || acceptEncoding_.empty()) { return; }
+    static const struct { const char* coding; const char* suffix; } PRECOMPRESSED[] = { { "br", ".br" }, { "gzip", ".gz" } };
+    for(const auto& pre: PRECOMPRESSED) {
+        if(!Accepts_(acceptEncoding_, pre.coding)) { continue; }
+        string path = filePath_ + pre.suffix;
+        FileCache::FilePtr file = FileCache::Instance()->Get(path);    // 不存在的结果也缓存
+        deps_.push_back(file);      // 之后出现了预先压缩的文件时，缓存的响应要重新生成
+        if(file->fd >= 0 && (file->st.st_mode & S_IROTH) && file->st.st_mtime >= mmFileStat_.st_mtime) {
+            filePath_ = path;
+            file_ = file;
+            mmFileStat_ = file->st;
+            encoding_ = pre.coding;
+            ServerStats::Add(ServerStats::Instance()->encodePrecompressed);
+            return;
+        }
+    }
+    if(range_.empty() && Accepts_(acceptEncoding_, "gzip")) {
+        encoded_ = CompressCache::Instance()->Get(filePath_, mmFileStat_, file_->fd, file_->map);
+        if(encoded_) { encoding_ = "gzip"; }
+    }
 }
 
 // 解除文件映射
 void HttpResponse::UnmapFile() 
 {
-    if(mmFile_) {
-        munmap(mmFile_, mmFileStat_.st_size);
-        mmFile_ = nullptr;
+    for(const FilePart& part: parts_) {
+        if(part.map) { munmap(part.map, part.mapLen); }
     }
+    parts_.clear();
 }
 
 // 判断文件类型 
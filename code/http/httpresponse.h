@@ -2,6 +2,8 @@
 #define HTTP_RESPONSE_H
 
 #include <unordered_map>
+#include <vector>
+#include <memory>
 #include <fcntl.h>       // open
 #include <unistd.h>      // close
 #include <sys/stat.h>    // stat
@@ -9,6 +11,10 @@
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "filevalidator.h"
+#include "compresscache.h"
+#include "filecache.h"
+#include "responsecache.h"
 
 class HttpResponse 
 {
@@ -17,29 +23,92 @@ public:
     ~HttpResponse();    // 析构函数
 
     void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
-    void MakeResponse(Buffer& buff);    // 响应
+    // GET/HEAD请求的条件头，文件没有变化时返回只有响应头的304，不打开也不映射文件；
+    // 直接引用请求的读缓冲区，只在接下来的MakeResponse中使用
+    void SetConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince);
+    // GET请求的Range与If-Range，返回206（多个范围时为multipart/byteranges）或416；同样只在MakeResponse中使用
+    void SetRange(std::string_view range, std::string_view ifRange);
+    // GET/HEAD请求的Accept-Encoding：文本类文件优先发送同目录下预先压缩的.br/.gz文件，
+    // 其次是缓存的gzip压缩结果（有Range时不用）；同样只在MakeResponse中使用
+    void SetAcceptEncoding(std::string_view acceptEncoding);
+    // HEAD请求：照常生成响应头（Content-length为GET时响应体的长度），不带响应体；
+    // 只用于HTTP/1.1，HTTP/2的流由会话去掉响应体
+    void SetHeadOnly(bool headOnly);
+    // 响应；sendfile为true时不映射文件，文件段只记下打开的fd与偏移，由调用者用sendfile发送（压缩缓存中的内容仍在内存中）
+    // useCache为true时查找并填充完整响应缓存（HTTP/1.1的GET/HEAD与错误响应），命中时buff中不追加内容，
+    // 整个响应是FileParts中的一段
+    void MakeResponse(Buffer& buff, bool sendfile = false, bool useCache = false);
     void UnmapFile();   // 解除映射
-    char* File();       // 文件
-    size_t FileLen() const; // 文件长度
+
+    // 响应体中要发送的一段文件，只映射这一段所在的页；发送顺序为buff中pos之前的内容、这段文件、下一段……
+    struct FilePart {
+        size_t pos;     // 这段文件之前的内容在buff中的结束位置（当时的ReadableBytes()）
+        char* data;     // 要发送的文件内容，sendfile时为nullptr
+        size_t len;
+        char* map;      // 映射（从页边界开始），发完后munmap；内容在压缩缓存、打开文件缓存的映射中或sendfile时为nullptr
+        size_t mapLen;
+        std::shared_ptr<const void> owner;  // 内容在压缩缓存中时持有它，其他时候持有打开文件缓存的条目（fd与映射），发完前不会释放
+        int fd = -1;        // sendfile：打开的文件，同一响应的各段共用
+        off_t offset = 0;   // sendfile：这段在文件中的偏移
+        bool mapped = false;    // data在文件映射中（发送时可能缺页）
+    };
+    const std::vector<FilePart>& FileParts() const { return parts_; }
+    void ReleaseFile() { parts_.clear(); }  // 映射交给调用者，之后由调用者munmap
+    static bool PageCached(const char* addr, size_t len);  // 映射中的这段内存是否全部在页缓存中
+    static bool PageCached(int fd, off_t offset, size_t len);   // 文件的这一段是否全部在页缓存中（cachestat）
     void ErrorContent(Buffer& buff, std::string message);   // 错误内容
     int Code() const { return code_; }  // 编码
+    bool IsKeepAlive() const { return isKeepAlive_; }
 
 private:
     void AddStateLine_(Buffer &buff);
     void AddHeader_(Buffer &buff);
     void AddContent_(Buffer &buff);
 
+    bool OpenFile_(const std::string& path, bool pin = false);
+    void DropBody_(Buffer& buff, size_t start);     // 去掉buff中从start开始的响应的响应体与各段文件
+    bool FromCache_(const Buffer& buff, bool error);    // 按路径与变体（error时按响应码）查找完整响应缓存
+    void ToCache_(const Buffer& buff, size_t start);    // 把刚生成的、从start开始的响应放进缓存
     void ErrorHtml_();
     std::string GetFileType_();
+    bool NotModified_() const;  // 条件请求中的验证器与文件当前的一致
+    bool IfRangeMatch_() const; // 没有If-Range，或If-Range与文件当前的验证器一致
+    bool ParseRange_();         // 解析Range，code_改为206或416；语法错误等要忽略Range时返回false
+    bool FilePart_(size_t offset, size_t len);     // 文件中的一段：sendfile、缓存的映射或只映射这一段
+    void AddMultipart_(Buffer& buff);
+    void SelectEncoding_();     // 选择响应的内容编码，可能换成预先压缩的文件
+    static bool Accepts_(std::string_view acceptEncoding, std::string_view coding);
+    static bool Compressible_(const std::string& type);
 
     int code_;
     bool isKeepAlive_;
 
     std::string path_;
     std::string srcDir_;
+    std::string filePath_;          // 要发送的文件：请求的文件、预先压缩的文件或错误页
     
-    char* mmFile_; 
+    FileCache::FilePtr file_;       // 打开的文件，只在MakeResponse期间持有，之后由各段持有
+    std::vector<FileCache::FilePtr> deps_;  // 本次MakeResponse查过的文件，响应放进缓存时作为它的依赖
+    std::string cacheKey_;          // 完整响应缓存的键，重复使用不再分配
     struct stat mmFileStat_;
+    size_t fileSize_;               // 请求的文件的大小，416时错误页会覆盖mmFileStat_
+    std::vector<FilePart> parts_;
+
+    bool hasValidator_;                 // 成功的静态文件响应带ETag与Last-Modified
+    FileValidator::Validator validator_;
+    std::string_view ifNoneMatch_;
+    std::string_view ifModifiedSince_;
+    std::string_view range_;
+    std::string_view ifRange_;
+    std::vector<std::pair<size_t, size_t>> ranges_;    // 可满足的范围：{起始偏移, 长度}，按请求中的顺序
+    std::string_view acceptEncoding_;
+    const char* encoding_;          // Content-Encoding，nullptr为不压缩
+    std::shared_ptr<const std::string> encoded_;   // 缓存的gzip压缩结果
+    bool vary_;                     // 响应随Accept-Encoding变化
+    bool headOnly_;                 // HEAD请求，只发送响应头
+    bool sendfile_;                 // 本次MakeResponse不映射文件
+
+    static const size_t MAX_RANGES = 16;    // 范围更多时忽略Range，发送整个文件
 
     static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;  // 后缀类型集
     static const std::unordered_map<int, std::string> CODE_STATUS;          // 编码状态集
@@ -0,0 +1,133 @@
+#include "httpscan.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86
+#endif
+
+static bool IsTchar(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c != 0 && strchr("!#$%&'*+-.^_`|~", c));
+}
+static bool IsTargetChar(unsigned char c) { return c > 0x20 && c != 0x7f; }
+static bool IsFieldChar(unsigned char c) { return c >= 0x20 ? c != 0x7f : c == '\t'; }
+static bool IsUrlencodedPlain(unsigned char c) { return c != '=' && c != '&' && c != '+' && c != '%'; }
+
+const HttpScan::CharSet HttpScan::TOKEN = HttpScan::MakeSet_(IsTchar);
+const HttpScan::CharSet HttpScan::TARGET = HttpScan::MakeSet_(IsTargetChar);
+const HttpScan::CharSet HttpScan::FIELD = HttpScan::MakeSet_(IsFieldChar);
+const HttpScan::CharSet HttpScan::URLENCODED = HttpScan::MakeSet_(IsUrlencodedPlain);
+
+HttpScan::SpanFn HttpScan::span_ = HttpScan::Dispatch_;    // 常量初始化，其他编译单元的静态初始化中调用也安全
+const char* HttpScan::impl_ = "scalar";
+static const bool selected = HttpScan::Use(nullptr);    // 启动时（创建线程之前）选好实现
+
+HttpScan::CharSet HttpScan::MakeSet_(bool (*allow)(unsigned char c)) {
+    CharSet set;
+    memset(&set, 0, sizeof(set));
+    for(int c = 0; c < 256; c++) {
+        set.table[c] = allow(c);
+        if(c < 0x80 && set.table[c]) { set.lo[c & 15] |= 1 << (c >> 4); }
+    }
+    set.high = set.table[0x80];
+    return set;
+}
+
+static size_t SpanScalar(const char* p, size_t n, const HttpScan::CharSet& set) {
+    size_t i = 0;
+    while(i < n && set.table[(unsigned char)p[i]]) { i++; }
+    return i;
+}
+
+#ifdef HTTP_SCAN_X86
+// 16字节一组：不允许的字节在掩码中对应位为1
+__attribute__((target("sse4.2")))
+static size_t SpanSse42(const char* p, size_t n, const HttpScan::CharSet& set) {
+    const __m128i lut = _mm_loadu_si128((const __m128i*)set.lo);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i high = set.high ? _mm_set1_epi8(-1) : zero;
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i row = _mm_shuffle_epi8(lut, _mm_and_si128(v, nibble));
+        __m128i col = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(row, col), zero);
+        bad = _mm_andnot_si128(_mm_and_si128(_mm_cmplt_epi8(v, zero), high), bad);   // 非ASCII整体允许
+        int mask = _mm_movemask_epi8(bad);
+        if(mask) { return i + __builtin_ctz(mask); }
+    }
+    return i + SpanScalar(p + i, n - i, set);
+}
+
+// 32字节一组，pshufb在两个128位通道内分别查表，查找表复制到两个通道
+__attribute__((target("avx2")))
+static size_t SpanAvx2(const char* p, size_t n, const HttpScan::CharSet& set) {
+    const __m128i lut16 = _mm_loadu_si128((const __m128i*)set.lo);
+    const __m128i bits16 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble16 = _mm_set1_epi8(0x0f);
+    const __m128i zero16 = _mm_setzero_si128();
+    const __m128i high16 = set.high ? _mm_set1_epi8(-1) : zero16;
+    const __m256i lut = _mm256_broadcastsi128_si256(lut16);
+    const __m256i bits = _mm256_broadcastsi128_si256(bits16);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i high = set.high ? _mm256_set1_epi8(-1) : zero;
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i row = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, nibble));
+        __m256i col = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(row, col), zero);
+        bad = _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpgt_epi8(zero, v), high), bad);
+        unsigned mask = _mm256_movemask_epi8(bad);
+        if(mask) { return i + __builtin_ctz(mask); }
+    }
+    // 剩下不足32字节时再按16字节处理一次；不调用SpanSse42，非VEX编码的SSE指令与AVX混用有切换开销
+    if(i + 16 <= n) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i row = _mm_shuffle_epi8(lut16, _mm_and_si128(v, nibble16));
+        __m128i col = _mm_shuffle_epi8(bits16, _mm_and_si128(_mm_srli_epi16(v, 4), nibble16));
+        __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(row, col), zero16);
+        bad = _mm_andnot_si128(_mm_and_si128(_mm_cmplt_epi8(v, zero16), high16), bad);
+        int mask = _mm_movemask_epi8(bad);
+        if(mask) { return i + __builtin_ctz(mask); }
+        i += 16;
+    }
+    return i + SpanScalar(p + i, n - i, set);
+}
+#endif
+
+bool HttpScan::Use(const char* impl) {
+#ifdef HTTP_SCAN_X86
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool sse42 = __builtin_cpu_supports("sse4.2");
+    if(!impl) { impl = avx2 ? "avx2" : sse42 ? "sse4.2" : "scalar"; }
+    if(strcmp(impl, "avx2") == 0 && avx2) {
+        span_ = SpanAvx2;
+        impl_ = "avx2";
+        return true;
+    }
+    if(strcmp(impl, "sse4.2") == 0 && sse42) {
+        span_ = SpanSse42;
+        impl_ = "sse4.2";
+        return true;
+    }
+#else
+    if(!impl) { impl = "scalar"; }
+#endif
+    if(strcmp(impl, "scalar") == 0) {
+        span_ = SpanScalar;
+        impl_ = "scalar";
+        return true;
+    }
+    return false;
+}
+
+size_t HttpScan::Dispatch_(const char* p, size_t n, const CharSet& set) {
+    Use(nullptr);
+    return span_(p, n, set);
+}
@@ -0,0 +1,43 @@
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+请求解析用的字节扫描：求一段内存中全部属于某个字符集的最长前缀长度（类似strspn），
+停下的位置就是分隔符（\r、\n、':'、' '等）或非法字节，一次扫描同时完成查找与校验
+x86上运行时按CPU选择AVX2（每次32字节）或SSE4.2（每次16字节），其他情况逐字节查表
+向量版本用半字节查表分类：以字节的低4位查出允许的高4位的位图，再与高4位对应的位相与；
+高4位为8~15（非ASCII）的字节只能整体允许或整体不允许
+*/
+class HttpScan {
+public:
+    struct CharSet {
+        uint8_t lo[16];     // lo[c & 15]的第(c >> 4)位表示ASCII字节c是否允许
+        bool high;          // 0x80~0xff是否允许
+        bool table[256];    // 逐字节查表用
+    };
+
+    static const CharSet TOKEN;         // 方法与请求头名字（RFC 9110 tchar）
+    static const CharSet TARGET;        // 请求目标：可见字符与非ASCII
+    static const CharSet FIELD;         // 一行之内允许的字节：可见字符、空格、制表符与非ASCII，不含\r与\n
+    static const CharSet URLENCODED;    // 表单中除了'='、'&'、'+'、'%'之外的字节
+
+    // p开始的n个字节中属于set的最长前缀长度，全部属于时返回n
+    static size_t Span(const char* p, size_t n, const CharSet& set) { return span_(p, n, set); }
+
+    static const char* Impl() { return impl_; }     // 当前使用的实现："avx2"、"sse4.2"或"scalar"
+    static bool Use(const char* impl);              // 指定实现（微基准对比用），CPU不支持时返回false
+
+private:
+    typedef size_t (*SpanFn)(const char* p, size_t n, const CharSet& set);
+
+    static CharSet MakeSet_(bool (*allow)(unsigned char c));
+    static size_t Dispatch_(const char* p, size_t n, const CharSet& set);  // 第一次调用时选择实现
+
+    static SpanFn span_;
+    static const char* impl_;
+};
+
+#endif //HTTP_SCAN_H
@@ -0,0 +1,219 @@
+#include "multipart.h"
+#include <string.h>
+#include <strings.h>
+
+using namespace std;
+
+static string_view Trim(string_view s) {
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) { s.remove_prefix(1); }
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) { s.remove_suffix(1); }
+    return s;
+}
+
+static bool EqualNoCase(string_view a, string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// 取出"; 名字=值"形式的参数，值可以带引号（引号中的\转义下一个字节）；rest为剩下的部分
+static bool NextParam(string_view* rest, string_view* name, string* value) {
+    string_view s = *rest;
+    size_t semi = s.find(';');
+    if(semi == string_view::npos) { return false; }
+    s.remove_prefix(semi + 1);
+    size_t eq = s.find('=');
+    if(eq == string_view::npos) { return false; }
+    *name = Trim(s.substr(0, eq));
+    s = Trim(s.substr(eq + 1));
+    value->clear();
+    if(!s.empty() && s[0] == '"') {
+        size_t i = 1;
+        for(; i < s.size() && s[i] != '"'; i++) {
+            if(s[i] == '\\' && i + 1 < s.size()) { i++; }
+            *value += s[i];
+        }
+        s.remove_prefix(i < s.size() ? i + 1 : i);
+    } else {
+        size_t end = s.find(';');
+        value->assign(Trim(s.substr(0, end)));
+        s.remove_prefix(end == string_view::npos ? s.size() : end);
+    }
+    *rest = s;
+    return true;
+}
+
+string_view MultipartParser::Boundary(string_view contentType) {
+    size_t semi = contentType.find(';');
+    if(!EqualNoCase(Trim(contentType.substr(0, semi)), "multipart/form-data")) { return string_view(); }
+    string_view rest = contentType.substr(semi == string_view::npos ? contentType.size() : semi);
+    string_view name;
+    string value;
+    while(NextParam(&rest, &name, &value)) {
+        if(!EqualNoCase(name, "boundary")) { continue; }
+        // boundary的字符集（RFC 2046的bchars），不能以空格结尾
+        if(value.empty() || value.size() > MAX_BOUNDARY || value.back() == ' ') { return string_view(); }
+        for(char c: value) {
+            if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || strchr("'()+_,-./:=? ", c))) {
+                return string_view();
+            }
+        }
+        // 不带引号时就是Content-Type中的一段；带引号时不含转义的值也是其中连续的一段
+        size_t pos = contentType.find(value);
+        return pos == string_view::npos ? string_view() : contentType.substr(pos, value.size());
+    }
+    return string_view();
+}
+
+MultipartParser::MultipartParser(string_view boundary, BeginFn begin, DataFn data, EndFn end):
+    state_(PREAMBLE), delim_("\r\n--"), carry_("\r\n"),     // 第一个分隔符前面没有换行，当作已经读到了
+    begin_(std::move(begin)), data_(std::move(data)), end_(std::move(end))
+{
+    delim_.append(boundary.data(), boundary.size());
+}
+
+int MultipartParser::Feed(const char* p, size_t n) {
+    while(n > 0) {
+        size_t used = 0;
+        int code = 0;
+        switch(state_) {
+        case PREAMBLE:
+        case BODY: code = Scan_(p, n, &used); break;
+        case DELIMITER: code = AfterDelimiter_(p, n, &used); break;
+        case HEADERS: code = Headers_(p, n, &used); break;
+        case EPILOGUE: used = n; break;     // 结束分隔符之后的内容忽略
+        }
+        if(code) { return code; }
+        p += used;
+        n -= used;
+    }
+    return 0;
+}
+
+int MultipartParser::Finish() {
+    return state_ == EPILOGUE ? 0 : 400;
+}
+
+// 分隔符只有第一个字节是'\r'，所以留下的字节（分隔符的前缀）中不会再有别的分隔符开头
+int MultipartParser::Scan_(const char* p, size_t n, size_t* used) {
+    size_t k = carry_.size();
+    if(k > 0) {
+        size_t m = min(delim_.size() - k, n);
+        if(memcmp(p, delim_.data() + k, m) == 0) {
+            *used = m;
+            if(k + m < delim_.size()) {
+                carry_.append(p, m);
+                return 0;
+            }
+            carry_.clear();
+        } else {
+            // 不是分隔符，留下的字节属于内容；这一段从头重新找
+            int code = Emit_(carry_.data(), k);
+            carry_.clear();
+            return code;
+        }
+    } else {
+        const char* hit = (const char*)memmem(p, n, delim_.data(), delim_.size());
+        if(!hit) {
+            // 末尾的字节可能是分隔符的开头，留到下一段
+            size_t keep = 0;
+            for(size_t i = n > delim_.size() ? n - delim_.size() + 1 : 0; i < n; i++) {
+                if(p[i] == '\r' && memcmp(p + i, delim_.data(), n - i) == 0) {
+                    keep = n - i;
+                    break;
+                }
+            }
+            *used = n;
+            int code = Emit_(p, n - keep);
+            carry_.assign(p + n - keep, keep);
+            return code;
+        }
+        *used = hit - p + delim_.size();
+        int code = Emit_(p, hit - p);
+        if(code) { return code; }
+    }
+    // 一个分隔符：结束当前的部分
+    if(state_ == BODY) {
+        int code = end_();
+        if(code) { return code; }
+    }
+    state_ = DELIMITER;
+    head_.clear();
+    return 0;
+}
+
+// 分隔符之后是"--"（结束）或可选的空白加换行（下一个部分的头）
+int MultipartParser::AfterDelimiter_(const char* p, size_t n, size_t* used) {
+    size_t i = 0;
+    while(i < n) {
+        char c = p[i++];
+        head_ += c;
+        if(head_ == "-") { continue; }
+        if(head_ == "--") {
+            state_ = EPILOGUE;
+            break;
+        }
+        if(head_[0] == '-' || head_.size() > 256) { return 400; }
+        if(c == '\n') {
+            if(head_.size() < 2 || head_[head_.size() - 2] != '\r') { return 400; }
+            state_ = HEADERS;
+            head_.clear();
+            break;
+        }
+        if(c != ' ' && c != '\t' && c != '\r') { return 400; }
+    }
+    *used = i;
+    return 0;
+}
+
+// 部分的头以空行结束，收齐了再解析；头之后的字节留给BODY
+int MultipartParser::Headers_(const char* p, size_t n, size_t* used) {
+    size_t old = head_.size();
+    head_.append(p, min(n, MAX_PART_HEAD + 4 - old));
+    size_t end;
+    if(head_.compare(0, 2, "\r\n") == 0) {
+        end = 2;    // 没有头
+    } else {
+        size_t pos = head_.find("\r\n\r\n", old > 3 ? old - 3 : 0);
+        if(pos == string::npos) {
+            if(head_.size() > MAX_PART_HEAD) { return 400; }
+            *used = n;
+            return 0;
+        }
+        end = pos + 4;
+    }
+    *used = end - old;
+    int code = ParseHeaders_(string_view(head_).substr(0, end));
+    if(code) { return code; }
+    state_ = BODY;
+    return begin_(part_);
+}
+
+int MultipartParser::ParseHeaders_(string_view head) {
+    part_.name.clear();
+    part_.filename.clear();
+    part_.type.clear();
+    bool formData = false;
+    while(!head.empty()) {
+        size_t eol = head.find("\r\n");
+        string_view line = head.substr(0, eol);
+        head.remove_prefix(eol == string_view::npos ? head.size() : eol + 2);
+        if(line.empty()) { continue; }
+        size_t colon = line.find(':');
+        if(colon == string_view::npos) { return 400; }
+        string_view name = Trim(line.substr(0, colon));
+        string_view value = Trim(line.substr(colon + 1));
+        if(EqualNoCase(name, "Content-Type")) {
+            part_.type.assign(value);
+        } else if(EqualNoCase(name, "Content-Disposition")) {
+            size_t semi = value.find(';');
+            formData = EqualNoCase(Trim(value.substr(0, semi)), "form-data");
+            string_view rest = value.substr(semi == string_view::npos ? value.size() : semi);
+            string_view param;
+            string v;
+            while(NextParam(&rest, &param, &v)) {
+                if(EqualNoCase(param, "name")) { part_.name = v; }
+                else if(EqualNoCase(param, "filename")) { part_.filename = v; }
+            }
+        }
+    }
+    return formData ? 0 : 400;
+}
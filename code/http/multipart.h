@@ -0,0 +1,54 @@
+#ifndef MULTIPART_H
+#define MULTIPART_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+/*
+multipart/form-data（RFC 7578）的流式解析：请求体每到达一段就交给Feed，不在内存中攒齐
+部分的内容直接以传进来的数据（读缓冲区）交给OnData，不做拷贝；分隔符可能被拆在两段里，
+段末尾可能是分隔符开头的几个字节（不超过分隔符的长度）留到下一段再判断，只有它们和部分的头会复制
+*/
+class MultipartParser {
+public:
+    struct Part {
+        std::string name;       // Content-Disposition中的name
+        std::string filename;   // 文件部分的filename，普通字段没有
+        std::string type;       // 部分的Content-Type
+    };
+    // 回调返回0继续，否则中止解析，返回值作为响应码
+    typedef std::function<int(const Part& part)> BeginFn;
+    typedef std::function<int(const char* data, size_t len)> DataFn;
+    typedef std::function<int()> EndFn;
+
+    static const size_t MAX_BOUNDARY = 70;      // RFC 2046
+    static const size_t MAX_PART_HEAD = 8192;   // 一个部分的头的最大长度
+
+    // Content-Type为multipart/form-data时取出其中的boundary，不是或boundary不合法时返回空
+    static std::string_view Boundary(std::string_view contentType);
+
+    MultipartParser(std::string_view boundary, BeginFn begin, DataFn data, EndFn end);
+    int Feed(const char* data, size_t len);     // 返回0继续，格式错误返回400，否则为回调的返回值
+    int Finish();   // 请求体结束，还没有出现结束分隔符时返回400
+
+private:
+    enum STATE { PREAMBLE, DELIMITER, HEADERS, BODY, EPILOGUE };
+
+    int Scan_(const char* p, size_t n, size_t* used);       // PREAMBLE与BODY：找分隔符
+    int AfterDelimiter_(const char* p, size_t n, size_t* used);
+    int Headers_(const char* p, size_t n, size_t* used);
+    int ParseHeaders_(std::string_view head);
+    int Emit_(const char* p, size_t n) { return state_ == BODY && n > 0 ? data_(p, n) : 0; }
+
+    STATE state_;
+    std::string delim_;     // "\r\n--" + boundary；boundary中没有'\r'，它只在开头出现
+    std::string carry_;     // 上一段末尾可能是分隔符开头的字节
+    std::string head_;      // 分隔符之后的字节或部分的头，收齐了再解析
+    Part part_;
+    BeginFn begin_;
+    DataFn data_;
+    EndFn end_;
+};
+
+#endif //MULTIPART_H
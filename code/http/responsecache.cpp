@@ -0,0 +1,64 @@
+#include "responsecache.h"
+#include "../server/serverstats.h"
+
+using namespace std;
+
+static const size_t ENTRY_COST = 128;   // 每个条目本身（键、链表节点、依赖等）大致占用的字节数，计入容量
+
+ResponseCache* ResponseCache::Instance() {
+    static ResponseCache cache;
+    return &cache;
+}
+
+bool ResponseCache::Response::Valid() const {
+    for(const auto& dep: deps) {
+        FileCache::FilePtr file = dep.lock();
+        if(!file || file->stale) { return false; }
+    }
+    return true;
+}
+
+ResponseCache::ResponsePtr ResponseCache::Get(const string& key) {
+    Shard_& shard = ShardOf_(key);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.cache.find(key);
+    if(it == shard.cache.end()) { return nullptr; }
+    if(!it->second.resp->Valid()) {
+        Erase_(shard, it);
+        ServerStats::Add(ServerStats::Instance()->respCacheStale);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+    ServerStats::Add(ServerStats::Instance()->respCacheHit);
+    return it->second.resp;
+}
+
+void ResponseCache::Put(const string& key, ResponsePtr resp, bool pin) {
+    if(capacity_ == 0 || resp->bytes.size() > MaxResponse() || !resp->Valid()) { return; }
+    size_t bytes = key.size() + resp->bytes.size() + ENTRY_COST;
+    Shard_& shard = ShardOf_(key);
+    lock_guard<mutex> locker(shard.mtx);
+    auto it = shard.cache.find(key);
+    if(it != shard.cache.end()) { Erase_(shard, it); }
+    shard.lru.push_front(key);
+    shard.cache.emplace(key, Entry_{ std::move(resp), bytes, pin, shard.lru.begin() });
+    shard.bytes += bytes;
+    ServerStats::Add(ServerStats::Instance()->respCacheStore);
+
+    // 从最久没有用到的开始淘汰，固定的条目跳过
+    auto lru = shard.lru.end();
+    while(shard.bytes > capacity_ / SHARDS && lru != shard.lru.begin()) {
+        --lru;
+        auto entry = shard.cache.find(*lru);
+        if(entry->second.pinned) { continue; }
+        ++lru;
+        Erase_(shard, entry);
+        ServerStats::Add(ServerStats::Instance()->respCacheEvict);
+    }
+}
+
+void ResponseCache::Erase_(Shard_& shard, unordered_map<string, Entry_>::iterator it) {
+    shard.bytes -= it->second.bytes;
+    shard.lru.erase(it->second.lru);
+    shard.cache.erase(it);
+}
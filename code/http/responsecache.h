@@ -0,0 +1,67 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "filecache.h"
+
+/*
+静态文件的完整响应缓存：热点文件（首页、样式、字体、图标）的响应按路径与变体（是否保持连接、Accept-Encoding）
+缓存序列化好的状态行、响应头与响应体，放在同一块连续的内存中；命中时整个响应作为一段交给writev，
+不拼接文件路径、不访问文件系统、不格式化响应头
+条目记下生成它时用到的打开文件缓存中的文件（请求的文件、查过的预先压缩文件、错误页），
+其中任何一个失效、被淘汰后条目就不再使用；打开文件缓存没有缓存的文件（没有inotify监视）生成的响应不缓存
+只缓存不超过分片容量1/4的响应；分片与淘汰方式同打开文件缓存，错误页（400/403/404等）的响应固定在缓存中不淘汰
+*/
+class ResponseCache {
+public:
+    struct Response {
+        int code;
+        std::string bytes;  // 状态行、响应头与响应体
+        size_t headLen;     // 状态行与响应头（含空行）的长度，HEAD请求只发送这部分
+        std::vector<std::weak_ptr<const FileCache::File>> deps;
+        bool Valid() const;     // 用到的文件都还在打开文件缓存中且没有变化
+    };
+    typedef std::shared_ptr<const Response> ResponsePtr;
+
+    static ResponseCache* Instance();
+
+    void SetCapacity(size_t bytes) { capacity_ = bytes; }   // 启动时设置，0为不缓存
+    size_t Capacity() const { return capacity_; }
+    size_t MaxResponse() const { return capacity_ / SHARDS / 4; }
+
+    // key由调用者组织（路径与变体）；没有或已经失效时返回nullptr，失效的条目同时删除
+    ResponsePtr Get(const std::string& key);
+    // 生成时用到的文件已经失效或超过大小时不缓存；pin为true时不淘汰
+    void Put(const std::string& key, ResponsePtr resp, bool pin);
+
+    static const size_t SHARDS = 16;
+
+private:
+    ResponseCache() : capacity_(16 << 20) {}
+
+    struct Entry_ {
+        ResponsePtr resp;
+        size_t bytes;       // 计入容量的字节数
+        bool pinned;
+        std::list<std::string>::iterator lru;
+    };
+    struct Shard_ {
+        std::mutex mtx;
+        std::unordered_map<std::string, Entry_> cache;
+        std::list<std::string> lru;     // 最近用到的在前
+        size_t bytes = 0;
+    };
+    Shard_& ShardOf_(const std::string& key) { return shards_[std::hash<std::string>()(key) % SHARDS]; }
+    void Erase_(Shard_& shard, std::unordered_map<std::string, Entry_>::iterator it);
+
+    size_t capacity_;
+    Shard_ shards_[SHARDS];
+};
+
+#endif //RESPONSE_CACHE_H
@@ -0,0 +1,228 @@
+#include "router.h"
+#include <algorithm>
+
+using namespace std;
+
+Router* Router::Instance() {
+    static Router router;
+    return &router;
+}
+
+int Router::MethodIndex(string_view method) {
+    static const char* const NAMES[] = { "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS" };
+    for(int i = 0; i < ANY; i++) {
+        if(method == NAMES[i]) { return i; }
+    }
+    return -1;
+}
+
+// 沿着静态字节往下走，标签只有一部分相同时拆开边
+Router::Build_* Router::InsertStatic_(Build_* n, string_view s) {
+    while(!s.empty()) {
+        Build_* next = nullptr;
+        for(auto& c: n->children) {
+            if(c->label[0] == s[0]) {
+                next = c.get();
+                break;
+            }
+        }
+        if(!next) {
+            if(n->param) { return nullptr; }    // 这个位置已经是参数段
+            n->children.emplace_back(new Build_());
+            n->children.back()->label.assign(s.data(), s.size());
+            return n->children.back().get();
+        }
+        size_t k = 0;
+        while(k < next->label.size() && k < s.size() && next->label[k] == s[k]) { k++; }
+        if(k < next->label.size()) {
+            unique_ptr<Build_> mid(new Build_());
+            mid->label = next->label.substr(0, k);
+            next->label.erase(0, k);
+            for(auto& c: n->children) {
+                if(c.get() == next) {
+                    mid->children.push_back(std::move(c));
+                    c = std::move(mid);
+                    next = c.get();
+                    break;
+                }
+            }
+        }
+        n = next;
+        s.remove_prefix(k);
+    }
+    return n;
+}
+
+bool Router::Add(string_view method, const string& pattern, shared_ptr<HttpHandler> handler) {
+    int m = method == "*" ? ANY : MethodIndex(method);
+    if(frozen_ || m < 0 || !handler || pattern.empty() || pattern[0] != '/') {
+        LOG_ERROR("Route %.*s %s rejected", (int)method.size(), method.data(), pattern.c_str());
+        rejected_++;
+        return false;
+    }
+    if(!build_[m]) { build_[m].reset(new Build_()); }
+    Build_* n = build_[m].get();
+    int h = handlers_.size();
+    size_t params = 0;
+    size_t i = 0;
+    const char* conflict = nullptr;
+    while(i < pattern.size() && !conflict) {
+        char c = pattern[i];
+        if(c == ':' || c == '*') {
+            size_t end = pattern.find('/', i);
+            if(end == string::npos) { end = pattern.size(); }
+            string name = pattern.substr(i + 1, end - i - 1);
+            if(pattern[i - 1] != '/' || name.empty() || ++params > MAX_PARAMS) {
+                conflict = "bad parameter";
+            } else if(c == '*') {
+                if(end != pattern.size()) { conflict = "wildcard not at end"; }
+                else if(n->wildcard >= 0) { conflict = "duplicate wildcard"; }
+                else {
+                    n->wildcard = h;
+                    n->wildName = name;
+                    h = -1;     // 已经挂上
+                }
+            } else if(n->param) {
+                if(n->paramName != name) { conflict = "parameter name differs"; }
+            } else if(!n->children.empty()) {
+                conflict = "parameter conflicts with static segment";
+            } else {
+                n->param.reset(new Build_());
+                n->paramName = name;
+            }
+            if(!conflict && c == ':') { n = n->param.get(); }
+            i = end;
+            continue;
+        }
+        size_t end = pattern.find_first_of(":*", i);
+        if(end == string::npos) { end = pattern.size(); }
+        n = InsertStatic_(n, string_view(pattern).substr(i, end - i));
+        if(!n) { conflict = "static segment conflicts with parameter"; }
+        i = end;
+    }
+    if(!conflict && h >= 0) {
+        if(n->handler >= 0) { conflict = "duplicate route"; }
+        else { n->handler = h; }
+    }
+    if(conflict) {
+        LOG_ERROR("Route %.*s %s rejected: %s", (int)method.size(), method.data(), pattern.c_str(), conflict);
+        rejected_++;
+        return false;
+    }
+    handlers_.push_back(std::move(handler));
+    routes_++;
+    return true;
+}
+
+uint32_t Router::Label_(const string& s) {
+    uint32_t off = labels_.size();
+    labels_ += s;
+    return off;
+}
+
+// nodes_[idx]已经分配；子节点的位置先整块分配，再逐个填
+void Router::Flatten_(const Build_* b, size_t idx) {
+    vector<const Build_*> children;
+    for(auto& c: b->children) { children.push_back(c.get()); }
+    sort(children.begin(), children.end(), [](const Build_* x, const Build_* y) { return x->label[0] < y->label[0]; });
+    Node_ node;
+    node.label = Label_(b->label);
+    node.labelLen = b->label.size();
+    node.child = nodes_.size();
+    node.childCount = children.size();
+    nodes_.resize(nodes_.size() + children.size());
+    node.param = -1;
+    node.paramName = Label_(b->paramName);
+    node.paramNameLen = b->paramName.size();
+    if(b->param) {
+        node.param = nodes_.size();
+        nodes_.emplace_back();
+    }
+    node.wildcard = b->wildcard;
+    node.wildName = Label_(b->wildName);
+    node.wildNameLen = b->wildName.size();
+    node.handler = b->handler;
+    nodes_[idx] = node;
+    for(size_t i = 0; i < children.size(); i++) { Flatten_(children[i], node.child + i); }
+    if(b->param) { Flatten_(b->param.get(), node.param); }
+}
+
+void Router::Freeze() {
+    if(frozen_) { return; }
+    for(int m = 0; m < METHOD_COUNT; m++) {
+        if(!build_[m]) { continue; }
+        roots_[m] = nodes_.size();
+        nodes_.emplace_back();
+        Flatten_(build_[m].get(), roots_[m]);
+        build_[m].reset();
+    }
+    nodes_.shrink_to_fit();
+    labels_.shrink_to_fit();
+    frozen_ = true;
+}
+
+// 一次从前往后走，每个字节最多比较一次；走不通时用最近经过的通配段
+const HttpHandler* Router::Match_(int root, string_view path, Params* params) const {
+    int n = root;
+    size_t pos = 0;
+    int fallback = -1;
+    size_t fallbackPos = 0, fallbackCount = 0;
+    params->count = 0;
+    while(true) {
+        const Node_& node = nodes_[n];
+        if(node.wildcard >= 0) {
+            fallback = n;
+            fallbackPos = pos;
+            fallbackCount = params->count;
+        }
+        if(pos == path.size()) {
+            if(node.handler >= 0) { return handlers_[node.handler].get(); }
+            break;
+        }
+        int next = -1;
+        for(uint32_t i = 0; i < node.childCount; i++) {
+            const Node_& c = nodes_[node.child + i];
+            char first = labels_[c.label];
+            if(first < path[pos]) { continue; }
+            if(first == path[pos] && path.substr(pos, c.labelLen) == LabelAt_(c.label, c.labelLen)) {
+                next = node.child + i;
+                pos += c.labelLen;
+            }
+            break;
+        }
+        if(next < 0 && node.param >= 0) {
+            size_t end = path.find('/', pos);
+            if(end == string_view::npos) { end = path.size(); }
+            if(end > pos) {     // 参数段不能为空
+                auto& item = params->items[params->count++];
+                item.name = LabelAt_(node.paramName, node.paramNameLen);
+                item.off = pos;
+                item.len = end - pos;
+                pos = end;
+                next = node.param;
+            }
+        }
+        if(next < 0) { break; }
+        n = next;
+    }
+    if(fallback < 0) { return nullptr; }
+    const Node_& node = nodes_[fallback];
+    params->count = fallbackCount;
+    auto& item = params->items[params->count++];
+    item.name = LabelAt_(node.wildName, node.wildNameLen);
+    item.off = fallbackPos;
+    item.len = path.size() - fallbackPos;
+    return handlers_[node.wildcard].get();
+}
+
+const HttpHandler* Router::Find(string_view method, string_view path, Params* params) const {
+    params->count = 0;
+    if(!frozen_) { return nullptr; }
+    int m = MethodIndex(method);
+    const HttpHandler* h = nullptr;
+    if(m >= 0 && roots_[m] >= 0) { h = Match_(roots_[m], path, params); }
+    if(!h && m == HEAD && roots_[GET] >= 0) { h = Match_(roots_[GET], path, params); }
+    if(!h && roots_[ANY] >= 0) { h = Match_(roots_[ANY], path, params); }
+    if(!h) { params->count = 0; }
+    return h;
+}
@@ -0,0 +1,102 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../log/log.h"
+
+class HttpRequest;
+
+// 请求的处理函数，启动时注册到Router，之后各线程共享，不能有可变状态
+class HttpHandler {
+public:
+    // 流式请求体的处理，同HttpRequest::BodyHandler
+    typedef std::function<int(const char* data, size_t len)> BodyHandler;
+
+    virtual ~HttpHandler() = default;
+    // 会阻塞（如访问数据库）时返回true，reactor + 线程池模型下这个请求交给线程池处理
+    virtual bool Blocking(const HttpRequest& req) const { (void)req; return false; }
+    // 请求完整到达后调用，返回响应码；成功时发送req.path()对应的静态文件，处理函数可以改写路径
+    virtual int Handle(HttpRequest& req) const = 0;
+    // 请求头解析完、请求体到达之前调用，返回非空时请求体每到达一段就交给它，不在内存中攒齐；
+    // 置*code为响应码时直接拒绝请求（在发送100 Continue之前）
+    virtual BodyHandler Body(const HttpRequest& req, int* code) const { (void)req; (void)code; return nullptr; }
+};
+
+/*
+按方法与路径查找处理函数：每个方法一棵压缩的基数树（边上是公共前缀），另有一棵匹配任何方法的树
+模式中以":名字"为一段时匹配路径中的一段，以"*名字"为最后一段时匹配剩余的全部（可以为空）；
+同一位置的静态段与参数段冲突（注册失败），查找时每个字节只比较一次、不回溯，
+静态段走不通时退回最近经过的通配段；通配段与静态段可以共存，作为它们的兜底
+启动时注册，Freeze后整理成连续的数组，之后只读，查找不加锁、不分配内存
+*/
+class Router {
+public:
+    enum METHOD { GET, HEAD, POST, PUT, DELETE, PATCH, OPTIONS, ANY, METHOD_COUNT };
+
+    static const size_t MAX_PARAMS = 8;     // 一个模式中参数段与通配段的最大个数
+
+    struct Params {     // 查找时匹配到的参数，值是路径中的一段
+        size_t count;
+        struct {
+            std::string_view name;      // 指向路由表，一直有效
+            uint32_t off, len;          // 值在查找的路径中的位置
+        } items[MAX_PARAMS];
+    };
+
+    static Router* Instance();
+    // 方法为"*"时匹配任何方法；与已有的路由冲突或模式有误时返回false。只在启动时（创建线程之前）调用
+    bool Add(std::string_view method, const std::string& pattern, std::shared_ptr<HttpHandler> handler);
+    void Freeze();  // 整理成只读的查找结构，之后不能再注册
+    bool Frozen() const { return frozen_; }
+    size_t RouteCount() const { return routes_; }
+    size_t Rejected() const { return rejected_; }   // 注册失败的个数（可能在日志初始化之前，由服务器启动时报告）
+
+    // 先查方法自己的树（HEAD没有时查GET），再查任何方法的树；path不含查询串，没有匹配时返回nullptr
+    const HttpHandler* Find(std::string_view method, std::string_view path, Params* params) const;
+    static int MethodIndex(std::string_view method);    // 不是METHOD中的方法时返回-1
+
+private:
+    Router() : frozen_(false), routes_(0), rejected_(0) { for(int& r: roots_) { r = -1; } }
+
+    struct Build_ {     // 注册时的树，Freeze后释放
+        std::string label;  // 从父节点到这里的静态字节
+        std::vector<std::unique_ptr<Build_>> children;
+        std::unique_ptr<Build_> param;  // 参数段，与静态子节点互斥
+        std::string paramName;
+        std::string wildName;
+        int wildcard = -1;  // 通配段的处理函数
+        int handler = -1;   // 路径在这里结束时的处理函数
+    };
+    struct Node_ {
+        uint32_t label, labelLen;       // 边的标签在labels_中的位置
+        uint32_t child, childCount;     // 静态子节点在nodes_中连续存放，按标签的首字节排序
+        int32_t param;                  // 参数子节点，-1为没有
+        uint32_t paramName, paramNameLen;
+        int32_t wildcard;
+        uint32_t wildName, wildNameLen;
+        int32_t handler;
+    };
+
+    Build_* InsertStatic_(Build_* n, std::string_view s);  // 在参数段的位置插入静态段时返回nullptr
+    void Flatten_(const Build_* b, size_t idx);
+    uint32_t Label_(const std::string& s);
+    std::string_view LabelAt_(uint32_t off, uint32_t len) const { return std::string_view(labels_.data() + off, len); }
+    const HttpHandler* Match_(int root, std::string_view path, Params* params) const;
+
+    bool frozen_;
+    size_t routes_;
+    size_t rejected_;
+    std::unique_ptr<Build_> build_[METHOD_COUNT];
+    std::vector<std::shared_ptr<HttpHandler>> handlers_;
+    int roots_[METHOD_COUNT];
+    std::vector<Node_> nodes_;
+    std::string labels_;
+};
+
+#endif //ROUTER_H
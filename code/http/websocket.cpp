@@ -0,0 +1,498 @@
+#include "websocket.h"
+#include <string.h>
+#include "../server/serverstats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WS_X86
+#endif
+
+using namespace std;
+
+static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+unordered_map<string, unique_ptr<WebSocket::Channel_>> WebSocket::channels_;
+function<void(int fd)> WebSocket::waker_;
+WebSocket::UnmaskFn WebSocket::unmask_ = WebSocket::Dispatch_;     // 常量初始化，其他编译单元的静态初始化中调用也安全
+const char* WebSocket::impl_ = "scalar";
+static const bool selected = WebSocket::Use(nullptr);  // 启动时（创建线程之前）选好实现
+
+void WebSocket::AddRoute(const string& path, MessageHandler handler) {
+    unique_ptr<Channel_>& ch = channels_[path];
+    if(!ch) { ch.reset(new Channel_()); }
+    ch->handler = std::move(handler);
+}
+
+bool WebSocket::HasRoute(const string& path) {
+    return channels_.count(path) > 0;
+}
+
+void WebSocket::SetWaker(function<void(int fd)> waker) {
+    waker_ = std::move(waker);
+}
+
+// 消息只序列化一次，持有同一个Message的各连接的发送队列直接引用它；投递只是加锁放进收件箱
+size_t WebSocket::Broadcast(const string& path, int opcode, string_view payload) {
+    auto it = channels_.find(path);
+    if(it == channels_.end()) { return 0; }
+    Message msg = MakeMessage(opcode, payload);
+    Channel_& ch = *it->second;
+    size_t n = 0;
+    {
+        lock_guard<mutex> locker(ch.mtx);
+        for(WebSocket* ws: ch.members) {
+            bool wake = false;
+            if(ws->Push_(msg, &wake)) { n++; }
+            if(wake && waker_) { waker_(ws->fd_); }
+        }
+    }
+    ServerStats* stats = ServerStats::Instance();
+    ServerStats::Add(stats->wsBroadcasts);
+    ServerStats::Add(stats->wsDelivered, n);
+    return n;
+}
+
+int WebSocket::ParseHeader(const uint8_t* p, size_t n, Frame* f) {
+    if(n < 2) { return 0; }
+    if(p[0] & 0x70) { return -1; }  // 没有协商扩展，保留位必须为0
+    f->fin = p[0] & 0x80;
+    f->opcode = p[0] & 0x0f;
+    if(f->opcode > OP_BINARY && (f->opcode < OP_CLOSE || f->opcode > OP_PONG)) { return -1; }
+    f->masked = p[1] & 0x80;
+    uint64_t len = p[1] & 0x7f;
+    size_t h = 2;
+    if(len == 126) {
+        if(n < 4) { return 0; }
+        len = (uint64_t)p[2] << 8 | p[3];
+        h = 4;
+    } else if(len == 127) {
+        if(n < 10) { return 0; }
+        len = 0;
+        for(int i = 0; i < 8; i++) { len = len << 8 | p[2 + i]; }
+        if(len >> 63) { return -1; }
+        h = 10;
+    }
+    if(f->opcode >= OP_CLOSE && (!f->fin || len > 125)) { return -1; }
+    if(f->masked) {
+        if(n < h + 4) { return 0; }
+        memcpy(f->mask, p + h, 4);
+        h += 4;
+    }
+    f->headLen = h;
+    f->len = len;
+    return 1;
+}
+
+size_t WebSocket::EncodeHeader(int opcode, uint64_t len, uint8_t* out) {
+    out[0] = 0x80 | opcode;
+    if(len < 126) {
+        out[1] = len;
+        return 2;
+    }
+    if(len <= 0xffff) {
+        out[1] = 126;
+        out[2] = len >> 8;
+        out[3] = len;
+        return 4;
+    }
+    out[1] = 127;
+    for(int i = 0; i < 8; i++) { out[2 + i] = len >> (56 - 8 * i); }
+    return 10;
+}
+
+WebSocket::Message WebSocket::MakeMessage(int opcode, string_view payload) {
+    uint8_t head[10];
+    size_t h = EncodeHeader(opcode, payload.size(), head);
+    shared_ptr<string> msg = make_shared<string>();
+    msg->reserve(h + payload.size());
+    msg->append((const char*)head, h);
+    msg->append(payload.data(), payload.size());
+    return msg;
+}
+
+// 8字节一次：掩码重复成64位，负载总是从掩码的第0字节开始
+static void UnmaskScalar(uint8_t* data, size_t len, const uint8_t mask[4]) {
+    uint32_t m32;
+    memcpy(&m32, mask, 4);
+    uint64_t m64 = (uint64_t)m32 << 32 | m32;
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        v ^= m64;
+        memcpy(data + i, &v, 8);
+    }
+    for(; i < len; i++) { data[i] ^= mask[i & 3]; }
+}
+
+#ifdef WS_X86
+__attribute__((target("sse2")))
+static void UnmaskSse2(uint8_t* data, size_t len, const uint8_t mask[4]) {
+    int m32;
+    memcpy(&m32, mask, 4);
+    const __m128i m = _mm_set1_epi32(m32);
+    size_t i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(v, m));
+    }
+    UnmaskScalar(data + i, len - i, mask);  // i是4的倍数，掩码的相位不变
+}
+
+__attribute__((target("avx2")))
+static void UnmaskAvx2(uint8_t* data, size_t len, const uint8_t mask[4]) {
+    int m32;
+    memcpy(&m32, mask, 4);
+    const __m256i m = _mm256_set1_epi32(m32);
+    size_t i = 0;
+    for(; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(v, m));
+    }
+    if(i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(v, _mm256_castsi256_si128(m)));
+        i += 16;
+    }
+    UnmaskScalar(data + i, len - i, mask);
+}
+#endif
+
+bool WebSocket::Use(const char* impl) {
+#ifdef WS_X86
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool sse2 = __builtin_cpu_supports("sse2");
+    if(!impl) { impl = avx2 ? "avx2" : sse2 ? "sse2" : "scalar"; }
+    if(strcmp(impl, "avx2") == 0 && avx2) {
+        unmask_ = UnmaskAvx2;
+        impl_ = "avx2";
+        return true;
+    }
+    if(strcmp(impl, "sse2") == 0 && sse2) {
+        unmask_ = UnmaskSse2;
+        impl_ = "sse2";
+        return true;
+    }
+#else
+    if(!impl) { impl = "scalar"; }
+#endif
+    if(strcmp(impl, "scalar") == 0) {
+        unmask_ = UnmaskScalar;
+        impl_ = "scalar";
+        return true;
+    }
+    return false;
+}
+
+void WebSocket::Dispatch_(uint8_t* data, size_t len, const uint8_t mask[4]) {
+    Use(nullptr);
+    unmask_(data, len, mask);
+}
+
+// RFC 3629：拒绝过长编码、代理对与超过U+10FFFF的码点；ASCII按8字节一次跳过
+bool WebSocket::ValidUtf8(const uint8_t* p, size_t n) {
+    size_t i = 0;
+    while(i < n) {
+        if(i + 8 <= n) {
+            uint64_t v;
+            memcpy(&v, p + i, 8);
+            if((v & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        uint8_t c = p[i];
+        if(c < 0x80) {
+            i++;
+            continue;
+        }
+        size_t cont;
+        uint8_t lo = 0x80, hi = 0xbf;   // 第二个字节的范围
+        if(c >= 0xc2 && c <= 0xdf) { cont = 1; }
+        else if(c >= 0xe0 && c <= 0xef) {
+            cont = 2;
+            if(c == 0xe0) { lo = 0xa0; }
+            else if(c == 0xed) { hi = 0x9f; }
+        }
+        else if(c >= 0xf0 && c <= 0xf4) {
+            cont = 3;
+            if(c == 0xf0) { lo = 0x90; }
+            else if(c == 0xf4) { hi = 0x8f; }
+        }
+        else { return false; }
+        if(i + cont >= n) { return false; }
+        if(p[i + 1] < lo || p[i + 1] > hi) { return false; }
+        for(size_t k = 2; k <= cont; k++) {
+            if((p[i + k] & 0xc0) != 0x80) { return false; }
+        }
+        i += cont + 1;
+    }
+    return true;
+}
+
+static uint32_t Rol(uint32_t v, int n) {
+    return v << n | v >> (32 - n);
+}
+
+// 只用于握手，输入很短
+static void Sha1(const uint8_t* data, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    string msg((const char*)data, len);
+    msg.push_back((char)0x80);
+    while(msg.size() % 64 != 56) { msg.push_back(0); }
+    uint64_t bits = (uint64_t)len * 8;
+    for(int i = 7; i >= 0; i--) { msg.push_back((char)(bits >> (i * 8))); }
+    for(size_t off = 0; off < msg.size(); off += 64) {
+        const uint8_t* b = (const uint8_t*)msg.data() + off;
+        uint32_t w[80];
+        for(int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)b[4 * i] << 24 | (uint32_t)b[4 * i + 1] << 16 | (uint32_t)b[4 * i + 2] << 8 | b[4 * i + 3];
+        }
+        for(int i = 16; i < 80; i++) { w[i] = Rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1); }
+        uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+        for(int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if(i < 20) { f = (bb & c) | (~bb & d); k = 0x5A827999; }
+            else if(i < 40) { f = bb ^ c ^ d; k = 0x6ED9EBA1; }
+            else if(i < 60) { f = (bb & c) | (bb & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = bb ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = Rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = Rol(bb, 30);
+            bb = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += bb;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for(int i = 0; i < 5; i++) {
+        out[4 * i] = h[i] >> 24;
+        out[4 * i + 1] = h[i] >> 16;
+        out[4 * i + 2] = h[i] >> 8;
+        out[4 * i + 3] = h[i];
+    }
+}
+
+static string EncodeBase64(const uint8_t* p, size_t n) {
+    static const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string out;
+    for(size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)p[i] << 16;
+        if(i + 1 < n) { v |= (uint32_t)p[i + 1] << 8; }
+        if(i + 2 < n) { v |= p[i + 2]; }
+        out.push_back(TABLE[v >> 18 & 63]);
+        out.push_back(TABLE[v >> 12 & 63]);
+        out.push_back(i + 1 < n ? TABLE[v >> 6 & 63] : '=');
+        out.push_back(i + 2 < n ? TABLE[v & 63] : '=');
+    }
+    return out;
+}
+
+string WebSocket::AcceptKey(string_view key) {
+    string s(key);
+    s.append(GUID, sizeof(GUID) - 1);
+    uint8_t digest[20];
+    Sha1((const uint8_t*)s.data(), s.size(), digest);
+    return EncodeBase64(digest, sizeof(digest));
+}
+
+WebSocket::WebSocket(const string& path, int fd, SendFn send) : path_(path), fd_(fd), send_(std::move(send)) {
+    msgOpcode_ = -1;
+    closeSent_ = false;
+    closed_ = false;
+    inboxBytes_ = 0;
+    overflow_ = false;
+    pingSent_ = false;
+    auto it = channels_.find(path);
+    channel_ = it == channels_.end() ? nullptr : it->second.get();
+    index_ = 0;
+    if(channel_) {
+        lock_guard<mutex> locker(channel_->mtx);
+        index_ = channel_->members.size();
+        channel_->members.push_back(this);
+    }
+}
+
+// 与最后一个成员交换后删除
+WebSocket::~WebSocket() {
+    if(!channel_) { return; }
+    lock_guard<mutex> locker(channel_->mtx);
+    vector<WebSocket*>& members = channel_->members;
+    members[index_] = members.back();
+    members[index_]->index_ = index_;
+    members.pop_back();
+}
+
+bool WebSocket::OnRead(Buffer& buff) {
+    if(closed_) {
+        buff.RetrieveAll();
+        return false;
+    }
+    while(buff.ReadableBytes() >= 2) {
+        uint8_t* p = (uint8_t*)buff.Peek();     // 就地去除掩码
+        size_t n = buff.ReadableBytes();
+        Frame f;
+        int res = ParseHeader(p, n, &f);
+        if(res == 0) { break; }
+        bool ok;
+        if(res < 0 || !f.masked) {  // 客户端的帧必须加掩码
+            ok = Fail_(CLOSE_PROTOCOL);
+        } else if(f.len > MAX_MESSAGE) {
+            ok = Fail_(CLOSE_TOO_BIG);
+        } else if(n - f.headLen < f.len) {
+            break;  // 等负载到齐
+        } else {
+            pingSent_.store(false, memory_order_relaxed);
+            Unmask(p + f.headLen, f.len, f.mask);
+            ok = OnFrame_(f, p + f.headLen);
+        }
+        if(!ok) {
+            buff.RetrieveAll();
+            return false;
+        }
+        buff.Retrieve(f.headLen + f.len);
+    }
+    return true;
+}
+
+static bool ValidCloseCode(int code) {
+    return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+}
+
+bool WebSocket::OnFrame_(const Frame& f, uint8_t* payload) {
+    switch(f.opcode) {
+    case OP_TEXT:
+    case OP_BINARY:
+        if(msgOpcode_ >= 0) { return Fail_(CLOSE_PROTOCOL); }   // 上一条分片消息还没结束
+        if(f.fin) { return OnMessage_(f.opcode, payload, f.len); }
+        msgOpcode_ = f.opcode;
+        message_.assign((const char*)payload, f.len);
+        return true;
+    case OP_CONTINUATION: {
+        if(msgOpcode_ < 0) { return Fail_(CLOSE_PROTOCOL); }
+        if(message_.size() + f.len > MAX_MESSAGE) { return Fail_(CLOSE_TOO_BIG); }
+        message_.append((const char*)payload, f.len);
+        if(!f.fin) { return true; }
+        int opcode = msgOpcode_;
+        msgOpcode_ = -1;
+        bool ok = OnMessage_(opcode, (const uint8_t*)message_.data(), message_.size());
+        message_.clear();
+        if(message_.capacity() > 65536) { string().swap(message_); }    // 大消息的内存不随连接长期保留
+        return ok;
+    }
+    case OP_PING:
+        Send(OP_PONG, string_view((const char*)payload, f.len));
+        return true;
+    case OP_PONG:
+        return true;
+    default: {  // OP_CLOSE：回复同样的状态码，之后关闭连接
+        int code = 0;
+        if(f.len == 1) { return Fail_(CLOSE_PROTOCOL); }
+        if(f.len >= 2) {
+            code = payload[0] << 8 | payload[1];
+            if(!ValidCloseCode(code)) { return Fail_(CLOSE_PROTOCOL); }
+            if(!ValidUtf8(payload + 2, f.len - 2)) { return Fail_(CLOSE_INVALID_DATA); }
+        }
+        if(!closeSent_) {
+            uint8_t body[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+            Send(OP_CLOSE, string_view((const char*)body, code ? 2 : 0));
+            closeSent_ = true;
+        }
+        closed_ = true;
+        return false;
+    }
+    }
+}
+
+bool WebSocket::OnMessage_(int opcode, const uint8_t* p, size_t n) {
+    if(opcode == OP_TEXT && !ValidUtf8(p, n)) { return Fail_(CLOSE_INVALID_DATA); }
+    ServerStats::Add(ServerStats::Instance()->wsMessages);
+    if(closeSent_ || !channel_ || !channel_->handler) { return true; }   // 已经发出关闭帧，之后的消息忽略
+    channel_->handler(*this, opcode, string_view((const char*)p, n));
+    return true;
+}
+
+bool WebSocket::Fail_(int code) {
+    LOG_WARN("ws: client[%d] closed with %d", fd_, code);
+    Close(code);
+    closed_ = true;
+    return false;
+}
+
+// 帧头与负载一起复制到写缓冲区，负载只在调用期间有效
+void WebSocket::Send(int opcode, string_view payload) {
+    if(closeSent_) { return; }
+    char frame[10 + 256];
+    size_t h = EncodeHeader(opcode, payload.size(), (uint8_t*)frame);
+    if(payload.size() <= sizeof(frame) - h) {
+        if(!payload.empty()) { memcpy(frame + h, payload.data(), payload.size()); }
+        send_(frame, h + payload.size(), nullptr, 0, nullptr);
+        return;
+    }
+    string buf(frame, h);
+    buf.append(payload.data(), payload.size());
+    send_(buf.data(), buf.size(), nullptr, 0, nullptr);
+}
+
+void WebSocket::Close(int code) {
+    if(closeSent_) { return; }
+    uint8_t body[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+    Send(OP_CLOSE, string_view((const char*)body, 2));
+    closeSent_ = true;
+}
+
+bool WebSocket::Push_(const Message& msg, bool* wake) {
+    lock_guard<mutex> locker(inboxMtx_);
+    *wake = inbox_.empty() && !overflow_;
+    if(overflow_) { return false; }
+    if(inboxBytes_ + msg->size() > MAX_BACKLOG) {
+        overflow_ = true;   // 收件箱为空时也要唤醒，由处理线程关闭连接
+        return false;
+    }
+    inbox_.push_back(msg);
+    inboxBytes_ += msg->size();
+    return true;
+}
+
+bool WebSocket::HasInbox() const {
+    lock_guard<mutex> locker(inboxMtx_);
+    return !inbox_.empty() || overflow_;
+}
+
+// 收件箱与flushing_交换，锁内只交换两个vector，各自的容量保留下来
+bool WebSocket::Flush(size_t queued) {
+    bool overflow;
+    size_t bytes;
+    {
+        lock_guard<mutex> locker(inboxMtx_);
+        flushing_.swap(inbox_);
+        bytes = inboxBytes_;
+        overflow = overflow_;
+        inboxBytes_ = 0;
+        overflow_ = false;
+    }
+    if(overflow || queued + bytes > MAX_BACKLOG) {
+        flushing_.clear();
+        if(closeSent_) { return true; }
+        ServerStats::Add(ServerStats::Instance()->wsSlowClosed);
+        return Fail_(CLOSE_POLICY);
+    }
+    if(!closeSent_) {
+        for(const Message& msg: flushing_) { send_(nullptr, 0, msg->data(), msg->size(), msg); }
+    }
+    flushing_.clear();
+    return true;
+}
+
+bool WebSocket::Ping() {
+    static const Message PING = MakeMessage(OP_PING, string_view());
+    if(pingSent_.exchange(true)) { return false; }
+    bool wake;
+    Push_(PING, &wake);
+    return true;
+}
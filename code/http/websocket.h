@@ -0,0 +1,141 @@
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../buffer/buffer.h"
+#include "../log/log.h"
+
+/*
+WebSocket（RFC 6455）连接的会话：握手由HttpConn完成，之后读缓冲区中的帧在这里解析
+客户端帧的掩码在读缓冲区中就地去除（x86上运行时按CPU选择AVX2或SSE2，每次32/16字节），
+没有分片的消息直接以读缓冲区中的负载交给处理函数，分片的消息拼好后再交；文本消息校验UTF-8
+服务器帧不加掩码，广播的消息序列化一次（帧头加负载），各连接的发送队列引用同一块内存，不按连接复制
+
+按路径注册处理函数，只有注册过的路径接受升级；连接加入以路径命名的频道，Broadcast发给频道中的所有连接
+广播可能来自任何线程：消息放进连接的收件箱，收件箱由空变为非空时调用SetWaker设置的函数，
+由服务器通知处理该连接的线程，在那里排进发送队列
+*/
+class WebSocket {
+public:
+    enum OPCODE {
+        OP_CONTINUATION = 0,
+        OP_TEXT = 1,
+        OP_BINARY = 2,
+        OP_CLOSE = 8,
+        OP_PING = 9,
+        OP_PONG = 10,
+    };
+
+    enum CLOSE_CODE {
+        CLOSE_NORMAL = 1000,
+        CLOSE_GOING_AWAY = 1001,
+        CLOSE_PROTOCOL = 1002,
+        CLOSE_INVALID_DATA = 1007,
+        CLOSE_POLICY = 1008,
+        CLOSE_TOO_BIG = 1009,
+    };
+
+    static const size_t MAX_MESSAGE = 1 << 20;     // 一条消息（分片拼接后）的最大长度，超过以1009关闭
+    static const size_t MAX_BACKLOG = 4 << 20;     // 发送队列与收件箱中的字节数超过它时（慢客户端）丢弃之后的消息并关闭连接
+
+    // 序列化好的服务器帧（帧头与负载），多个连接共享
+    typedef std::shared_ptr<const std::string> Message;
+    // 排队一个帧：head复制到写缓冲区，data零拷贝发送，由owner保持有效直到发完
+    typedef std::function<void(const char* head, size_t headLen, const char* data, size_t dataLen,
+                               std::shared_ptr<const void> owner)> SendFn;
+    // 收到一条完整的文本或二进制消息，msg只在调用期间有效；在处理该连接的线程中调用，可以调用ws.Send回复
+    typedef std::function<void(WebSocket& ws, int opcode, std::string_view msg)> MessageHandler;
+
+    struct Frame {
+        bool fin;
+        int opcode;
+        bool masked;
+        uint8_t mask[4];
+        size_t headLen;     // 帧头（含掩码）的长度
+        uint64_t len;       // 负载长度
+    };
+
+    // 为路径注册处理函数并建立同名的频道，只在启动时（创建线程之前）调用
+    static void AddRoute(const std::string& path, MessageHandler handler);
+    static bool HasRoute(const std::string& path);
+    // 把一条消息发给频道中的所有连接，返回投递的连接数；可以在任何线程调用
+    static size_t Broadcast(const std::string& path, int opcode, std::string_view payload);
+    // 连接的收件箱由空变为非空时以fd调用，只在启动时设置
+    static void SetWaker(std::function<void(int fd)> waker);
+
+    // 解析p开始的n个字节中的帧头：不完整返回0，格式错误（保留位、未知操作码、分片或过长的控制帧）返回-1，否则返回1
+    static int ParseHeader(const uint8_t* p, size_t n, Frame* f);
+    static void Unmask(uint8_t* data, size_t len, const uint8_t mask[4]) { unmask_(data, len, mask); }
+    // 服务器帧的帧头（FIN，不加掩码），out至少10字节，返回长度
+    static size_t EncodeHeader(int opcode, uint64_t len, uint8_t* out);
+    static Message MakeMessage(int opcode, std::string_view payload);
+    static std::string AcceptKey(std::string_view key);     // 握手响应的Sec-WebSocket-Accept
+    static bool ValidUtf8(const uint8_t* p, size_t n);
+
+    static const char* Impl() { return impl_; }    // 去除掩码的实现："avx2"、"sse2"或"scalar"
+    static bool Use(const char* impl);              // 指定实现（对比用），CPU不支持时返回false
+
+    // 加入path的频道；send由HttpConn提供，只在处理该连接的线程中调用
+    WebSocket(const std::string& path, int fd, SendFn send);
+    ~WebSocket();   // 退出频道，之后不会再有投递
+
+    // 处理读缓冲区中完整的帧；关闭握手完成或出错（已排队关闭帧）时返回false，发完已排队的帧后应关闭连接
+    bool OnRead(Buffer& buff);
+    // 收件箱中的帧排进发送队列，queued为连接的发送队列中还没发出的字节数；积压过多时排队关闭帧并返回false
+    bool Flush(size_t queued);
+    bool HasInbox() const;
+    void Send(int opcode, std::string_view payload);    // 只发给这个连接
+    void Close(int code);   // 排队关闭帧，之后只等对方的关闭帧
+    // 保活：投递一个Ping（可以在任何线程调用）；上一个Ping之后没有收到过任何帧时返回false，连接应关闭
+    bool Ping();
+    bool Closing() const { return closeSent_; }
+    const std::string& Path() const { return path_; }
+
+private:
+    struct Channel_ {
+        MessageHandler handler;
+        std::mutex mtx;
+        std::vector<WebSocket*> members;
+    };
+    typedef void (*UnmaskFn)(uint8_t* data, size_t len, const uint8_t mask[4]);
+
+    bool Push_(const Message& msg, bool* wake);   // 放进收件箱；积压过多时丢弃并返回false
+    bool OnFrame_(const Frame& f, uint8_t* payload);
+    bool OnMessage_(int opcode, const uint8_t* p, size_t n);
+    bool Fail_(int code);   // 排队关闭帧并丢弃之后的数据，返回false
+    static void Dispatch_(uint8_t* data, size_t len, const uint8_t mask[4]);   // 第一次调用时选择实现
+
+    static std::unordered_map<std::string, std::unique_ptr<Channel_>> channels_;
+    static std::function<void(int fd)> waker_;
+    static UnmaskFn unmask_;
+    static const char* impl_;
+
+    std::string path_;
+    int fd_;
+    SendFn send_;
+    Channel_* channel_;
+    size_t index_;          // 在频道成员中的下标，由频道的锁保护
+
+    int msgOpcode_;         // 正在接收的分片消息的操作码，没有时为-1
+    std::string message_;   // 分片消息拼接到这里
+    bool closeSent_;
+    bool closed_;           // 关闭握手完成或出错，之后的数据丢弃
+
+    mutable std::mutex inboxMtx_;
+    std::vector<Message> inbox_;
+    std::vector<Message> flushing_; // Flush时与inbox_交换，只由处理该连接的线程访问
+    size_t inboxBytes_;
+    bool overflow_;         // 积压过多，丢弃了消息
+    std::atomic<bool> pingSent_;
+};
+
+#endif //WEBSOCKET_H
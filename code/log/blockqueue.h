@@ -53,10 +53,11 @@ BlockQueue<T>::~BlockQueue()
 // 关闭队列
 template<typename T>
 void BlockQueue<T>::Close() {
-    // lock_guard<mutex> locker(mtx_); // 操控队列之前，都需要上锁
-    // deq_.clear();                   // 清空队列
-    clear();
-    isClose_ = true;
+    {
+        lock_guard<mutex> locker(mtx_); // 在锁内置位，避免消费者检查后、等待前错过唤醒
+        deq_.clear();
+        isClose_ = true;
+    }
     condConsumer_.notify_all(); // 唤醒所有消费者
     condProducer_.notify_all(); // 唤醒所有生产者
 }
@@ -115,6 +116,9 @@ bool BlockQueue<T>::pop(T& item)
 {
     unique_lock<mutex> locker(mtx_);
     while(deq_.empty()) {
+        if(isClose_) {
+            return false;               // 队列已关闭，写线程退出
+        }
         condConsumer_.wait(locker);     // 队列空了，需要等待
     }
     item = deq_.front();
@@ -10,14 +10,17 @@ Log::Log() {
     lineCount_ = 0;
     toDay_ = 0;
     isAsync_ = false;
+    writerMigrations_ = 0;
 }
 
 Log::~Log() {
-    while(!deque_->empty()) {
-        deque_->flush();    // 唤醒消费者，处理掉剩下的任务
+    if(deque_ && writeThread_) {    // 只有初始化为异步日志时才有队列和写线程
+        while(!deque_->empty()) {
+            deque_->flush();    // 唤醒消费者，处理掉剩下的任务
+        }
+        deque_->Close();    // 关闭队列
+        writeThread_->join();   // 等待当前线程完成手中的任务
     }
-    deque_->Close();    // 关闭队列
-    writeThread_->join();   // 等待当前线程完成手中的任务
     if(fp_) {       // 冲洗文件缓冲区，关闭文件描述符
         lock_guard<mutex> locker(mtx_);
         flush();        // 清空缓冲区中的数据
@@ -47,12 +50,19 @@ void Log::FlushLogThread() {
 // 写线程真正的执行函数
 void Log::AsyncWrite_() {
     string str = "";
+    int lastCpu = -1;
     while(deque_->pop(str)) {
         lock_guard<mutex> locker(mtx_);
         fputs(str.c_str(), fp_);
+        if(Affinity::Migrated(&lastCpu)) { writerMigrations_.fetch_add(1, memory_order_relaxed); }
     }
 }
 
+bool Log::PinWriter(const vector<int>& cpus) {
+    if(!writeThread_) { return false; }    // 同步日志没有写线程
+    return Affinity::Pin(writeThread_->native_handle(), cpus);
+}
+
 // 初始化日志实例
 void Log::init(int level, const char* path, const char* suffix, int maxQueCapacity) 
 {
@@ -158,6 +168,9 @@ void Log::write(int level, const char *format, ...) {
         va_start(vaList, format);
         int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
         va_end(vaList);
+        // vsnprintf返回的是完整长度，超出缓冲区的部分已被截断
+        if(m < 0) { m = 0; }
+        else if(static_cast<size_t>(m) >= buff_.WritableBytes()) { m = buff_.WritableBytes() - 1; }
 
         buff_.HasWritten(m);
         buff_.Append("\n\0", 2);
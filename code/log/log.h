@@ -4,6 +4,8 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
+#include <atomic>
 #include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>           // vastart va_end
@@ -11,6 +13,7 @@
 #include <sys/stat.h>         // mkdir
 #include "blockqueue.h"
 #include "../buffer/buffer.h"
+#include "../pool/affinity.h"
 
 class Log {
 public:
@@ -28,6 +31,9 @@ public:
     int GetLevel();
     void SetLevel(int level);
     bool IsOpen() { return isOpen_; }
+
+    bool PinWriter(const std::vector<int>& cpus);   // 把异步写线程绑定到一组CPU
+    uint64_t WriterMigrations() const { return writerMigrations_.load(std::memory_order_relaxed); }
     
 private:
     Log();
@@ -58,6 +64,7 @@ private:
     std::unique_ptr<BlockQueue<std::string>> deque_;    //阻塞队列
     std::unique_ptr<std::thread> writeThread_;          //写线程的指针
     std::mutex mtx_;                                    //同步日志必需的互斥量
+    std::atomic<uint64_t> writerMigrations_;            //写线程被观察到的CPU迁移次数
 };
 
 #define LOG_BASE(level, format, ...) \
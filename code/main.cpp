@@ -1,13 +1,72 @@
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 #include "server/webserver.h"
 
-int main() 
+int main(int argc, char* argv[])
 {
-    // 守护进程 后台运行 
+    int port = 1316;
+    int threadNum = 6;      // 线程池数量（reactor + 线程池模型）
+    WebServer::Options options; // 其余的调优参数，各项的含义与默认值见WebServer::Options
+    int opt;
+    // -p 端口  -t 线程池数量  -l reactor线程数（one loop per thread）  -b epoll|uring
+    // -q backlog  -n 每轮accept上限  -a reuseport|exclusive|thread  -i 0|1 混合模式
+    // -u 升级套接字路径  -d 优雅退出期限（秒）
+    // -c reactor的CPU列表  -w 线程池的CPU列表  -g 日志线程的CPU列表  -s 0|1 SO_INCOMING_CPU引导
+    // -m 发送窗口（KB）  -o TCP_NOTSENT_LOWAT（KB）  -e 0|1 免重新注册的边沿触发
+    // -y 自旋时间（微秒）  -z 压缩缓存容量（MB）  -f 上传上限（MB）  -x mmap|sendfile
+    // -r 打开文件缓存的文件数  -k 打开文件缓存的映射容量（MB）  -j 完整响应缓存容量（MB）
+    while((opt = getopt(argc, argv, "p:t:l:b:q:n:a:i:u:d:c:w:g:s:m:o:e:y:z:f:x:r:k:j:")) != -1) {
+        switch(opt) {
+        case 'p': port = atoi(optarg); break;
+        case 't': threadNum = atoi(optarg); break;
+        case 'l': options.loopNum = atoi(optarg); break;
+        case 'b': options.useUring = (strcmp(optarg, "uring") == 0); break;
+        case 'q': options.backlog = atoi(optarg); break;
+        case 'n': options.acceptBatch = atoi(optarg); break;
+        case 'a':
+            if(strcmp(optarg, "exclusive") == 0) { options.acceptMode = WebServer::ACCEPT_EXCLUSIVE; }
+            else if(strcmp(optarg, "thread") == 0) { options.acceptMode = WebServer::ACCEPT_THREAD; }
+            else { options.acceptMode = WebServer::ACCEPT_REUSEPORT; }
+            break;
+        case 'i': options.hybrid = atoi(optarg) != 0; break;
+        case 'u': options.upgradePath = optarg; break;
+        case 'd': options.drainMS = atoi(optarg) * 1000; break;
+        case 'c': options.loopCpus = optarg; break;
+        case 'w': options.workerCpus = optarg; break;
+        case 'g': options.logCpus = optarg; break;
+        case 's': options.steerCpu = atoi(optarg) != 0; break;
+        case 'm': options.sendWindowKB = atoi(optarg); break;
+        case 'o': options.notsentLowatKB = atoi(optarg); break;
+        case 'e': options.edge = atoi(optarg) != 0; break;
+        case 'y': options.spinUs = atoi(optarg); break;
+        case 'z': options.compressCacheMB = atoi(optarg); break;
+        case 'f': options.uploadMB = atoi(optarg); break;
+        case 'x': options.useSendfile = (strcmp(optarg, "sendfile") == 0); break;
+        case 'r': options.fileCacheFiles = atoi(optarg); break;
+        case 'k': options.fileCacheMB = atoi(optarg); break;
+        case 'j': options.respCacheMB = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-p port] [-t threadNum] [-l loopNum] [-b epoll|uring] "
+                            "[-q backlog] [-n acceptBatch] [-a reuseport|exclusive|thread] [-i 0|1] "
+                            "[-u upgradeSock] [-d drainSec] [-c loopCpus] [-w workerCpus] [-g logCpus] [-s 0|1] "
+                            "[-m sendWindowKB] [-o notsentLowatKB] [-e 0|1] [-y spinUs] [-z compressCacheMB] [-f uploadMB] [-x mmap|sendfile] [-r fileCacheFiles] [-k fileCacheMB] [-j respCacheMB]\n",
+                            argv[0]);
+            return 1;
+        }
+    }
+
+    // WebSocket示例：/ws上收到的消息广播给该路径上的所有连接（bench/ws_bench.sh用它测扇出）
+    WebSocket::AddRoute("/ws", [](WebSocket& ws, int opcode, std::string_view msg) {
+        WebSocket::Broadcast(ws.Path(), opcode, msg);
+    });
+
+    // 守护进程 后台运行
     WebServer server(
-        1316, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
+        port, 3, 60000, false,             /* 端口 ET模式 timeoutMs 优雅退出  */
         3306, "root", "Zlx0613@", "webserver", /* Mysql配置 */
-        12, 6, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        12, threadNum, true, 1, 1024,      /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        options);                          /* 调优参数 */
     server.Start();
-} 
+}
 
@@ -0,0 +1,88 @@
+#include "affinity.h"
+
+bool Affinity::ParseCpuList(const char* str, std::vector<int>* cpus) {
+    if(!str || !*str) { return false; }
+    std::vector<int> res;
+    const char* p = str;
+    while(*p) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if(end == p || lo < 0 || lo >= CPU_SETSIZE) { return false; }
+        long hi = lo;
+        p = end;
+        if(*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if(end == p + 1 || hi < lo || hi >= CPU_SETSIZE) { return false; }
+            p = end;
+        }
+        for(long c = lo; c <= hi; c++) { res.push_back((int)c); }
+        if(*p == ',') { p++; }
+        else if(*p) { return false; }
+    }
+    cpus->swap(res);
+    return true;
+}
+
+std::string Affinity::FormatCpuList(const std::vector<int>& cpus) {
+    std::string res;
+    for(size_t i = 0; i < cpus.size(); i++) {
+        if(i) { res += ','; }
+        res += std::to_string(cpus[i]);
+    }
+    return res;
+}
+
+bool Affinity::Pin(pthread_t thread, const std::vector<int>& cpus) {
+    if(cpus.empty()) { return false; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu: cpus) { CPU_SET(cpu, &set); }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+// /sys/devices/system/node/下nodeN目录的个数
+int Affinity::NodeCount() {
+    static int count = [] {
+        int n = 0;
+        DIR* dir = opendir("/sys/devices/system/node");
+        if(dir) {
+            struct dirent* ent;
+            while((ent = readdir(dir)) != nullptr) {
+                int id;
+                if(sscanf(ent->d_name, "node%d", &id) == 1) { n++; }
+            }
+            closedir(dir);
+        }
+        return n > 0 ? n : 1;
+    }();
+    return count;
+}
+
+// /sys/devices/system/cpu/cpuN/下有一个nodeM链接
+int Affinity::NodeOfCpu(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(path);
+    if(!dir) { return 0; }
+    int node = 0;
+    struct dirent* ent;
+    while((ent = readdir(dir)) != nullptr) {
+        if(sscanf(ent->d_name, "node%d", &node) == 1) { break; }
+    }
+    closedir(dir);
+    return node;
+}
+
+// getcpu走vDSO，不陷入内核
+int Affinity::CurrentNode() {
+    unsigned int cpu = 0, node = 0;
+    if(getcpu(&cpu, &node) < 0) { return 0; }
+    return (int)node;
+}
+
+bool Affinity::Migrated(int* lastCpu) {
+    int cpu = sched_getcpu();
+    bool moved = *lastCpu >= 0 && cpu != *lastCpu;
+    *lastCpu = cpu;
+    return moved;
+}
@@ -0,0 +1,35 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <vector>
+#include <string>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+
+/*
+线程的CPU/NUMA放置：解析CPU列表、绑核、查询CPU所在的NUMA节点
+不依赖libnuma：Linux默认按首次访问（first touch）把页分配在访问它的线程所在的节点，
+所以线程先绑核，再由它自己分配并初始化连接状态与缓冲区，内存就在本节点
+*/
+class Affinity {
+public:
+    // "0-3,8,10-11" 形式的CPU列表，空串或格式错误返回false
+    static bool ParseCpuList(const char* str, std::vector<int>* cpus);
+    static std::string FormatCpuList(const std::vector<int>& cpus);
+
+    static bool Pin(pthread_t thread, const std::vector<int>& cpus);    // 绑定到一组CPU
+    static bool PinSelf(int cpu) { return Pin(pthread_self(), std::vector<int>(1, cpu)); }
+
+    static int NodeCount();         // NUMA节点数，没有NUMA信息时为1
+    static int NodeOfCpu(int cpu);  // 未知时为0
+    static int CurrentCpu() { return sched_getcpu(); }
+    static int CurrentNode();
+
+    // 每个线程定期调用，CPU与上次不同则认为发生了一次迁移（采样值，两次调用之间的多次迁移只计一次）
+    static bool Migrated(int* lastCpu);
+};
+
+#endif //AFFINITY_H
@@ -6,7 +6,11 @@
 #include <condition_variable>
 #include <functional>
 #include <thread>
+#include <vector>
+#include <atomic>
+#include <memory>
 #include <assert.h>
+#include "affinity.h"
 
 
 class ThreadPool 
@@ -15,30 +19,41 @@ public:
     ThreadPool() = default; // 默认构造函数
     ThreadPool(ThreadPool&&) = default; // 移动构造函数
     // 尽量用make_shared代替new，如果通过new再传递给shared_ptr，内存是不连续的，会造成内存碎片化
-    explicit ThreadPool(int threadCount = 8) : pool_(std::make_shared<Pool>()) 
+    // cpus不为空时第i个线程绑定到cpus[i % cpus.size()]
+    explicit ThreadPool(int threadCount = 8, const std::vector<int>& cpus = std::vector<int>())
+        : pool_(std::make_shared<Pool>()) 
     { // make_shared:传递右值，功能是在动态内存中分配一个对象并初始化它，返回指向此对象的shared_ptr
         assert(threadCount > 0);
+        pool_->threadCount = threadCount;
+        pool_->migrations.reset(new std::atomic<uint64_t>[threadCount]);
         for(int i = 0; i < threadCount; i++) 
         {
-            // 创建线程，线程函数是lambda表达式
-            std::thread([this]() 
+            pool_->migrations[i] = 0;
+            int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+            // 创建线程，线程函数是lambda表达式；持有pool的shared_ptr，线程池析构后分离的线程仍能安全退出
+            std::thread([pool = pool_, i, cpu]() 
             {
-                std::unique_lock<std::mutex> locker(pool_->mtx_);
+                if(cpu >= 0) { Affinity::PinSelf(cpu); }    // 先绑核，之后线程分配的内存都在本节点
+                int lastCpu = -1;
+                std::unique_lock<std::mutex> locker(pool->mtx_);
                 while(true) {
-                    if(!pool_->tasks.empty()) {
-                        auto task = std::move(pool_->tasks.front());    // 左值变右值,资产转移
-                        pool_->tasks.pop();
+                    if(!pool->tasks.empty()) {
+                        auto task = std::move(pool->tasks.front());    // 左值变右值,资产转移
+                        pool->tasks.pop();
                         locker.unlock();    // 因为已经把任务取出来了，所以可以提前解锁了
                         task();
+                        if(Affinity::Migrated(&lastCpu)) {
+                            pool->migrations[i].fetch_add(1, std::memory_order_relaxed);
+                        }
                         locker.lock();      // 马上又要取任务了，上锁
                     } 
-                    else if(pool_->isClosed) 
+                    else if(pool->isClosed) 
                     {
                         break;
                     } 
                     else 
                     {
-                        pool_->cond_.wait(locker);    // 等待,如果任务来了就notify的
+                        pool->cond_.wait(locker);    // 等待,如果任务来了就notify的
                     }
                 }
             }).detach();
@@ -53,6 +68,10 @@ public:
         pool_->cond_.notify_all();  // 唤醒所有的线程
     }
 
+    int ThreadCount() const { return pool_->threadCount; }
+    // 第i个线程被观察到的CPU迁移次数
+    uint64_t Migrations(int i) const { return pool_->migrations[i].load(std::memory_order_relaxed); }
+
     template<typename T>
     void AddTask(T&& task) {
         std::unique_lock<std::mutex> locker(pool_->mtx_);
@@ -67,6 +86,8 @@ private:
         std::condition_variable cond_;
         bool isClosed;
         std::queue<std::function<void()>> tasks; // 任务队列，函数类型为void()
+        int threadCount;
+        std::unique_ptr<std::atomic<uint64_t>[]> migrations;   // 每个线程一个，只由该线程累加
     };
     std::shared_ptr<Pool> pool_;
 };
@@ -0,0 +1,82 @@
+#include "conntable.h"
+
+ConnTable::ConnTable(int maxFd) : maxFd_(maxFd), nodes_(Affinity::NodeCount()),
+    slots_(new ConnSlot[maxFd]), nodeConns_(new HttpConn*[(size_t)maxFd * Affinity::NodeCount()])
+{
+    assert(maxFd > 0);
+    for(int i = 0; i < maxFd_; i++) {
+        slots_[i].gen = 0;
+        slots_[i].owner = -1;
+        slots_[i].node = 0;
+        slots_[i].conn = nullptr;
+    }
+    for(size_t i = 0; i < (size_t)maxFd_ * nodes_; i++) {
+        nodeConns_[i] = nullptr;
+    }
+}
+
+ConnTable::~ConnTable()
+{
+    for(size_t i = 0; i < (size_t)maxFd_ * nodes_; i++) {
+        delete nodeConns_[i];
+    }
+}
+
+// 只由accept到该fd的reactor线程调用，此时旧连接必然已经close(fd)
+uint64_t ConnTable::Open(int fd, int owner)
+{
+    assert(fd >= 0 && fd < maxFd_);
+    ConnSlot& slot = slots_[fd];
+    int node = nodes_ > 1 ? Affinity::CurrentNode() : 0;
+    if(node >= nodes_) { node = 0; }
+    HttpConn*& conn = nodeConns_[(size_t)fd * nodes_ + node];
+    if(!conn) {
+        conn = new HttpConn();
+    }
+    uint32_t gen = slot.gen.load();
+    gen += (gen & 1) ? 2 : 1;   // 保证是一个新的奇数代
+    slot.owner = owner;
+    slot.node = node;
+    slot.conn.store(conn);
+    slot.gen.store(gen);
+    return MakeTag(fd, gen);
+}
+
+bool ConnTable::Close(uint64_t tag)
+{
+    int fd = TagFd(tag);
+    uint32_t gen = TagGen(tag);
+    if(fd < 0 || fd >= maxFd_ || !(gen & 1)) { return false; }
+    return slots_[fd].gen.compare_exchange_strong(gen, gen + 1);
+}
+
+HttpConn* ConnTable::Get(uint64_t tag) const
+{
+    int fd = TagFd(tag);
+    uint32_t gen = TagGen(tag);
+    if(fd < 0 || fd >= maxFd_ || !(gen & 1)) { return nullptr; }
+    const ConnSlot& slot = slots_[fd];
+    if(slot.gen.load() != gen) { return nullptr; }
+    HttpConn* conn = slot.conn.load();
+    // 读指针期间槽位可能已被重新打开并换成另一节点的对象，再确认一次代数
+    if(slot.gen.load() != gen) { return nullptr; }
+    return conn;
+}
+
+uint64_t ConnTable::Tag(int fd) const
+{
+    assert(fd >= 0 && fd < maxFd_);
+    return MakeTag(fd, slots_[fd].gen.load());
+}
+
+int ConnTable::Owner(int fd) const
+{
+    assert(fd >= 0 && fd < maxFd_);
+    return slots_[fd].owner;
+}
+
+int ConnTable::Node(int fd) const
+{
+    assert(fd >= 0 && fd < maxFd_);
+    return slots_[fd].node;
+}
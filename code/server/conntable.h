@@ -0,0 +1,56 @@
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <assert.h>
+
+#include "../http/httpconn.h"
+#include "../pool/affinity.h"
+
+/*
+按fd下标的连接表，启动时按MAX_FD一次性分配，取代unordered_map<int, HttpConn>
+每个槽位只放每次事件都要访问的热字段（代数、所属reactor、连接指针），4个槽位共享一条cache line；
+缓冲区、请求、响应等冷数据在HttpConn里，首次用到该fd时分配，之后随fd复用，地址永不变化
+
+epoll_event.data里存的是tag = 代数 << 32 | fd，分发时直接按fd取槽位并比较代数，
+代数不一致说明fd已经被关闭或复用，事件/定时器回调属于旧连接，直接丢弃
+代数为奇数表示槽位在用，偶数表示空闲
+
+NUMA：每个fd在每个节点上各有一个HttpConn，由该节点上的reactor线程首次分配（首次访问即本节点内存），
+Open时把槽位指向打开它的线程所在节点的那一个，连接的缓冲区始终与处理它的reactor在同一节点；
+对象只随fd复用，不会释放，过期的指针与原来一样只可能读到同一节点上的另一代连接
+*/
+struct ConnSlot {
+    std::atomic<uint32_t> gen;  // 代数：打开、关闭各加1
+    int16_t owner;              // 所属reactor
+    int16_t node;               // conn所在的NUMA节点
+    std::atomic<HttpConn*> conn;    // 冷数据
+};
+
+class ConnTable {
+public:
+    explicit ConnTable(int maxFd);
+    ~ConnTable();
+
+    uint64_t Open(int fd, int owner);   // 占用fd对应的槽位，返回新连接的tag
+    bool Close(uint64_t tag);           // 使tag失效，并发关闭时只有一个调用者返回true
+    HttpConn* Get(uint64_t tag) const;  // tag过期返回nullptr
+    uint64_t Tag(int fd) const;         // fd当前的tag
+    int Owner(int fd) const;
+    int Node(int fd) const;             // 连接内存所在的NUMA节点
+    int MaxFd() const { return maxFd_; }
+
+    static uint64_t MakeTag(int fd, uint32_t gen) { return (uint64_t)gen << 32 | (uint32_t)fd; }
+    static int TagFd(uint64_t tag) { return (int)(uint32_t)tag; }
+    static uint32_t TagGen(uint64_t tag) { return (uint32_t)(tag >> 32); }
+
+private:
+    int maxFd_;
+    int nodes_;
+    std::unique_ptr<ConnSlot[]> slots_;
+    std::unique_ptr<HttpConn*[]> nodeConns_;    // [fd * nodes_ + node]，只在Open时访问
+};
+
+#endif //CONN_TABLE_H
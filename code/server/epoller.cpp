@@ -16,6 +16,14 @@ bool Epoller::AddFd(int fd, uint32_t events) {
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
 }
 
+bool Epoller::AddFd(int fd, uint32_t events, uint64_t data) {
+    if(fd < 0) return false;
+    epoll_event ev = {0};
+    ev.data.u64 = data;
+    ev.events = events;
+    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+}
+
 bool Epoller::ModFd(int fd, uint32_t events) {
     if(fd < 0) return false;
     epoll_event ev = {0};
@@ -24,6 +32,14 @@ bool Epoller::ModFd(int fd, uint32_t events) {
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
 }
 
+bool Epoller::ModFd(int fd, uint32_t events, uint64_t data) {
+    if(fd < 0) return false;
+    epoll_event ev = {0};
+    ev.data.u64 = data;
+    ev.events = events;
+    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+}
+
 bool Epoller::DelFd(int fd) {
     if(fd < 0) return false;
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, 0);
@@ -34,12 +50,26 @@ int Epoller::Wait(int timeoutMs) {
     return epoll_wait(epollFd_, &events_[0], static_cast<int>(events_.size()), timeoutMs);
 }
 
+bool Epoller::SetBusyPoll(uint32_t usecs, uint16_t budget, bool prefer) {
+    struct epoll_params params = {0};
+    params.busy_poll_usecs = usecs;
+    params.busy_poll_budget = budget;
+    params.prefer_busy_poll = prefer ? 1 : 0;
+    return 0 == ioctl(epollFd_, EPIOCSPARAMS, &params);
+}
+
 // 获取事件的fd
 int Epoller::GetEventFd(size_t i) const {
     assert(i < events_.size() && i >= 0);
     return events_[i].data.fd;
 }
 
+// 获取事件注册时携带的64位数据
+uint64_t Epoller::GetEventData(size_t i) const {
+    assert(i < events_.size() && i >= 0);
+    return events_[i].data.u64;
+}
+
 // 获取事件属性
 uint32_t Epoller::GetEvents(size_t i) const {
     assert(i < events_.size() && i >= 0);
@@ -2,21 +2,39 @@
 #define EPOLLER_H
 
 #include <sys/epoll.h> //epoll_ctl()
+#include <sys/ioctl.h>
+#include <stdint.h>
 #include <unistd.h> // close()
 #include <assert.h> // close()
 #include <vector>
 #include <errno.h>
 
+// epoll的忙轮询参数（Linux 6.9），旧的头文件中没有
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
 class Epoller {
 public:
     explicit Epoller(int maxEvent = 1024);
     ~Epoller();
 
     bool AddFd(int fd, uint32_t events);
+    bool AddFd(int fd, uint32_t events, uint64_t data);  // data存入epoll_event.data.u64
     bool ModFd(int fd, uint32_t events);
+    bool ModFd(int fd, uint32_t events, uint64_t data);
     bool DelFd(int fd);
     int Wait(int timeoutMs = -1);
+    // 等待时在网卡队列上忙轮询usecs微秒（需要网卡驱动支持NAPI），内核不支持时返回false
+    bool SetBusyPoll(uint32_t usecs, uint16_t budget, bool prefer);
     int GetEventFd(size_t i) const;
+    uint64_t GetEventData(size_t i) const;
     uint32_t GetEvents(size_t i) const;
         
 private:
@@ -0,0 +1,91 @@
+#include "handoff.h"
+
+static bool FillAddr(const char* path, struct sockaddr_un* addr) {
+    if(strlen(path) >= sizeof(addr->sun_path)) { return false; }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// 路径上可能残留着旧进程的套接字文件，旧进程的监听不受unlink影响
+int Handoff::Listen(const char* path) {
+    struct sockaddr_un addr;
+    if(!FillAddr(path, &addr)) { return -1; }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) { return -1; }
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int Handoff::Connect(const char* path) {
+    struct sockaddr_un addr;
+    if(!FillAddr(path, &addr)) { return -1; }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0) { return -1; }
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 数据部分只有1字节（套接字个数），描述符放在控制消息中
+bool Handoff::SendFds(int sock, const std::vector<int>& fds) {
+    if(fds.empty() || fds.size() > MAX_FDS) { return false; }
+    char cnt = (char)fds.size();
+    struct iovec iov = { &cnt, 1 };
+    char ctrl[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    memset(ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+bool Handoff::RecvFds(int sock, std::vector<int>* fds) {
+    char cnt = 0;
+    struct iovec iov = { &cnt, 1 };
+    char ctrl[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    if(recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1) { return false; }
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) { continue; }
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int* p = (const int*)CMSG_DATA(cmsg);
+        fds->insert(fds->end(), p, p + n);
+    }
+    return !fds->empty() && (msg.msg_flags & MSG_CTRUNC) == 0;
+}
+
+bool Handoff::SendReady(int sock) {
+    char ok = 1;
+    return send(sock, &ok, 1, MSG_NOSIGNAL) == 1;
+}
+
+bool Handoff::WaitReady(int sock, int timeoutMs) {
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, timeoutMs);
+    } while(ret < 0 && errno == EINTR);
+    if(ret <= 0) { return false; }
+    char ok = 0;
+    return recv(sock, &ok, 1, 0) == 1 && ok == 1;
+}
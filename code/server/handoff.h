@@ -0,0 +1,31 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+平滑升级时新旧进程之间传递监听套接字：
+旧进程在Unix域套接字上等待，新进程连上后旧进程用SCM_RIGHTS把全部监听套接字发过去，
+新进程初始化完成后回一个字节，旧进程收到后停止接入并优雅退出；新进程没有回复就退出时旧进程继续服务
+*/
+class Handoff {
+public:
+    static int Listen(const char* path);    // 旧进程：创建监听的Unix域套接字
+    static int Connect(const char* path);   // 新进程：连接旧进程，没有旧进程时返回-1
+
+    static bool SendFds(int sock, const std::vector<int>& fds);
+    static bool RecvFds(int sock, std::vector<int>* fds);
+
+    static bool SendReady(int sock);
+    static bool WaitReady(int sock, int timeoutMs);
+
+    static const int MAX_FDS = 64;
+};
+
+#endif //HANDOFF_H
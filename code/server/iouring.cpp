@@ -0,0 +1,256 @@
+#include "iouring.h"
+
+static int SysSetup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int SysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int SysRegister(int fd, unsigned op, void* arg, unsigned nrArgs) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, nrArgs);
+}
+
+IoUring::IoUring(unsigned entries, unsigned bufCount, unsigned bufSize):
+    ringFd_(-1), sqHead_(nullptr), sqTail_(nullptr), sqArray_(nullptr), sqMask_(0), sqEntries_(0),
+    sqeTail_(0), sqes_(nullptr), cqHead_(nullptr), cqTail_(nullptr), cqMask_(0), cqes_(nullptr),
+    sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0), sqesSize_(0),
+    bufRing_(nullptr), bufBase_(nullptr), bufCount_(bufCount), bufSize_(bufSize), bufTail_(0)
+{
+    assert(bufCount > 0 && (bufCount & (bufCount - 1)) == 0 && bufCount <= 32768);
+    // 依次尝试：单提交者+延迟任务执行 -> 协作式任务执行 -> 默认
+    const unsigned flagList[] = {
+        IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_COOP_TASKRUN,
+        0,
+    };
+    struct io_uring_params p;
+    for(unsigned flags: flagList) {
+        memset(&p, 0, sizeof(p));
+        p.flags = flags;
+        ringFd_ = SysSetup(entries, &p);
+        if(ringFd_ >= 0) { break; }
+    }
+    if(ringFd_ < 0) { return; }
+    // 需要 EXT_ARG(带超时的等待) 与 SINGLE_MMAP
+    if(!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(ringFd_);
+        ringFd_ = -1;
+        return;
+    }
+
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(cqRingSize_ > sqRingSize_) { sqRingSize_ = cqRingSize_; }
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe*)mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if(sqRing_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        sqes_ = (sqes_ == MAP_FAILED) ? nullptr : sqes_;
+        close(ringFd_);
+        ringFd_ = -1;
+        return;
+    }
+    cqRing_ = sqRing_;  // SINGLE_MMAP：SQ与CQ共用一次映射
+
+    char* sq = (char*)sqRing_;
+    sqHead_ = (unsigned*)(sq + p.sq_off.head);
+    sqTail_ = (unsigned*)(sq + p.sq_off.tail);
+    sqMask_ = *(unsigned*)(sq + p.sq_off.ring_mask);
+    sqEntries_ = *(unsigned*)(sq + p.sq_off.ring_entries);
+    sqArray_ = (unsigned*)(sq + p.sq_off.array);
+    sqeTail_ = *sqTail_;
+    // SQE按顺序使用，索引数组固定为恒等映射
+    for(unsigned i = 0; i < sqEntries_; i++) { sqArray_[i] = i; }
+
+    char* cq = (char*)cqRing_;
+    cqHead_ = (unsigned*)(cq + p.cq_off.head);
+    cqTail_ = (unsigned*)(cq + p.cq_off.tail);
+    cqMask_ = *(unsigned*)(cq + p.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    if(!SetupBufRing_()) {
+        bufRing_ = nullptr;
+    }
+}
+
+IoUring::~IoUring() {
+    if(bufRing_) {
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.bgid = BUF_GROUP;
+        SysRegister(ringFd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(bufRing_, bufCount_ * sizeof(struct io_uring_buf));
+    }
+    if(bufBase_) { munmap(bufBase_, (size_t)bufCount_ * bufSize_); }
+    if(sqes_) { munmap(sqes_, sqesSize_); }
+    if(sqRing_ != MAP_FAILED) { munmap(sqRing_, sqRingSize_); }
+    if(ringFd_ >= 0) { close(ringFd_); }
+}
+
+// 注册提供的缓冲环：内核从环头取缓冲区，用户处理完后放回环尾
+bool IoUring::SetupBufRing_() {
+    size_t ringBytes = bufCount_ * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(ring == MAP_FAILED) { return false; }
+    void* base = mmap(nullptr, (size_t)bufCount_ * bufSize_, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(base == MAP_FAILED) {
+        munmap(ring, ringBytes);
+        return false;
+    }
+    memset(ring, 0, ringBytes);
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring;
+    reg.ring_entries = bufCount_;
+    reg.bgid = BUF_GROUP;
+    if(SysRegister(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(ring, ringBytes);
+        munmap(base, (size_t)bufCount_ * bufSize_);
+        return false;
+    }
+    bufRing_ = (struct io_uring_buf_ring*)ring;
+    bufBase_ = (char*)base;
+    for(unsigned i = 0; i < bufCount_; i++) {
+        RecycleBuf((uint16_t)i);
+    }
+    return true;
+}
+
+void IoUring::RecycleBuf(uint16_t bid) {
+    // 不能用bufRing_->bufs：内核头文件的__DECLARE_FLEX_ARRAY在C++中前面多了一个空结构体，
+    // 数组整体偏移8字节，与内核的布局不一致
+    struct io_uring_buf* buf = (struct io_uring_buf*)bufRing_ + (bufTail_ & (bufCount_ - 1));
+    buf->addr = (uint64_t)(uintptr_t)GetBuf(bid);
+    buf->len = bufSize_;
+    buf->bid = bid;
+    bufTail_++;
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+}
+
+// 取一个空闲SQE，提交队列满了就先提交一次
+struct io_uring_sqe* IoUring::GetSqe_() {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if(sqeTail_ - head >= sqEntries_) {
+        Submit();
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        assert(sqeTail_ - head < sqEntries_);
+    }
+    struct io_uring_sqe* sqe = &sqes_[sqeTail_ & sqMask_];
+    memset(sqe, 0, sizeof(*sqe));
+    sqeTail_++;
+    return sqe;
+}
+
+void IoUring::FlushSq_() {
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+}
+
+void IoUring::PrepAcceptMultishot(int fd, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepRecvMultishot(int fd, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = data;
+}
+
+// MSG_WAITALL：短写由内核继续发送，只有出错才会提前完成
+void IoUring::PrepSendmsg(int fd, const struct msghdr* msg, uint64_t data, bool link) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepShutdown(int fd, uint64_t data, bool link) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_SHUTDOWN;
+    sqe->fd = fd;
+    sqe->len = SHUT_RDWR;
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepClose(int fd, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepPollAdd(int fd, unsigned events, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepCancel(uint64_t target, uint64_t data) {
+    struct io_uring_sqe* sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = data;
+}
+
+int IoUring::Submit() {
+    FlushSq_();
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if(toSubmit == 0) { return 0; }
+    return SysEnter(ringFd_, toSubmit, 0, IORING_ENTER_GETEVENTS, nullptr, 0);
+}
+
+// 一次系统调用完成提交与等待；已有完成事件时不阻塞
+int IoUring::Wait(int timeoutMs) {
+    FlushSq_();
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    unsigned ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) - *cqHead_;
+    if(toSubmit > 0 || ready == 0) {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        unsigned minComplete = ready == 0 ? 1 : 0;
+        if(timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+        int ret = SysEnter(ringFd_, toSubmit, minComplete,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+        if(ret < 0 && errno != ETIME && errno != EINTR) { return -1; }
+    }
+    return (int)(__atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) - *cqHead_);
+}
+
+uint64_t IoUring::GetCqeData(size_t i) const {
+    return cqes_[(*cqHead_ + i) & cqMask_].user_data;
+}
+
+int IoUring::GetCqeRes(size_t i) const {
+    return cqes_[(*cqHead_ + i) & cqMask_].res;
+}
+
+uint32_t IoUring::GetCqeFlags(size_t i) const {
+    return cqes_[(*cqHead_ + i) & cqMask_].flags;
+}
+
+void IoUring::CqeSeen(size_t n) {
+    __atomic_store_n(cqHead_, *cqHead_ + (unsigned)n, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,79 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+io_uring封装，直接使用系统调用（不依赖liburing），接口与Epoller对应：
+Prep*往提交队列里放请求，Wait一次io_uring_enter完成提交与等待，GetCqe*逐个读取完成事件
+接收使用提供的缓冲环（provided buffer ring）+ 多发recv，内核在数据到达时自己挑选缓冲区
+环只能在创建它的线程中使用（IORING_SETUP_SINGLE_ISSUER）
+*/
+class IoUring {
+public:
+    explicit IoUring(unsigned entries = 4096, unsigned bufCount = 1024, unsigned bufSize = 4096);
+    ~IoUring();
+
+    bool IsOk() const { return ringFd_ >= 0 && bufRing_ != nullptr; }
+
+    void PrepAcceptMultishot(int fd, uint64_t data);
+    void PrepRecvMultishot(int fd, uint64_t data);
+    void PrepSendmsg(int fd, const struct msghdr* msg, uint64_t data, bool link);  // msg在完成前必须保持有效
+    void PrepShutdown(int fd, uint64_t data, bool link);
+    void PrepClose(int fd, uint64_t data);
+    void PrepPollAdd(int fd, unsigned events, uint64_t data);   // 单次poll，用于eventfd唤醒
+    void PrepCancel(uint64_t target, uint64_t data);            // 取消user_data为target的请求
+
+    int Submit();                   // 只提交，不等待
+    int Wait(int timeoutMs = -1);   // 提交并等待，返回可读的完成事件数量
+    uint64_t GetCqeData(size_t i) const;
+    int GetCqeRes(size_t i) const;
+    uint32_t GetCqeFlags(size_t i) const;
+    void CqeSeen(size_t n);         // 归还已处理的完成事件
+
+    const char* GetBuf(uint16_t bid) const { return bufBase_ + (size_t)bid * bufSize_; }
+    void RecycleBuf(uint16_t bid);  // 把缓冲区放回缓冲环
+
+    static const uint16_t BUF_GROUP = 0;
+
+private:
+    struct io_uring_sqe* GetSqe_();
+    void FlushSq_();
+    bool SetupBufRing_();
+
+    int ringFd_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqArray_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned sqeTail_;      // 本地尾指针，FlushSq_时发布给内核
+    struct io_uring_sqe* sqes_;
+
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    size_t sqesSize_;
+
+    struct io_uring_buf_ring* bufRing_;
+    char* bufBase_;
+    unsigned bufCount_;
+    unsigned bufSize_;
+    uint16_t bufTail_;
+};
+
+#endif //IOURING_H
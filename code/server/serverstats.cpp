@@ -0,0 +1,46 @@
+#include "serverstats.h"
+
+ServerStats* ServerStats::Instance() {
+    static ServerStats stats;
+    return &stats;
+}
+
+void ServerStats::Dump() {
+    LOG_INFO("Stats accept: accepted=%llu rejected=%llu batchFull=%llu",
+             (unsigned long long)accepted.load(), (unsigned long long)rejected.load(),
+             (unsigned long long)acceptBatchFull.load());
+    LOG_INFO("Stats request: inline=%llu pooled=%llu offloadVerify=%llu offloadCold=%llu offloadBody=%llu pipelined=%llu",
+             (unsigned long long)inlineRequests.load(), (unsigned long long)pooledRequests.load(),
+             (unsigned long long)offloadVerify.load(), (unsigned long long)offloadCold.load(),
+             (unsigned long long)offloadBody.load(), (unsigned long long)pipelined.load());
+    uint64_t cond = conditional.load(), hit = notModified.load();
+    LOG_INFO("Stats conditional: requests=%llu notModified=%llu hitRatio=%.1f%%",
+             (unsigned long long)cond, (unsigned long long)hit, cond ? hit * 100.0 / cond : 0.0);
+    LOG_INFO("Stats encoding: precompressed=%llu cacheHit=%llu compress=%llu evict=%llu",
+             (unsigned long long)encodePrecompressed.load(), (unsigned long long)encodeCacheHit.load(),
+             (unsigned long long)encodeCompress.load(), (unsigned long long)encodeEvict.load());
+    LOG_INFO("Stats file cache: hit=%llu miss=%llu invalidate=%llu evict=%llu",
+             (unsigned long long)fileCacheHit.load(), (unsigned long long)fileCacheMiss.load(),
+             (unsigned long long)fileCacheInvalidate.load(), (unsigned long long)fileCacheEvict.load());
+    LOG_INFO("Stats response cache: hit=%llu store=%llu stale=%llu evict=%llu",
+             (unsigned long long)respCacheHit.load(), (unsigned long long)respCacheStore.load(),
+             (unsigned long long)respCacheStale.load(), (unsigned long long)respCacheEvict.load());
+    LOG_INFO("Stats h2: connections=%llu streams=%llu",
+             (unsigned long long)h2Connections.load(), (unsigned long long)h2Streams.load());
+    LOG_INFO("Stats ws: connections=%llu messages=%llu broadcasts=%llu delivered=%llu pings=%llu slowClosed=%llu",
+             (unsigned long long)wsConnections.load(), (unsigned long long)wsMessages.load(),
+             (unsigned long long)wsBroadcasts.load(), (unsigned long long)wsDelivered.load(),
+             (unsigned long long)wsPings.load(), (unsigned long long)wsSlowClosed.load());
+    LOG_INFO("Stats upload: files=%llu bytes=%llu failed=%llu",
+             (unsigned long long)uploadFiles.load(), (unsigned long long)uploadBytes.load(),
+             (unsigned long long)uploadFailed.load());
+    LOG_INFO("Stats write: yield=%llu eagain=%llu",
+             (unsigned long long)writeYield.load(), (unsigned long long)writeEagain.load());
+    LOG_INFO("Stats edge: dispatch=%llu coalesced=%llu idleOut=%llu",
+             (unsigned long long)edgeDispatch.load(), (unsigned long long)edgeCoalesced.load(),
+             (unsigned long long)edgeIdleOut.load());
+    LOG_INFO("Stats busy poll: error=%llu", (unsigned long long)busyPollError.load());
+    LOG_INFO("Stats placement: steerHit=%llu steerMiss=%llu crossNode=%llu",
+             (unsigned long long)steerHit.load(), (unsigned long long)steerMiss.load(),
+             (unsigned long long)crossNode.load());
+}
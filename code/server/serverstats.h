@@ -0,0 +1,93 @@
+#ifndef SERVERSTATS_H
+#define SERVERSTATS_H
+
+#include <atomic>
+#include <stdint.h>
+#include "../log/log.h"
+
+/*
+服务器运行计数，各reactor线程用relaxed原子操作累加，退出时写入日志
+*/
+class ServerStats {
+public:
+    static ServerStats* Instance();
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t n = 1) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+    void Dump();    // 把所有计数写入日志
+
+    // 接入
+    std::atomic<uint64_t> accepted{0};      // 成功接入的连接
+    std::atomic<uint64_t> rejected{0};      // 超过连接上限被拒绝的连接
+    std::atomic<uint64_t> acceptBatchFull{0};   // 单次处理达到接入上限、留到下一轮的次数
+
+    // 请求的处理路径
+    std::atomic<uint64_t> inlineRequests{0};    // 在reactor线程内完成
+    std::atomic<uint64_t> pooledRequests{0};    // 全部交给线程池（非混合模式）
+    std::atomic<uint64_t> offloadVerify{0};     // 混合模式：登录/注册需要访问数据库
+    std::atomic<uint64_t> offloadCold{0};       // 混合模式：文件不在页缓存中
+    std::atomic<uint64_t> offloadBody{0};       // 混合模式：请求体要写盘（流式处理）或较长
+    std::atomic<uint64_t> pipelined{0};         // 与前一个请求在同一批中处理、响应一起发送的流水线请求
+
+    // 条件请求
+    std::atomic<uint64_t> conditional{0};   // 带If-None-Match或If-Modified-Since的GET/HEAD请求
+    std::atomic<uint64_t> notModified{0};   // 返回304的请求
+
+    // 内容编码
+    std::atomic<uint64_t> encodePrecompressed{0};   // 发送预先压缩的.br/.gz文件
+    std::atomic<uint64_t> encodeCacheHit{0};        // 发送压缩缓存中已有的结果
+    std::atomic<uint64_t> encodeCompress{0};        // 压缩一个文件（每个文件版本一次，淘汰后再次请求时重新压缩）
+    std::atomic<uint64_t> encodeEvict{0};           // 超过容量淘汰的压缩结果
+
+    // 打开文件缓存
+    std::atomic<uint64_t> fileCacheHit{0};          // 命中，不stat也不open
+    std::atomic<uint64_t> fileCacheMiss{0};         // 打开文件（或确认不存在）
+    std::atomic<uint64_t> fileCacheInvalidate{0};   // inotify事件使条目失效
+    std::atomic<uint64_t> fileCacheEvict{0};        // 超过文件数或映射字节数淘汰的条目
+
+    // 完整响应缓存
+    std::atomic<uint64_t> respCacheHit{0};          // 整个响应直接取自缓存
+    std::atomic<uint64_t> respCacheStore{0};        // 生成后放进缓存的响应
+    std::atomic<uint64_t> respCacheStale{0};        // 用到的文件变化或被淘汰，查找时丢掉的条目
+    std::atomic<uint64_t> respCacheEvict{0};        // 超过容量淘汰的条目
+
+    // HTTP/2
+    std::atomic<uint64_t> h2Connections{0}; // 以连接前言或h2c升级开始的HTTP/2连接
+    std::atomic<uint64_t> h2Streams{0};     // 处理的流（请求）
+
+    // WebSocket
+    std::atomic<uint64_t> wsConnections{0}; // 完成握手的连接
+    std::atomic<uint64_t> wsMessages{0};    // 收到的完整消息
+    std::atomic<uint64_t> wsBroadcasts{0};  // 广播（每条消息序列化一次）
+    std::atomic<uint64_t> wsDelivered{0};   // 广播投递到的连接数之和
+    std::atomic<uint64_t> wsPings{0};       // 空闲超时时发出的保活Ping
+    std::atomic<uint64_t> wsSlowClosed{0};  // 积压超过上限被关闭的慢客户端
+
+    // 上传
+    std::atomic<uint64_t> uploadFiles{0};   // 完整写入磁盘的文件
+    std::atomic<uint64_t> uploadBytes{0};   // 写入磁盘的字节数
+    std::atomic<uint64_t> uploadFailed{0};  // 中止（超过限制、格式错误、写盘失败或连接断开）的上传请求
+
+    // 大响应的发送
+    std::atomic<uint64_t> writeYield{0};    // 发送窗口用完，让出线程等下一次可写
+    std::atomic<uint64_t> writeEagain{0};   // 套接字不可写（发送缓冲区满或超过TCP_NOTSENT_LOWAT）
+
+    // 免重新注册模式
+    std::atomic<uint64_t> edgeDispatch{0};  // 事件使reactor取得连接并分发处理
+    std::atomic<uint64_t> edgeCoalesced{0}; // 连接正在被处理，事件只记入状态字（ONESHOT下是一次重新注册）
+    std::atomic<uint64_t> edgeIdleOut{0};   // 没有待发送数据时的可写事件，忽略
+
+    // 低延迟模式
+    std::atomic<uint64_t> busyPollError{0}; // 连接设置SO_BUSY_POLL/SO_PREFER_BUSY_POLL失败（权限或内核不支持）
+
+    // CPU/NUMA放置
+    std::atomic<uint64_t> steerHit{0};      // 连接由处理其软中断的CPU上的reactor接手（SO_INCOMING_CPU）
+    std::atomic<uint64_t> steerMiss{0};
+    std::atomic<uint64_t> crossNode{0};     // 处理连接的线程与连接内存不在同一NUMA节点的事件数
+
+private:
+    ServerStats() = default;
+};
+
+#endif //SERVERSTATS_H
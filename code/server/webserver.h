@@ -2,69 +2,251 @@
 #define WEBSERVER_H
 
 #include <unordered_map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include <fcntl.h>       // fcntl()
+#include <sys/eventfd.h>
+#include <signal.h>
+#include <poll.h>
 #include <unistd.h>      // close()
 #include <assert.h>
 #include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>    // TCP_NOTSENT_LOWAT
 #include <arpa/inet.h>
 
 #include "epoller.h"
+#include "conntable.h"
+#include "iouring.h"
+#include "serverstats.h"
+#include "handoff.h"
 #include "../timer/heaptimer.h"
 
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
+#include "../pool/affinity.h"
 
 #include "../http/httpconn.h"
+#include "../http/handlers.h"
 
 class WebServer {
 public:
+    // 新连接的接入方式（多reactor时）
+    enum ACCEPT_MODE {
+        ACCEPT_REUSEPORT = 0,   // 每个reactor一个SO_REUSEPORT监听套接字
+        ACCEPT_EXCLUSIVE,       // 共享一个监听套接字，以EPOLLEXCLUSIVE加入每个reactor，每次只唤醒一个
+        ACCEPT_THREAD,          // 独立的接入线程accept，轮转分给各reactor
+    };
+
+    // 调优参数，按名字填写（main中由命令行选项填写），默认值与命令行的默认值相同
+    struct Options {
+        int loopNum = 0;                    // reactor线程数，0为reactor + 线程池模型
+        bool useUring = false;              // I/O后端：epoll或io_uring
+        int backlog = 1024;                 // listen队列长度
+        int acceptBatch = 64;               // 每轮事件循环最多accept的连接数
+        int acceptMode = ACCEPT_REUSEPORT;  // 多reactor时新连接的接入方式
+        bool hybrid = true;                 // reactor + 线程池模型下只把慢请求交给线程池
+        const char* upgradePath = nullptr;  // 平滑升级用的Unix域套接字
+        int drainMS = 30000;                // 优雅退出的期限
+        const char* loopCpus = nullptr;     // reactor绑定的CPU列表，如"0-3"
+        const char* workerCpus = nullptr;   // 线程池线程绑定的CPU列表
+        const char* logCpus = nullptr;      // 日志写线程绑定的CPU列表
+        bool steerCpu = false;              // 按SO_INCOMING_CPU把连接交给同一CPU上的reactor
+        int sendWindowKB = 256;             // 每次可写事件最多发送的数据量，0为不限
+        int notsentLowatKB = 128;           // TCP_NOTSENT_LOWAT，0为不设置
+        bool edge = false;                  // 连接只注册一次EPOLLIN|EPOLLOUT|EPOLLET，不用EPOLLONESHOT重新注册
+        int spinUs = 0;                     // 低延迟模式：阻塞前自旋的最长时间（微秒），0为关闭
+        int compressCacheMB = 32;           // 文本类文件gzip压缩结果的缓存容量，0为不压缩（预先压缩的文件照常发送）
+        int uploadMB = 0;                   // 上传（POST /upload）的文件与请求体的最大长度，0为不接受上传（默认）
+        bool useSendfile = false;           // 静态文件的发送方式：mmap + writev或sendfile
+        int fileCacheFiles = 256;           // 打开文件缓存的文件数上限，0为不缓存
+        int fileCacheMB = 64;               // 打开文件缓存中映射的总字节数上限
+        int respCacheMB = 16;               // 完整响应缓存的容量，0为不缓存
+    };
+
     WebServer(
-        int port, int trigMode, int timeoutMS, bool OptLinger, 
-        int sqlPort, const char* sqlUser, const  char* sqlPwd, 
+        int port, int trigMode, int timeoutMS, bool OptLinger,
+        int sqlPort, const char* sqlUser, const  char* sqlPwd,
         const char* dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
+        bool openLog, int logLevel, int logQueSize,
+        const Options& options);
 
     ~WebServer();
     void Start();
 
 private:
-    bool InitSocket_(); 
+    // io_uring后端中一个连接的在途操作状态，只由所属reactor线程访问
+    struct UringConn {
+        uint16_t pending;   // 在途的send/shutdown/close数量
+        bool recvArmed;     // 多发recv是否仍然有效
+        bool closing;       // 在途操作结束后关闭
+        bool error;         // 在途操作出错
+        struct msghdr msg;  // 在途sendmsg的参数
+        std::vector<struct iovec> iov;  // 本段发送的范围（不超过发送窗口），第一次发送时才分配
+    };
+
+    // 一个事件循环（reactor）独占的资源：epoller或io_uring、定时器、监听套接字，连接在users_中记录所属reactor
+    // loopNum_ == 0 时只有一个reactor，读写交给线程池（reactor + 线程池模型）
+    // loopNum_ > 0 时每个reactor一个线程，I/O与请求处理都在本线程完成，新连接的接入方式见ACCEPT_MODE
+    // useUring_ 时reactor用io_uring代替epoller，请求同样在本线程处理
+    struct Reactor {
+        int id;
+        int listenFd;
+        std::unique_ptr<Epoller> epoller;
+        std::unique_ptr<HeapTimer> timer;
+        IoUring* ring;                  // 在reactor线程中创建，见UringLoop_
+        std::vector<UringConn> uconns;  // 按fd下标
+        bool acceptPending;             // ET监听时上一轮达到接入上限，还有连接没取完
+        bool draining;                  // 已停止接入，正在等连接关闭
+        int cpu;                        // 绑定的CPU，-1为不绑定
+        int lastCpu;                    // 上一轮事件循环所在的CPU
+        uint64_t migrations;            // 被观察到的CPU迁移次数，只由本reactor线程累加
+        std::vector<uint64_t> ready;    // 免重新注册模式下发送窗口用完、等下一轮继续发送的连接（只在本线程处理请求时）
+
+        // 低延迟模式，只由本reactor线程访问
+        int spinUs;                     // 当前的自旋预算（微秒），随最近的事件到达情况调整，0为直接阻塞
+        int64_t pollEnd;                // 上一次等待返回的时刻（纳秒），到下一次等待之间是处理事件的时间
+        uint64_t spinNs, workNs, blockNs;   // 自旋、处理事件、阻塞等待的累计时间
+        uint64_t spinHits, spinMisses;  // 自旋期间等到/没等到事件的次数
+
+        // 唤醒事件循环的eventfd：接入线程交来新连接、WebSocket广播、优雅退出
+        int wakeFd;
+        std::mutex pendingMtx;
+        std::vector<std::pair<int, sockaddr_in>> pendingConns;
+        std::vector<uint64_t> wsWakes;  // 收件箱有新消息的WebSocket连接
+
+    };
+
+    enum URING_OP { URING_ACCEPT = 1, URING_RECV, URING_SEND, URING_SHUTDOWN, URING_CLOSE, URING_WAKE, URING_CANCEL };
+
+    bool InitSocket_(Reactor* r);
+    bool CreateListenFd_(Reactor* r);
     void InitEventMode_(int trigMode);
-    void AddClient_(int fd, sockaddr_in addr);
-  
-    void DealListen_();
-    void DealWrite_(HttpConn* client);
-    void DealRead_(HttpConn* client);
+    // 注册默认的路由（静态文件、页面别名、登录/注册、上传）并冻结路由表，main中注册的路由优先；uploadMB为0时不接受上传
+    void InitRoutes_(int uploadMB);
+    void AddClient_(Reactor* r, int fd, sockaddr_in addr);
+    void Loop_(Reactor* r);
+    // 等待本reactor的事件，低延迟模式下先自旋再阻塞
+    int Poll_(Reactor* r, int timeMS);
+    void SetBusyPoll_(int fd);
+    void PinReactor_(Reactor* r);
+
+    void DealListen_(Reactor* r);
+    void DealWake_(Reactor* r);
+    void AcceptLoop_();
+    bool AdmitConn_(int fd);
+
+    // SO_INCOMING_CPU：连接的软中断在哪个CPU上处理，按它把连接交给绑在该CPU上的reactor
+    static int IncomingCpu_(int fd);
+    void CountSteer_(Reactor* r, int fd);
+    // 处理连接的线程与连接内存不在同一NUMA节点时计数
+    void CountNode_(uint64_t tag);
+    void Offload_(Reactor* r, uint64_t tag, void (WebServer::*task)(Reactor*, uint64_t));
+    void DumpThreads_();
+
+    // 优雅退出与平滑升级：信号或新进程接管监听套接字后开始drain，
+    // 各reactor停止接入、关闭空闲连接，正在处理的请求发完响应后关闭，全部关闭或超过期限后退出
+    static void OnSignal_(int sig);
+    void InstallSignal_();
+    void BeginDrain_(bool force);
+    void Wakeup_();
+    bool DrainStep_(Reactor* r, int* timeMS);
+    void StartDrain_(Reactor* r);
+    void InheritListenFds_();
+    void UpgradeLoop_();
+    std::vector<int> ListenFds_() const;
+    void DealWrite_(Reactor* r, HttpConn* client, uint64_t tag);
+    void DealRead_(Reactor* r, HttpConn* client, uint64_t tag);
+    void ArmRead_(Reactor* r, HttpConn* client, uint64_t tag);
+
+    // WebSocket：广播投递进收件箱（任何线程）后交给连接所属的reactor，由它通知处理连接的线程排队发送
+    void WsWake_(int fd);
+    void DealWsWakes_(Reactor* r);
+    void WsKick_(Reactor* r, uint64_t tag);
 
     void SendError_(int fd, const char*info);
-    void ExtentTime_(HttpConn* client);
-    void CloseConn_(HttpConn* client);
+    void ExtentTime_(Reactor* r, HttpConn* client);
+    void CloseConn_(Reactor* r, HttpConn* client, uint64_t tag);
+    void OnTimeout_(Reactor* r, uint64_t tag);
+
+    // tag随任务传给线程池，执行时若连接已关闭或fd已被复用则直接丢弃
+    void OnRead_(Reactor* r, uint64_t tag);
+    void OnWrite_(Reactor* r, uint64_t tag);
+    void OnProcess(Reactor* r, HttpConn* client, uint64_t tag);
 
-    void OnRead_(HttpConn* client);
-    void OnWrite_(HttpConn* client);
-    void OnProcess(HttpConn* client);
+    // 混合模式（reactor + 线程池）：reactor线程读取、解析并发送能立即生成的响应，慢路径交给线程池
+    void HybridRead_(Reactor* r, HttpConn* client, uint64_t tag);
+    void HybridProcess_(Reactor* r, HttpConn* client, uint64_t tag, bool writeNow);
+    void OnRespond_(Reactor* r, uint64_t tag);
+    void OnBody_(Reactor* r, uint64_t tag);
+
+    // 免重新注册模式（见HttpConn::EDGE_STATE）：reactor只记入事件，取得连接的线程处理到没有新事件再释放
+    void EdgeEvent_(Reactor* r, HttpConn* client, uint64_t tag, uint32_t events);
+    void EdgeRun_(Reactor* r, uint64_t tag);
+    void EdgeDrive_(Reactor* r, uint64_t tag);
+
+    // io_uring后端：user_data = 操作码 << 56 | 代数低24位 << 32 | fd
+    void UringLoop_(Reactor* r);
+    void UringAccept_(Reactor* r, int res, uint32_t flags);
+    void UringRecv_(Reactor* r, uint64_t data, int res, uint32_t flags);
+    void UringOpDone_(Reactor* r, uint64_t data, int res);
+    void UringProcess_(Reactor* r, HttpConn* client, uint64_t tag);
+    void UringSend_(Reactor* r, HttpConn* client, uint64_t tag);
+    void UringClose_(Reactor* r, HttpConn* client, uint64_t tag);
+    HttpConn* UringConnOf_(uint64_t data, uint64_t* tag) const;
+    static uint64_t UringData_(int op, uint64_t tag) { return (uint64_t)op << 56 | (tag & 0x00FFFFFFFFFFFFFFULL); }
 
     static const int MAX_FD = 65536;
+    static constexpr int MIN_SPIN_US = 4;       // 自旋预算减半到低于它时不再自旋
+    static const int BUSY_POLL_BUDGET = 8;  // 每次忙轮询最多处理的包数，超过64需要CAP_NET_ADMIN
+    static const int HANDOFF_TIMEOUT_MS = 30000;    // 等待新进程初始化完成的时间
+    static WebServer* instance_;    // 信号处理函数使用
 
     static int SetFdNonblock(int fd);
 
     int port_;
     bool openLinger_;
     int timeoutMS_;  /* 毫秒MS */
-    bool isClose_;
-    int listenFd_;
+    std::atomic<bool> isClose_;
+    int loopNum_;    /* 0: reactor + 线程池; N: N个one-loop-per-thread的reactor */
+    bool useUring_;  /* 用io_uring代替epoll */
+    bool inline_;    /* 请求在reactor线程内处理，不经过线程池 */
+    bool hybrid_;    /* reactor + 线程池模型下只把慢请求交给线程池 */
+    bool edge_;      /* 连接fd只注册一次EPOLLIN|EPOLLOUT|EPOLLET，不用EPOLLONESHOT重新注册 */
+    int backlog_;    /* listen队列长度 */
+    int acceptBatch_;   /* 每轮事件循环最多accept的连接数，避免接入风暴饿死已有连接 */
+    int acceptMode_;
+    std::string upgradePath_;   /* 平滑升级用的Unix域套接字路径，为空不启用 */
+    int drainMS_;               /* 优雅退出的期限 */
+    std::atomic<bool> draining_;
+    std::atomic<int64_t> drainDeadline_;    /* steady_clock毫秒，0表示尚未开始 */
+    int stopFd_;                /* 写入后一直可读，唤醒接入线程与升级线程 */
+    int handoffSock_;           /* 与旧进程的连接，Start时回复初始化完成 */
+    std::vector<int> inheritedFds_; /* 从旧进程接过来、尚未使用的监听套接字 */
+    std::vector<int> loopCpus_;     /* reactor i 绑定到 loopCpus_[i % size]，为空不绑定 */
+    std::vector<int> workerCpus_;   /* 线程池线程 */
+    std::vector<int> logCpus_;      /* 异步日志写线程，绑定到整组 */
+    bool steerCpu_;                 /* 按SO_INCOMING_CPU把连接交给同一CPU上的reactor */
+    std::vector<int> cpuReactor_;   /* CPU号 -> 绑在该CPU上的reactor，-1为没有 */
+    int notsentLowat_;              /* TCP_NOTSENT_LOWAT，内核中未发送数据超过它时套接字不可写，0为不设置 */
+    int spinUs_;                    /* 低延迟模式：阻塞等待前以0超时轮询的最长时间（微秒），0为关闭 */
     char* srcDir_;
-    
+
     uint32_t listenEvent_;  // 监听事件
     uint32_t connEvent_;    // 连接事件
-   
-    std::unique_ptr<HeapTimer> timer_;
+
     std::unique_ptr<ThreadPool> threadpool_;
-    std::unique_ptr<Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::vector<std::thread> loopThreads_;
+    std::thread acceptThread_;
+    std::thread upgradeThread_;
+    std::unique_ptr<ConnTable> users_;  // 按fd下标的连接表
 };
 
 #endif //WEBSERVER_H
@@ -2,29 +2,141 @@
 
 using namespace std;
 
+WebServer* WebServer::instance_ = nullptr;
+
+static int64_t NowMS() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t NowNS() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 WebServer::WebServer(
             int port, int trigMode, int timeoutMS, bool OptLinger,
             int sqlPort, const char* sqlUser, const  char* sqlPwd,
             const char* dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize):
+            bool openLog, int logLevel, int logQueSize,
+            const Options& options):
             port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-            timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+            loopNum_(options.loopNum > 0 ? options.loopNum : 0), useUring_(options.useUring),
+            backlog_(options.backlog > 0 ? options.backlog : SOMAXCONN), acceptBatch_(options.acceptBatch > 0 ? options.acceptBatch : 1),
+            acceptMode_(options.acceptMode), upgradePath_(options.upgradePath ? options.upgradePath : ""), drainMS_(options.drainMS),
+            draining_(false), drainDeadline_(0), handoffSock_(-1), steerCpu_(options.steerCpu),
+            notsentLowat_(options.notsentLowatKB > 0 ? options.notsentLowatKB * 1024 : 0), spinUs_(options.spinUs > 0 ? options.spinUs : 0),
+            users_(new ConnTable(MAX_FD))
     {
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strcat(srcDir_, "/resources/");
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
+    HttpConn::sendWindow = options.sendWindowKB > 0 ? (size_t)options.sendWindowKB * 1024 : 0;
+    CompressCache::Instance()->SetCapacity(options.compressCacheMB > 0 ? (size_t)options.compressCacheMB << 20 : 0);
+    bool fileCacheOk = FileCache::Instance()->Init(srcDir_, options.fileCacheFiles > 0 ? options.fileCacheFiles : 0,
+                                                   options.fileCacheMB > 0 ? (size_t)options.fileCacheMB << 20 : 0);
+    // 缓存的响应靠打开文件缓存知道文件变化，它关闭时不缓存响应
+    bool respCacheOk = fileCacheOk && options.fileCacheFiles > 0;
+    ResponseCache::Instance()->SetCapacity(respCacheOk && options.respCacheMB > 0 ? (size_t)options.respCacheMB << 20 : 0);
 
     // 初始化操作
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);  // 连接池单例的初始化
+    InitRoutes_(options.uploadMB);
+    // 内核不支持io_uring（或多发recv/缓冲环）时退回epoll
+    bool uringFallback = false;
+    if(useUring_) {
+        IoUring probe(8, 1);
+        if(!probe.IsOk()) {
+            useUring_ = false;
+            uringFallback = true;
+        }
+    }
+    // 低延迟模式只用于epoll后端的事件循环
+    bool spinFallback = false;
+    if(spinUs_ > 0 && useUring_) {
+        spinUs_ = 0;
+        spinFallback = true;
+    }
+    // io_uring后端以sendmsg发送映射的内存，不用sendfile
+    HttpConn::sendfile = options.useSendfile && !useUring_;
+    inline_ = loopNum_ > 0 || useUring_;
+    // io_uring没有就绪通知，不需要；混合模式依赖每次重新注册时选择读或写
+    edge_ = options.edge && !useUring_;
+    hybrid_ = options.hybrid && !inline_ && !edge_;
+    // io_uring用每个reactor自己的多发accept，只支持SO_REUSEPORT方式
+    bool acceptModeFallback = false;
+    if(useUring_ && acceptMode_ != ACCEPT_REUSEPORT) {
+        acceptMode_ = ACCEPT_REUSEPORT;
+        acceptModeFallback = true;
+    }
+    // CPU列表，格式错误时不启动
+    const char* badCpus = nullptr;
+    if(options.loopCpus && !Affinity::ParseCpuList(options.loopCpus, &loopCpus_)) { badCpus = options.loopCpus; }
+    if(options.workerCpus && !Affinity::ParseCpuList(options.workerCpus, &workerCpus_)) { badCpus = options.workerCpus; }
+    if(options.logCpus && !Affinity::ParseCpuList(options.logCpus, &logCpus_)) { badCpus = options.logCpus; }
+    if(badCpus) { isClose_ = true; }
+    // 引导连接需要reactor绑核，且每个reactor能单独接入（SO_REUSEPORT）或由接入线程分发
+    bool steerFallback = false;
+    if(steerCpu_ && (loopNum_ == 0 || loopCpus_.empty() || acceptMode_ == ACCEPT_EXCLUSIVE)) {
+        steerCpu_ = false;
+        steerFallback = true;
+    }
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(stopFd_ < 0) { isClose_ = true; }
+    // 平滑升级：有旧进程在运行时接过它的监听套接字
+    if(!upgradePath_.empty()) { InheritListenFds_(); }
+    size_t inheritedCnt = inheritedFds_.size();
     // 初始化事件和初始化socket(监听)
     InitEventMode_(trigMode);
-    if(!InitSocket_()) { isClose_ = true;}
+    if(edge_) {
+        connEvent_ = EPOLLRDHUP | EPOLLET | EPOLLOUT;   // 与EPOLLIN一起注册一次
+        HttpConn::isET = true;
+    }
+    // loopNum_为0时只有一个reactor，读写交给线程池
+    int reactorNum = loopNum_ > 0 ? loopNum_ : 1;
+    bool epollBusyPoll = true;
+    for(int i = 0; i < reactorNum && !isClose_; i++) {
+        std::unique_ptr<Reactor> r(new Reactor());
+        r->id = i;
+        r->listenFd = -1;
+        r->ring = nullptr;
+        r->acceptPending = false;
+        r->draining = false;
+        r->cpu = loopCpus_.empty() ? -1 : loopCpus_[i % loopCpus_.size()];
+        r->lastCpu = -1;
+        r->migrations = 0;
+        r->spinUs = spinUs_;
+        r->pollEnd = 0;
+        r->spinNs = r->workNs = r->blockNs = 0;
+        r->spinHits = r->spinMisses = 0;
+        r->wakeFd = -1;
+        if(r->cpu >= 0) {
+            if((int)cpuReactor_.size() <= r->cpu) { cpuReactor_.resize(r->cpu + 1, -1); }
+            if(cpuReactor_[r->cpu] < 0) { cpuReactor_[r->cpu] = i; }
+        }
+        if(!useUring_) {
+            r->epoller.reset(new Epoller());
+            if(spinUs_ > 0 && !r->epoller->SetBusyPoll(spinUs_, BUSY_POLL_BUDGET, true)) { epollBusyPoll = false; }
+        }
+        r->timer.reset(new HeapTimer());
+        reactors_.push_back(std::move(r));
+        if(!InitSocket_(reactors_.back().get())) { isClose_ = true; break; }
+    }
+    // 旧进程的reactor比本进程多时，多出来的监听套接字用不上，其中排队的连接会被重置
+    size_t unusedCnt = inheritedFds_.size();
+    for(int fd: inheritedFds_) { close(fd); }
+    inheritedFds_.clear();
+    if(!inline_) {
+        threadpool_.reset(new ThreadPool(threadNum, workerCpus_));
+    }
+    WebSocket::SetWaker([this](int fd) { WsWake_(fd); });
 
     // 是否打开日志标志
     if(openLog) {
         Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+        if(badCpus) { LOG_ERROR("Invalid cpu list: %s", badCpus); }
         if(isClose_) { LOG_ERROR("========== Server init error!=========="); }
         else {
             LOG_INFO("========== Server init ==========");
@@ -34,18 +146,101 @@ WebServer::WebServer(
                             (connEvent_ & EPOLLET ? "ET": "LT"));
             LOG_INFO("LogSys level: %d", logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("IO backend: %s", useUring_ ? "io_uring" : "epoll");
+            LOG_INFO("Request scan: %s", HttpScan::Impl());
+            LOG_INFO("Routes: %zu", Router::Instance()->RouteCount());
+            if(Router::Instance()->Rejected()) { LOG_WARN("%zu routes rejected (conflict or bad pattern)", Router::Instance()->Rejected()); }
+            LOG_INFO("WebSocket unmask: %s", WebSocket::Impl());
+            if(uringFallback) { LOG_WARN("io_uring unavailable, fall back to epoll"); }
+            if(edge_) { LOG_INFO("Re-arm-free edge-triggered connections on"); }
+            if(options.edge && useUring_) { LOG_WARN("Re-arm-free mode only applies to epoll backend"); }
+            if(spinUs_ > 0) { LOG_INFO("Low latency mode: spin %dus before blocking, busy poll %dus", spinUs_, spinUs_); }
+            if(spinUs_ > 0 && !epollBusyPoll) { LOG_WARN("epoll busy poll params unsupported, spin in user space only"); }
+            if(spinFallback) { LOG_WARN("Low latency mode only applies to epoll backend"); }
+            LOG_INFO("Send window: %zuKB, TCP_NOTSENT_LOWAT: %dKB", HttpConn::sendWindow / 1024, notsentLowat_ / 1024);
+            LOG_INFO("Static file transmission: %s", HttpConn::sendfile ? "sendfile" : "mmap + writev");
+            if(options.useSendfile && useUring_) { LOG_WARN("sendfile only applies to epoll backend"); }
+            LOG_INFO("Compress cache: %zuMB", CompressCache::Instance()->Capacity() >> 20);
+            LOG_INFO("Open file cache: %zu files, %zuMB mapped", FileCache::Instance()->MaxFiles(),
+                     FileCache::Instance()->MaxBytes() >> 20);
+            if(!fileCacheOk) { LOG_WARN("inotify unavailable, open file cache off"); }
+            LOG_INFO("Response cache: %zuMB", ResponseCache::Instance()->Capacity() >> 20);
+            if(!respCacheOk && options.respCacheMB > 0) { LOG_WARN("Response cache needs the open file cache, off"); }
+            LOG_INFO("Accept mode: %s, backlog: %d, batch: %d",
+                     acceptMode_ == ACCEPT_THREAD ? "thread" : (acceptMode_ == ACCEPT_EXCLUSIVE ? "exclusive" : "reuseport"),
+                     backlog_, acceptBatch_);
+            if(acceptModeFallback) { LOG_WARN("io_uring only supports reuseport accept mode"); }
+            if(!loopCpus_.empty() || !workerCpus_.empty() || !logCpus_.empty()) {
+                LOG_INFO("CPU affinity: loops [%s], workers [%s], log [%s], NUMA nodes: %d",
+                         Affinity::FormatCpuList(loopCpus_).c_str(), Affinity::FormatCpuList(workerCpus_).c_str(),
+                         Affinity::FormatCpuList(logCpus_).c_str(), Affinity::NodeCount());
+            }
+            if(!logCpus_.empty() && !Log::Instance()->PinWriter(logCpus_)) { LOG_WARN("Pin log thread error!"); }
+            if(steerCpu_) { LOG_INFO("SO_INCOMING_CPU steering on"); }
+            if(steerFallback) { LOG_WARN("SO_INCOMING_CPU steering needs -l, -c and reuseport or thread accept mode"); }
+            if(handoffSock_ >= 0) {
+                LOG_INFO("Took over %d listen sockets from old process", (int)(inheritedCnt - unusedCnt));
+                if(unusedCnt > 0) { LOG_WARN("%d inherited listen sockets unused and closed", (int)unusedCnt); }
+            }
+            if(loopNum_ > 0) {
+                LOG_INFO("SqlConnPool num: %d, Reactor loops: %d", connPoolNum, loopNum_);
+            } else {
+                LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, hybrid: %s", connPoolNum, threadNum,
+                         hybrid_ ? "true" : "false");
+            }
         }
     }
 }
 
 WebServer::~WebServer() {
-    close(listenFd_);
     isClose_ = true;
+    Wakeup_();
+    if(acceptThread_.joinable()) { acceptThread_.join(); }
+    if(upgradeThread_.joinable()) { upgradeThread_.join(); }
+    for(auto& t: loopThreads_) {
+        if(t.joinable()) { t.join(); }
+    }
+    if(instance_ == this) { instance_ = nullptr; }
+    WebSocket::SetWaker(nullptr);
+    for(auto& r: reactors_) {
+        // 共享监听套接字时只有第0个reactor持有
+        if(r->listenFd >= 0 && (r->id == 0 || acceptMode_ == ACCEPT_REUSEPORT)) { close(r->listenFd); }
+        if(r->wakeFd >= 0) { close(r->wakeFd); }
+    }
+    if(handoffSock_ >= 0) { close(handoffSock_); }
+    if(stopFd_ >= 0) { close(stopFd_); }
+    DumpThreads_();
+    ServerStats::Instance()->Dump();
     free(srcDir_);
     SqlConnPool::Instance()->ClosePool();
 }
 
+void WebServer::InitRoutes_(int uploadMB) {
+    Router* router = Router::Instance();
+    if(router->Frozen()) { return; }
+    // 其他路径按静态文件发送；页面可以省略.html
+    router->Add("*", "/*file", std::make_shared<StaticHandler>());
+    router->Add("*", "/", std::make_shared<StaticHandler>("/index.html"));
+    for(const char* page: { "/index", "/register", "/login", "/welcome", "/video", "/picture", "/upload" }) {
+        router->Add("*", page, std::make_shared<StaticHandler>(std::string(page) + ".html"));
+    }
+    // 登录/注册页面的表单提交到去掉.html的路径
+    auto login = std::make_shared<UserHandler>(true);
+    auto reg = std::make_shared<UserHandler>(false);
+    router->Add("POST", "/login", login);
+    router->Add("POST", "/login.html", login);
+    router->Add("POST", "/register", reg);
+    router->Add("POST", "/register.html", reg);
+    // 上传的文件流式写入工作目录下的uploads/（与log/同级，不在resources/中，不会被当作静态文件发送），
+    // 单个文件与整个请求体都不超过uploadMB（不超过流式请求体的上限）
+    if(uploadMB > 0) {
+        size_t limit = (size_t)uploadMB << 20;
+        if(limit > HttpRequest::MAX_STREAM_BODY) { limit = HttpRequest::MAX_STREAM_BODY; }
+        router->Add("POST", "/upload", std::make_shared<UploadHandler>("./uploads/", limit, limit));
+    }
+    router->Freeze();
+}
+
 void WebServer::InitEventMode_(int trigMode) {
     listenEvent_ = EPOLLRDHUP;    // 检测socket关闭
     connEvent_ = EPOLLONESHOT | EPOLLRDHUP;     // EPOLLONESHOT由一个线程处理
@@ -72,150 +267,895 @@ void WebServer::InitEventMode_(int trigMode) {
 }
 
 void WebServer::Start() {
+    if(!isClose_) {
+        LOG_INFO("========== Server start ==========");
+        InstallSignal_();
+    }
+    // 第0个reactor在当前线程运行，其余每个reactor独占一个线程
+    void (WebServer::*loop)(Reactor*) = useUring_ ? &WebServer::UringLoop_ : &WebServer::Loop_;
+    for(size_t i = 1; i < reactors_.size() && !isClose_; i++) {
+        loopThreads_.emplace_back(loop, this, reactors_[i].get());
+    }
+    if(!isClose_ && acceptMode_ == ACCEPT_THREAD) {
+        acceptThread_ = std::thread(&WebServer::AcceptLoop_, this);
+    }
+    if(!isClose_ && handoffSock_ >= 0) {
+        // 已经可以服务，通知旧进程开始退出
+        if(!Handoff::SendReady(handoffSock_)) { LOG_WARN("Notify old process error!"); }
+        close(handoffSock_);
+        handoffSock_ = -1;
+    }
+    if(!isClose_ && !upgradePath_.empty()) {
+        upgradeThread_ = std::thread(&WebServer::UpgradeLoop_, this);
+    }
+    if(!isClose_) { (this->*loop)(reactors_[0].get()); }
+    // 第0个reactor因出错退出时，其余线程也要结束
+    if(!draining_) { isClose_ = true; }
+    Wakeup_();
+    if(acceptThread_.joinable()) { acceptThread_.join(); }
+    if(upgradeThread_.joinable()) { upgradeThread_.join(); }
+    for(auto& t: loopThreads_) {
+        if(t.joinable()) { t.join(); }
+    }
+    LOG_INFO("========== Server stop ==========");
+}
+
+void WebServer::OnSignal_(int sig) {
+    if(instance_) { instance_->BeginDrain_(sig == SIGQUIT); }
+}
+
+// SIGTERM/SIGINT优雅退出，再收到一次或SIGQUIT立即退出
+void WebServer::InstallSignal_() {
+    instance_ = this;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &WebServer::OnSignal_;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, nullptr);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGQUIT, &sa, nullptr);
+    sa.sa_handler = SIG_IGN;    // 对端关闭后继续写不能杀死进程
+    sigaction(SIGPIPE, &sa, nullptr);
+}
+
+// 会在信号处理函数中调用，只能使用原子变量与write
+void WebServer::BeginDrain_(bool force) {
+    if(force || draining_) { isClose_ = true; }
+    draining_ = true;
+    HttpConn::draining = true;
+    Wakeup_();
+}
+
+void WebServer::Wakeup_() {
+    uint64_t one = 1;
+    ssize_t ret;
+    if(stopFd_ >= 0) { ret = write(stopFd_, &one, sizeof(one)); }
+    for(auto& r: reactors_) {
+        if(r->wakeFd >= 0) { ret = write(r->wakeFd, &one, sizeof(one)); }
+    }
+    (void)ret;
+}
+
+// 每轮事件循环开始时调用：第一次进入drain时停止接入并关闭空闲连接，
+// 之后连接全部关闭或超过期限时返回true，结束事件循环
+bool WebServer::DrainStep_(Reactor* r, int* timeMS) {
+    if(!draining_) { return false; }
+    if(!r->draining) { StartDrain_(r); }
+    int64_t now = NowMS();
+    int64_t deadline = 0;
+    if(drainDeadline_.compare_exchange_strong(deadline, now + drainMS_)) {
+        deadline = now + drainMS_;
+        LOG_INFO("Draining, %d connections, deadline %dms", (int)HttpConn::userCount, drainMS_);
+    }
+    if(HttpConn::userCount <= 0) { return true; }
+    if(now >= deadline) {
+        LOG_WARN("Drain timeout on reactor %d, %d connections left", r->id, (int)HttpConn::userCount);
+        return true;
+    }
+    if(*timeMS < 0 || *timeMS > 100) { *timeMS = 100; }    // 定期检查是否已经关完
+    return false;
+}
+
+void WebServer::StartDrain_(Reactor* r) {
+    r->draining = true;
+    // 监听套接字可能已经交给了新进程，只能从自己的事件循环中移除，不能shutdown
+    if(r->epoller && acceptMode_ != ACCEPT_THREAD) { r->epoller->DelFd(r->listenFd); }
+    if(r->ring) { r->ring->PrepCancel(UringData_(URING_ACCEPT, 0), UringData_(URING_CANCEL, 0)); }
+    r->acceptPending = false;
+    // 空闲的keep-alive连接直接关闭，其余连接在当前响应发完后关闭
+    int closed = 0;
+    for(int fd = 0; fd < MAX_FD; fd++) {
+        if(users_->Owner(fd) != r->id) { continue; }
+        uint64_t tag = users_->Tag(fd);
+        HttpConn* client = users_->Get(tag);
+        if(!client || !client->IsIdle()) { continue; }
+        if(edge_) {
+            // 取得连接后再确认一次空闲，之前可能已被其他线程处理过
+            if(!client->EdgeAcquire(tag)) { continue; }
+            if(!client->IsIdle()) {
+                if(!client->EdgeRelease()) { EdgeRun_(r, tag); }
+                continue;
+            }
+        }
+        if(r->ring) {
+            UringClose_(r, client, tag);
+        } else {
+            CloseConn_(r, client, tag);
+        }
+        closed++;
+    }
+    LOG_INFO("Reactor %d stop accepting, close %d idle connections", r->id, closed);
+}
+
+// 监听套接字，SO_REUSEPORT时每个reactor一个，其余方式只有一个
+std::vector<int> WebServer::ListenFds_() const {
+    std::vector<int> fds;
+    for(auto& r: reactors_) {
+        if(r->listenFd >= 0 && (r->id == 0 || acceptMode_ == ACCEPT_REUSEPORT)) { fds.push_back(r->listenFd); }
+    }
+    return fds;
+}
+
+// 连接upgradePath_，有旧进程在等待就接收它的监听套接字，没有则正常启动
+void WebServer::InheritListenFds_() {
+    handoffSock_ = Handoff::Connect(upgradePath_.c_str());
+    if(handoffSock_ < 0) { return; }
+    if(!Handoff::RecvFds(handoffSock_, &inheritedFds_)) {
+        for(int fd: inheritedFds_) { close(fd); }
+        inheritedFds_.clear();
+        close(handoffSock_);
+        handoffSock_ = -1;
+    }
+}
+
+// 升级线程：等待新进程连接，把监听套接字交给它，新进程初始化完成后本进程开始drain
+void WebServer::UpgradeLoop_() {
+    int fd = Handoff::Listen(upgradePath_.c_str());
+    if(fd < 0) {
+        LOG_ERROR("Upgrade socket %s error!", upgradePath_.c_str());
+        return;
+    }
+    LOG_INFO("Upgrade socket: %s", upgradePath_.c_str());
+    while(!isClose_ && !draining_) {
+        struct pollfd pfds[2] = { { fd, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+        if(poll(pfds, 2, -1) <= 0) { continue; }
+        if(pfds[1].revents) { break; }
+        int conn = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(conn < 0) { continue; }
+        if(Handoff::SendFds(conn, ListenFds_()) && Handoff::WaitReady(conn, HANDOFF_TIMEOUT_MS)) {
+            LOG_INFO("Listen sockets handed off to new process, draining");
+            BeginDrain_(false);
+        } else {
+            LOG_WARN("Upgrade aborted, new process did not take over");
+        }
+        close(conn);
+    }
+    close(fd);  // 不unlink：同一路径此时可能已经属于新进程
+}
+
+// 事件循环，只处理本reactor的epoller上的事件
+void WebServer::Loop_(Reactor* r) {
+    PinReactor_(r);
     int timeMS = -1;  /* epoll wait timeout == -1 无事件将阻塞 */
-    if(!isClose_) { LOG_INFO("========== Server start =========="); }
     while(!isClose_) {
         if(timeoutMS_ > 0) {
-            timeMS = timer_->GetNextTick();     // 获取下一次的超时等待事件(至少这个时间才会有用户过期，每次关闭超时连接则需要有新的请求进来)
+            timeMS = r->timer->GetNextTick();     // 获取下一次的超时等待事件(至少这个时间才会有用户过期，每次关闭超时连接则需要有新的请求进来)
         }
-        int eventCnt = epoller_->Wait(timeMS);
+        if(DrainStep_(r, &timeMS)) { break; }
+        // 上一轮还有没accept完的连接（ET不会再通知），本轮不阻塞，处理完其他事件后继续accept
+        bool acceptAgain = r->acceptPending;
+        int eventCnt = Poll_(r, acceptAgain || !r->ready.empty() ? 0 : timeMS);
+        if(Affinity::Migrated(&r->lastCpu)) { r->migrations++; }
         for(int i = 0; i < eventCnt; i++) {
             /* 处理事件 */
-            int fd = epoller_->GetEventFd(i);
-            uint32_t events = epoller_->GetEvents(i);
-            if(fd == listenFd_) {
-                DealListen_();
+            uint64_t tag = r->epoller->GetEventData(i);
+            uint32_t events = r->epoller->GetEvents(i);
+            int fd = ConnTable::TagFd(tag);
+            if(fd == r->listenFd) {
+                acceptAgain = false;
+                DealListen_(r);
+                continue;
+            }
+            if(fd == r->wakeFd) {
+                DealWake_(r);
+                continue;
+            }
+            HttpConn* client = users_->Get(tag);
+            if(!client) {
+                LOG_DEBUG("Drop stale event of fd[%d]", ConnTable::TagFd(tag));
+                continue;
             }
-            else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
+            if(edge_) {
+                EdgeEvent_(r, client, tag, events);
+                continue;
+            }
+            if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                CloseConn_(r, client, tag);
             }
             else if(events & EPOLLIN) {
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                DealRead_(r, client, tag);
             }
             else if(events & EPOLLOUT) {
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                DealWrite_(r, client, tag);
             } else {
                 LOG_ERROR("Unexpected event");
             }
         }
+        if(acceptAgain) { DealListen_(r); }
+        // 上一轮发送窗口用完的连接排在本轮的事件之后继续发送
+        if(!r->ready.empty()) {
+            std::vector<uint64_t> ready;
+            ready.swap(r->ready);
+            for(uint64_t tag: ready) { EdgeDrive_(r, tag); }
+        }
+    }
+}
+
+// 低延迟模式：阻塞之前先以0超时轮询至多r->spinUs微秒，事件很快到来时省掉一次睡眠与唤醒。
+// 自旋预算按最近的事件到达情况调整：自旋中等到事件、或阻塞后在预算之内就等到事件时加倍（不超过spinUs_），
+// 自旋落空时减半，低于MIN_SPIN_US时直接阻塞，空闲的服务器不会一直占着CPU
+int WebServer::Poll_(Reactor* r, int timeMS) {
+    if(spinUs_ <= 0) { return r->epoller->Wait(timeMS); }
+    int64_t now = NowNS();
+    if(r->pollEnd > 0) { r->workNs += now - r->pollEnd; }
+    int eventCnt = 0;
+    if(timeMS != 0 && r->spinUs > 0) {
+        int64_t spinNs = (int64_t)r->spinUs * 1000;
+        if(timeMS > 0) { spinNs = std::min(spinNs, (int64_t)timeMS * 1000000); }
+        int64_t start = now;
+        do {
+            eventCnt = r->epoller->Wait(0);
+            now = NowNS();
+        } while(eventCnt == 0 && now - start < spinNs);
+        r->spinNs += now - start;
+        if(eventCnt != 0) {
+            r->spinHits++;
+            r->spinUs = std::min(r->spinUs * 2, spinUs_);
+            r->pollEnd = now;
+            return eventCnt;
+        }
+        r->spinMisses++;
+        r->spinUs /= 2;
+        if(r->spinUs < MIN_SPIN_US) { r->spinUs = 0; }
     }
+    eventCnt = r->epoller->Wait(timeMS);
+    int64_t end = NowNS();
+    r->blockNs += end - now;
+    if(eventCnt > 0 && timeMS != 0 && end - now < (int64_t)spinUs_ * 1000) {
+        r->spinUs = std::min(std::max(r->spinUs * 2, MIN_SPIN_US), spinUs_);
+    }
+    r->pollEnd = end;
+    return eventCnt;
 }
 
+// 连接上的阻塞读与epoll等待在网卡队列上忙轮询；超过net.core.busy_poll的值需要CAP_NET_ADMIN
+void WebServer::SetBusyPoll_(int fd) {
+    int usecs = spinUs_;
+    int prefer = 1;
+    if(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) < 0 ||
+       setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0) {
+        ServerStats::Add(ServerStats::Instance()->busyPollError);
+    }
+}
+
+// 新连接的发送缓冲区是空的，非阻塞发送一个短响应不会失败，也不会阻塞reactor
 void WebServer::SendError_(int fd, const char*info) {
     assert(fd > 0);
-    int ret = send(fd, info, strlen(info), 0);
+    int ret = send(fd, info, strlen(info), MSG_DONTWAIT | MSG_NOSIGNAL);
     if(ret < 0) {
         LOG_WARN("send error to client[%d] error!", fd);
     }
     close(fd);
 }
 
-void WebServer::CloseConn_(HttpConn* client) {
-    assert(client);
+void WebServer::CloseConn_(Reactor* r, HttpConn* client, uint64_t tag) {
+    assert(r && client);
+    if(!users_->Close(tag)) { return; }   // 已被其他路径关闭
     LOG_INFO("Client[%d] quit!", client->GetFd());
-    epoller_->DelFd(client->GetFd());
+    if(r->epoller) {
+        r->epoller->DelFd(client->GetFd());
+    } else {
+        // 多发recv持有socket的引用，仅close不会断开连接，先shutdown让它结束
+        shutdown(client->GetFd(), SHUT_RDWR);
+    }
     client->Close();
 }
 
-void WebServer::AddClient_(int fd, sockaddr_in addr) {
+// 超时回调只带tag，fd被复用后旧连接的回调不会关掉新连接
+void WebServer::OnTimeout_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
+    if(edge_ && !client->EdgeAcquire(tag)) {
+        // 正在被其他线程处理，不能关闭；处理完后再等一个超时
+        r->timer->add(client->GetFd(), timeoutMS_, std::bind(&WebServer::OnTimeout_, this, r, tag));
+        return;
+    }
+    if(!edge_ && client->InTask()) {
+        // 工作线程还持有连接（处理中或已排队），关闭后fd可能被复用；同样等它处理完再等一个超时
+        r->timer->add(client->GetFd(), timeoutMS_, std::bind(&WebServer::OnTimeout_, this, r, tag));
+        return;
+    }
+    if(client->IsWebSocket() && client->WsPing()) {
+        // 空闲的WebSocket连接先发Ping保活，再过一个超时还没有收到任何帧（Pong）才关闭
+        ServerStats::Add(ServerStats::Instance()->wsPings);
+        r->timer->add(client->GetFd(), timeoutMS_, std::bind(&WebServer::OnTimeout_, this, r, tag));
+        if(edge_) {
+            client->EdgeLatch(tag, HttpConn::EDGE_READ);    // 已取得连接，只记入事件
+            EdgeRun_(r, tag);
+        } else {
+            WsKick_(r, tag);
+        }
+        return;
+    }
+    if(r->ring) {
+        UringClose_(r, client, tag);
+    } else {
+        CloseConn_(r, client, tag);
+    }
+}
+
+void WebServer::AddClient_(Reactor* r, int fd, sockaddr_in addr) {
     assert(fd > 0);
-    users_[fd].init(fd, addr);
+    uint64_t tag = users_->Open(fd, r->id);
+    HttpConn* client = users_->Get(tag);
+    client->init(fd, addr);
+    client->EdgeInit(tag);
     if(timeoutMS_ > 0) {
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        r->timer->add(fd, timeoutMS_, std::bind(&WebServer::OnTimeout_, this, r, tag));
     }
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);
-    SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    if(spinUs_ > 0) { SetBusyPoll_(fd); }
+    r->epoller->AddFd(fd, EPOLLIN | connEvent_, tag);   // fd由accept4设为非阻塞
+    ServerStats::Add(ServerStats::Instance()->accepted);
+    CountSteer_(r, fd);
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
-// 处理监听套接字，主要逻辑是accept新的套接字，并加入timer和epoller中
-void WebServer::DealListen_() {
+// 超过连接上限的新连接：回一个503后立即关闭，返回false
+bool WebServer::AdmitConn_(int fd) {
+    if(HttpConn::userCount < MAX_FD && fd < MAX_FD) { return true; }
+    SendError_(fd, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    uint64_t n = ServerStats::Instance()->rejected.fetch_add(1, std::memory_order_relaxed) + 1;
+    if((n & (n - 1)) == 0) {    // 接入风暴时只在第1、2、4、8...次记录日志
+        LOG_WARN("Clients is full! rejected: %llu", (unsigned long long)n);
+    }
+    return false;
+}
+
+// 处理监听套接字，主要逻辑是accept新的套接字，并加入本reactor的timer和epoller中
+// 每次最多accept acceptBatch_个连接，剩下的留到下一轮，避免接入风暴时已有连接得不到处理
+void WebServer::DealListen_(Reactor* r) {
     struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
-    do {
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
-        if(fd <= 0) { return;}
-        else if(HttpConn::userCount >= MAX_FD) {
-            SendError_(fd, "Server busy!");
-            LOG_WARN("Clients is full!");
+    socklen_t len;
+    r->acceptPending = false;
+    for(int i = 0; i < acceptBatch_; i++) {
+        len = sizeof(addr);
+        int fd = accept4(r->listenFd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) { return; }
+        if(AdmitConn_(fd)) { AddClient_(r, fd, addr); }
+    }
+    // LT模式下监听套接字仍可读，内核会再次通知；ET模式需要自己记住
+    r->acceptPending = (listenEvent_ & EPOLLET);
+    ServerStats::Add(ServerStats::Instance()->acceptBatchFull);
+}
+
+// 接入线程：在共享的监听套接字上accept，按轮转把新连接交给各reactor
+// 队列由空变为非空时才写eventfd，接入风暴时一次唤醒可以带走一批连接
+void WebServer::AcceptLoop_() {
+    int listenFd = reactors_[0]->listenFd;
+    size_t next = 0;
+    struct pollfd pfds[2] = { { listenFd, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+    while(!isClose_ && !draining_) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listenFd, (struct sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            if(errno == EAGAIN) {
+                // 监听套接字可能要交给新进程，不能用shutdown唤醒阻塞的accept，所以poll监听套接字与stopFd_
+                poll(pfds, 2, -1);
+                continue;
+            }
+            if(errno == EINTR || errno == ECONNABORTED) { continue; }
+            LOG_ERROR("Accept thread exit, errno: %d", errno);
             return;
         }
-        AddClient_(fd, addr);
-    } while(listenEvent_ & EPOLLET);
+        if(!AdmitConn_(fd)) { continue; }
+        Reactor* r = nullptr;
+        if(steerCpu_) {
+            int cpu = IncomingCpu_(fd);
+            if(cpu >= 0 && cpu < (int)cpuReactor_.size() && cpuReactor_[cpu] >= 0) {
+                r = reactors_[cpuReactor_[cpu]].get();
+                ServerStats::Add(ServerStats::Instance()->steerHit);
+            } else {
+                ServerStats::Add(ServerStats::Instance()->steerMiss);
+            }
+        }
+        if(!r) { r = reactors_[next++ % reactors_.size()].get(); }
+        bool wake;
+        {
+            std::lock_guard<std::mutex> locker(r->pendingMtx);
+            wake = r->pendingConns.empty();
+            r->pendingConns.emplace_back(fd, addr);
+        }
+        if(wake) {
+            uint64_t one = 1;
+            ssize_t ret = write(r->wakeFd, &one, sizeof(one));
+            (void)ret;
+        }
+    }
 }
 
-// 处理读事件，主要逻辑是将OnRead加入线程池的任务队列中
-void WebServer::DealRead_(HttpConn* client) {
-    assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client)); // 这是一个右值，bind将参数和函数绑定
+// 取走接入线程交过来的连接
+void WebServer::DealWake_(Reactor* r) {
+    uint64_t cnt;
+    ssize_t ret = read(r->wakeFd, &cnt, sizeof(cnt));
+    (void)ret;
+    std::vector<std::pair<int, sockaddr_in>> conns;
+    {
+        std::lock_guard<std::mutex> locker(r->pendingMtx);
+        conns.swap(r->pendingConns);
+    }
+    for(auto& c: conns) {
+        AddClient_(r, c.first, c.second);
+    }
+    DealWsWakes_(r);
+}
+
+// 收件箱由空变为非空时由投递的线程调用；队列由空变为非空时才写eventfd，一次广播对同一个reactor只唤醒一次
+void WebServer::WsWake_(int fd) {
+    Reactor* r = reactors_[users_->Owner(fd)].get();
+    uint64_t tag = users_->Tag(fd);
+    bool wake;
+    {
+        std::lock_guard<std::mutex> locker(r->pendingMtx);
+        wake = r->wsWakes.empty();
+        r->wsWakes.push_back(tag);
+    }
+    if(wake) {
+        uint64_t one = 1;
+        ssize_t ret = write(r->wakeFd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+void WebServer::DealWsWakes_(Reactor* r) {
+    std::vector<uint64_t> tags;
+    {
+        std::lock_guard<std::mutex> locker(r->pendingMtx);
+        tags.swap(r->wsWakes);
+    }
+    for(uint64_t tag: tags) { WsKick_(r, tag); }
+}
+
+// 在reactor线程中通知处理连接的线程：免重新注册模式记入可读事件，io_uring与epoll在没有发送中的数据时直接排队发送；
+// 正在发送的连接发完后会检查收件箱（HasReadBytes）
+void WebServer::WsKick_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client || !client->IsWebSocket()) { return; }
+    if(edge_) {
+        if(client->EdgeLatch(tag, HttpConn::EDGE_READ)) { EdgeRun_(r, tag); }
+        return;
+    }
+    if(r->ring) {
+        UringConn& uc = r->uconns[client->GetFd()];
+        if(uc.pending == 0 && !uc.closing) { UringProcess_(r, client, tag); }
+        return;
+    }
+    // reactor + 线程池模型下还在线程池中的连接交回reactor线程时处理（见ArmRead_）
+    if((!inline_ && !client->WsInline()) || client->ToWriteBytes() > 0) { return; }
+    client->SetIdle(false);
+    client->process();
+    if(client->ToWriteBytes() > 0) {
+        OnWrite_(r, tag);
+    } else if(!client->IsKeepAlive()) {
+        CloseConn_(r, client, tag);
+    }
+}
+
+// 绑核后本线程分配的内存（io_uring环、uconns、新连接）都在该CPU所在的节点
+void WebServer::PinReactor_(Reactor* r) {
+    if(r->cpu < 0) { return; }
+    if(!Affinity::PinSelf(r->cpu)) {
+        LOG_WARN("Pin reactor %d to cpu %d error!", r->id, r->cpu);
+        return;
+    }
+    LOG_INFO("Reactor %d pinned to cpu %d, node %d", r->id, r->cpu, Affinity::NodeOfCpu(r->cpu));
+}
+
+int WebServer::IncomingCpu_(int fd) {
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if(getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) { return -1; }
+    return cpu;
+}
+
+// SO_REUSEPORT方式下由内核引导，这里只统计连接是否落在了处理其软中断的CPU上
+void WebServer::CountSteer_(Reactor* r, int fd) {
+    if(!steerCpu_ || acceptMode_ != ACCEPT_REUSEPORT) { return; }
+    ServerStats* stats = ServerStats::Instance();
+    ServerStats::Add(IncomingCpu_(fd) == r->cpu ? stats->steerHit : stats->steerMiss);
+}
+
+void WebServer::CountNode_(uint64_t tag) {
+    if(Affinity::NodeCount() > 1 && users_->Node(ConnTable::TagFd(tag)) != Affinity::CurrentNode()) {
+        ServerStats::Add(ServerStats::Instance()->crossNode);
+    }
+}
+
+// 交给线程池，任务开始时统计跨节点访问
+void WebServer::Offload_(Reactor* r, uint64_t tag, void (WebServer::*task)(Reactor*, uint64_t)) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
+    client->TaskBegin();
+    threadpool_->AddTask([this, r, tag, task, client] {
+        CountNode_(tag);
+        (this->*task)(r, tag);
+        client->TaskEnd();
+    });
+}
+
+// 每个线程被观察到的CPU迁移次数，绑核成功时应为0
+void WebServer::DumpThreads_() {
+    for(auto& r: reactors_) {
+        LOG_INFO("Stats reactor %d cpu %d: migrations=%llu", r->id, r->cpu, (unsigned long long)r->migrations);
+        if(spinUs_ > 0) {
+            // 自旋时间相对处理事件时间的占比：越高说明为了延迟付出的CPU越多
+            double spinMs = r->spinNs / 1e6, workMs = r->workNs / 1e6;
+            LOG_INFO("Stats reactor %d spin: spin=%.1fms work=%.1fms blocked=%.1fms spin/work=%.2f hits=%llu misses=%llu",
+                     r->id, spinMs, workMs, r->blockNs / 1e6, workMs > 0 ? spinMs / workMs : 0.0,
+                     (unsigned long long)r->spinHits, (unsigned long long)r->spinMisses);
+        }
+    }
+    if(threadpool_) {
+        for(int i = 0; i < threadpool_->ThreadCount(); i++) {
+            LOG_INFO("Stats worker %d: migrations=%llu", i, (unsigned long long)threadpool_->Migrations(i));
+        }
+    }
+    LOG_INFO("Stats log writer: migrations=%llu", (unsigned long long)Log::Instance()->WriterMigrations());
 }
 
-// 处理写事件，主要逻辑是将OnWrite加入线程池的任务队列中
-void WebServer::DealWrite_(HttpConn* client) {
+// 处理读事件，主要逻辑是将OnRead加入线程池的任务队列中；多reactor模式下直接在本线程处理
+// WebSocket连接的帧处理很轻，升级后都在reactor线程中处理，收件箱只由reactor线程排队（见WsKick_）
+void WebServer::DealRead_(Reactor* r, HttpConn* client, uint64_t tag) {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    client->SetIdle(false);
+    CountNode_(tag);
+    ExtentTime_(r, client);
+    client->SetWsInline();
+    if(inline_ || (client->WsInline() && !hybrid_)) {
+        OnRead_(r, tag);
+        return;
+    }
+    if(hybrid_ && !client->BodyHeld()) {
+        HybridRead_(r, client, tag);
+        return;
+    }
+    Offload_(r, tag, &WebServer::OnRead_);     // 混合模式中写盘或较长的请求体同样在线程池中读取
 }
 
-void WebServer::ExtentTime_(HttpConn* client) {
+// 处理写事件，主要逻辑是将OnWrite加入线程池的任务队列中；多reactor模式下直接在本线程处理
+void WebServer::DealWrite_(Reactor* r, HttpConn* client, uint64_t tag) {
     assert(client);
-    if(timeoutMS_ > 0) { timer_->adjust(client->GetFd(), timeoutMS_); }
+    client->SetIdle(false);
+    CountNode_(tag);
+    ExtentTime_(r, client);
+    // 混合模式下剩余内容在页缓存中时同样直接发送
+    client->SetWsInline();
+    if(inline_ || client->WsInline() || (hybrid_ && client->FileCached())) {
+        OnWrite_(r, tag);
+        return;
+    }
+    Offload_(r, tag, &WebServer::OnWrite_);
+}
+
+// 混合模式：在reactor线程读取与解析，能不阻塞地生成响应（文件已在页缓存中、错误页）时直接发送，
+// 省去线程池的加锁/唤醒与一次EPOLLOUT的epoll_ctl；只有会阻塞的处理函数（如访问数据库的登录/注册）和需要读磁盘的冷文件交给线程池
+void WebServer::HybridRead_(Reactor* r, HttpConn* client, uint64_t tag) {
+    int readErrno = 0;
+    int ret = client->read(&readErrno);
+    if(ret <= 0 && readErrno != EAGAIN) {
+        CloseConn_(r, client, tag);
+        return;
+    }
+    HybridProcess_(r, client, tag, true);
+}
+
+// 逐个处理读缓冲区中的流水线请求；遇到会阻塞的请求（登录/注册）时把它和之后的请求交给线程池，已排队的响应顺序不变。
+// writeNow为false时（上一批刚发完时接着处理）注册EPOLLOUT再发送，不在OnWrite_中递归
+void WebServer::HybridProcess_(Reactor* r, HttpConn* client, uint64_t tag, bool writeNow) {
+    if(!client->ParseRequest(true)) {
+        if(client->BodyHeld()) {
+            // 请求体要写盘（流式上传）或较长，不在reactor线程处理；100 Continue也由线程池发送
+            ServerStats::Add(ServerStats::Instance()->offloadBody);
+            Offload_(r, tag, &WebServer::OnBody_);
+            return;
+        }
+        if(client->ToWriteBytes() == 0) {
+            ArmRead_(r, client, tag);
+        } else if(writeNow) {
+            OnWrite_(r, tag);   // 100 Continue
+        } else {
+            r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, tag);
+        }
+        return;
+    }
+    ServerStats* stats = ServerStats::Instance();
+    int n = 0;
+    do {
+        if(client->NeedBlocking()) {
+            ServerStats::Add(stats->offloadVerify);
+            ServerStats::Add(stats->inlineRequests, n);
+            ServerStats::Add(stats->pipelined, n);    // 它之前的请求与它同批
+            Offload_(r, tag, &WebServer::OnRespond_);
+            return;
+        }
+        client->MakeResponse();
+        n++;
+    } while(client->ParseRequest(true));
+    ServerStats::Add(stats->pipelined, n - 1);
+    if(!client->FileCached()) {
+        ServerStats::Add(stats->offloadCold, n);
+        Offload_(r, tag, &WebServer::OnWrite_);
+        return;
+    }
+    ServerStats::Add(stats->inlineRequests, n);
+    if(writeNow) {
+        OnWrite_(r, tag);
+    } else {
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, tag);
+    }
+}
+
+// 线程池中处理reactor停在请求头之后的请求体，读缓冲区中已有的部分先处理，之后的由OnRead_读取
+void WebServer::OnBody_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
+    OnProcess(r, client, tag);
+}
+
+// 线程池中生成响应（访问数据库），连同之后的流水线请求一起发送
+void WebServer::OnRespond_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
+    client->MakeResponse();
+    ServerStats::Add(ServerStats::Instance()->pipelined, client->process());
+    OnWrite_(r, tag);
+}
+
+// 免重新注册模式：事件记入连接的状态字，取得连接时分发，连接正在被处理时由持有者重新检查
+void WebServer::EdgeEvent_(Reactor* r, HttpConn* client, uint64_t tag, uint32_t events) {
+    uint32_t bits = 0;
+    if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) { bits |= HttpConn::EDGE_HUP; }
+    if(events & EPOLLIN) { bits |= HttpConn::EDGE_READ; }
+    if(events & EPOLLOUT) { bits |= HttpConn::EDGE_WRITE; }
+    ServerStats* stats = ServerStats::Instance();
+    bool acquired = client->EdgeLatch(tag, bits);
+    if(!acquired && bits == HttpConn::EDGE_WRITE && !client->EdgeWantsWrite()) {
+        ServerStats::Add(stats->edgeIdleOut);
+        return;
+    }
+    ExtentTime_(r, client);
+    if(acquired) {
+        ServerStats::Add(stats->edgeDispatch);
+        EdgeRun_(r, tag);
+    } else {
+        ServerStats::Add(stats->edgeCoalesced);
+    }
+}
+
+// 调用者已取得连接
+void WebServer::EdgeRun_(Reactor* r, uint64_t tag) {
+    if(inline_) {
+        CountNode_(tag);
+        EdgeDrive_(r, tag);
+    } else {
+        Offload_(r, tag, &WebServer::EdgeDrive_);
+    }
+}
+
+// 持有者处理连接：读到的请求逐个处理并发送，直到没有新事件再释放；
+// 只有持有者会关闭连接，超时与优雅退出要先取得连接
+void WebServer::EdgeDrive_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
+    ServerStats* stats = ServerStats::Instance();
+    bool again = false;     // 上一个响应发完时读缓冲区中还有请求
+    while(again || !client->EdgeRelease()) {
+        again = false;
+        uint32_t events = client->EdgeTake();
+        if(events & HttpConn::EDGE_HUP) {
+            CloseConn_(r, client, tag);
+            return;
+        }
+        if((events & HttpConn::EDGE_READ) || client->ReadPaused()) {   // 上次读到窗口上限时接着读
+            client->SetIdle(false);
+            int readErrno = 0;
+            ssize_t ret = client->read(&readErrno);
+            if(ret <= 0 && readErrno != EAGAIN) {
+                CloseConn_(r, client, tag);
+                return;
+            }
+        }
+        if(client->ToWriteBytes() == 0) {
+            // 上一批响应发完才处理下一批请求
+            int n = client->process();
+            if(n == 0 && client->ToWriteBytes() == 0) {
+                again = client->ReadPaused();
+                continue;
+            }
+            if(n > 0) {
+                ServerStats::Add(inline_ ? stats->inlineRequests : stats->pooledRequests, n);
+                ServerStats::Add(stats->pipelined, n - 1);
+            }
+        } else if(client->EdgeWantsWrite() && !(events & HttpConn::EDGE_WRITE)) {
+            continue;   // 还在等可写
+        }
+        int writeErrno = 0;
+        ssize_t ret = client->write(&writeErrno);
+        if(client->ToWriteBytes() > 0) {
+            if(ret <= 0 && writeErrno != EAGAIN) {
+                CloseConn_(r, client, tag);
+                return;
+            }
+            client->EdgeWantWrite(true);
+            if(writeErrno == EAGAIN) {
+                ServerStats::Add(stats->writeEagain);   // 不会有新的可写事件之前不再尝试
+                continue;
+            }
+            // 窗口用完但套接字仍可写，ET不会再通知：继续持有连接，排到其他连接之后再发送
+            ServerStats::Add(stats->writeYield);
+            client->EdgeLatch(tag, HttpConn::EDGE_WRITE);
+            if(inline_) {
+                r->ready.push_back(tag);
+            } else {
+                Offload_(r, tag, &WebServer::EdgeDrive_);
+            }
+            return;
+        }
+        client->EdgeWantWrite(false);
+        if(!client->IsKeepAlive()) {
+            CloseConn_(r, client, tag);
+            return;
+        }
+        again = client->HasReadBytes();
+        client->SetIdle(!again);
+    }
 }
 
-void WebServer::OnRead_(HttpConn* client) {
+void WebServer::ExtentTime_(Reactor* r, HttpConn* client) {
     assert(client);
+    if(timeoutMS_ > 0) { r->timer->adjust(client->GetFd(), timeoutMS_); }
+}
+
+void WebServer::OnRead_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
     int ret = -1;
     int readErrno = 0;
     ret = client->read(&readErrno);         // 读取客户端套接字的数据，读到httpconn的读缓存区
     if(ret <= 0 && readErrno != EAGAIN) {   // 读异常就关闭客户端
-        CloseConn_(client);
+        CloseConn_(r, client, tag);
         return;
     }
     // 业务逻辑的处理（先读后处理）
-    OnProcess(client);
+    OnProcess(r, client, tag);
 }
 
 /* 处理读（请求）数据的函数 */
-void WebServer::OnProcess(HttpConn* client) {
-    // 首先调用process()进行逻辑处理
-    if(client->process()) { // 根据返回的信息重新将fd置为EPOLLOUT（写）或EPOLLIN（读）
+void WebServer::OnProcess(Reactor* r, HttpConn* client, uint64_t tag) {
+    // 首先调用process()进行逻辑处理，读缓冲区中的流水线请求一起处理
+    int n = client->process();
+    if(users_->Get(tag) != client) { return; }  // 处理期间连接已被关闭，fd可能已属于新连接
+    if(n > 0) { // 根据返回的信息重新将fd置为EPOLLOUT（写）或EPOLLIN（读）
+        ServerStats* stats = ServerStats::Instance();
+        ServerStats::Add(inline_ ? stats->inlineRequests : stats->pooledRequests, n);
+        ServerStats::Add(stats->pipelined, n - 1);
     //读完事件就跟内核说可以写了
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);    // 响应成功，修改监听事件为写,等待OnWrite_()发送
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, tag);    // 响应成功，修改监听事件为写,等待OnWrite_()发送
+    } else if(client->ToWriteBytes() > 0) {
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, tag);    // 请求体到达之前先发送100 Continue
     } else {
     //写完事件就跟内核说可以读了
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        ArmRead_(r, client, tag);
     }
 }
 
-void WebServer::OnWrite_(HttpConn* client) {
-    assert(client);
+// 线程池中刚升级为WebSocket的连接同时注册EPOLLOUT，立即触发一次可写事件，在reactor线程中接管它
+void WebServer::ArmRead_(Reactor* r, HttpConn* client, uint64_t tag) {
+    uint32_t events = connEvent_ | EPOLLIN;
+    if(!inline_ && client->IsWebSocket() && !client->WsInline()) { events |= EPOLLOUT; }
+    r->epoller->ModFd(client->GetFd(), events, tag);
+}
+
+void WebServer::OnWrite_(Reactor* r, uint64_t tag) {
+    HttpConn* client = users_->Get(tag);
+    if(!client) { return; }
     int ret = -1;
     int writeErrno = 0;
     ret = client->write(&writeErrno);
     if(client->ToWriteBytes() == 0) {
         /* 传输完成 */
         if(client->IsKeepAlive()) {
-            // OnProcess(client);
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN); // 回归换成监测读事件
+            if(client->HasReadBytes()) {
+                // 流水线中超过一批的请求已经在读缓冲区中，不会再有读事件，直接处理
+                if(hybrid_) { HybridProcess_(r, client, tag, false); }
+                else { OnProcess(r, client, tag); }
+                return;
+            }
+            client->SetIdle(true);  // 必须在重新注册之前，之后事件可能已被分发
+            ArmRead_(r, client, tag); // 回归换成监测读事件
             return;
         }
     }
-    else if(ret < 0) {
-        if(writeErrno == EAGAIN) {  // 缓冲区满了 
-            /* 继续传输 */
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
+    else if(ret > 0 || writeErrno == EAGAIN) {
+        // 窗口用完或缓冲区满（TCP_NOTSENT_LOWAT限制了内核中未发送的数据量）：让出线程，等下一次EPOLLOUT继续
+        ServerStats::Add(ret > 0 ? ServerStats::Instance()->writeYield : ServerStats::Instance()->writeEagain);
+        r->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, tag);
+        return;
+    }
+    CloseConn_(r, client, tag);
+}
+
+/* 本reactor的监听套接字与唤醒用的eventfd */
+bool WebServer::InitSocket_(Reactor* r) {
+    // 共享监听套接字的接入方式只由第0个reactor创建
+    if(r->id > 0 && acceptMode_ != ACCEPT_REUSEPORT) {
+        r->listenFd = reactors_[0]->listenFd;
+    } else if(!CreateListenFd_(r)) {
+        return false;
+    }
+    // 内核从SO_REUSEPORT组中优先选择SO_INCOMING_CPU与处理SYN的CPU相同的监听套接字
+    if(steerCpu_ && acceptMode_ == ACCEPT_REUSEPORT && r->cpu >= 0) {
+        if(setsockopt(r->listenFd, SOL_SOCKET, SO_INCOMING_CPU, &r->cpu, sizeof(r->cpu)) < 0) {
+            LOG_WARN("set SO_INCOMING_CPU error on reactor:%d", r->id);
+        }
+    }
+    // 新连接从监听套接字继承TCP_NOTSENT_LOWAT，内核发送队列中只保留少量未发送数据，大文件按可写事件分段发送
+    if(notsentLowat_ > 0 && (r->id == 0 || acceptMode_ == ACCEPT_REUSEPORT)) {
+        if(setsockopt(r->listenFd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &notsentLowat_, sizeof(notsentLowat_)) < 0) {
+            LOG_WARN("set TCP_NOTSENT_LOWAT error on reactor:%d", r->id);
         }
     }
-    CloseConn_(client);
+    r->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(r->wakeFd < 0) {
+        LOG_ERROR("Create eventfd error!");
+        return false;
+    }
+    if(!r->epoller) { return true; }    // io_uring：由UringLoop_提交多发accept与eventfd的poll
+    if(!r->epoller->AddFd(r->wakeFd, EPOLLIN)) {
+        LOG_ERROR("Add eventfd error!");
+        return false;
+    }
+    // 接入线程模式下reactor不监听，只等接入线程通过eventfd交来的连接
+    if(acceptMode_ == ACCEPT_THREAD) { return true; }
+    uint32_t events = listenEvent_ | EPOLLIN;
+    if(acceptMode_ == ACCEPT_EXCLUSIVE) {
+        // 新连接只唤醒一个reactor；EPOLLEXCLUSIVE不能与EPOLLRDHUP同时使用
+        events = (events & ~EPOLLRDHUP) | EPOLLEXCLUSIVE;
+    }
+    if(!r->epoller->AddFd(r->listenFd, events)) {  // 将监听套接字加入本reactor的epoller
+        LOG_ERROR("Add listen error!");
+        return false;
+    }
+    return true;
 }
 
 /* Create listenFd */
-bool WebServer::InitSocket_() {
+bool WebServer::CreateListenFd_(Reactor* r) {
+    // 优先使用从旧进程接过来的监听套接字，连接队列不中断
+    while(!inheritedFds_.empty()) {
+        int fd = inheritedFds_.front();
+        inheritedFds_.erase(inheritedFds_.begin());
+        struct sockaddr_in local;
+        socklen_t localLen = sizeof(local);
+        if(getsockname(fd, (struct sockaddr *)&local, &localLen) < 0 || ntohs(local.sin_port) != port_) {
+            close(fd);
+            continue;
+        }
+        r->listenFd = fd;
+        listen(fd, backlog_);   // 对已在监听的套接字再次listen只更新backlog
+        SetFdNonblock(fd);
+        return true;
+    }
     int ret;
     struct sockaddr_in addr;
     if(port_ > 65535 || port_ < 1024) {
@@ -235,15 +1175,15 @@ bool WebServer::InitSocket_() {
         optLinger.l_linger = 1;
     }
 
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if(listenFd_ < 0) {
+    r->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if(r->listenFd < 0) {
         LOG_ERROR("Create socket error!", port_);
         return false;
     }
 
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(r->listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if(ret < 0) {
-        close(listenFd_);
+        close(r->listenFd);
         LOG_ERROR("Init linger error!", port_);
         return false;
     }
@@ -252,36 +1192,40 @@ bool WebServer::InitSocket_() {
     int optval = 1;
     /* 端口复用 */
     /* 只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
+    ret = setsockopt(r->listenFd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval, sizeof(int));
     if(ret == -1) {
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
 
+    /* 多reactor：每个reactor绑定同一端口的独立监听套接字，由内核按四元组哈希把新连接分给各reactor */
+    if(loopNum_ > 0 && acceptMode_ == ACCEPT_REUSEPORT) {
+        ret = setsockopt(r->listenFd, SOL_SOCKET, SO_REUSEPORT, (const void*)&optval, sizeof(int));
+        if(ret == -1) {
+            LOG_ERROR("set SO_REUSEPORT error !");
+            close(r->listenFd);
+            return false;
+        }
+    }
+
     // 绑定
-    ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
+    ret = bind(r->listenFd, (struct sockaddr *)&addr, sizeof(addr));
     if(ret < 0) {
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
 
-    // 监听
-    ret = listen(listenFd_, 6);
+    // 监听，backlog过小会在连接风暴时丢弃SYN（实际长度还受net.core.somaxconn限制）
+    ret = listen(r->listenFd, backlog_);
     if(ret < 0) {
         LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
+        close(r->listenFd);
         return false;
     }
-    ret = epoller_->AddFd(listenFd_,  listenEvent_ | EPOLLIN);  // 将监听套接字加入epoller
-    if(ret == 0) {
-        LOG_ERROR("Add listen error!");
-        close(listenFd_);
-        return false;
-    }
-    SetFdNonblock(listenFd_);   
-    LOG_INFO("Server port:%d", port_);
+    SetFdNonblock(r->listenFd);
+    LOG_INFO("Server port:%d, reactor:%d", port_, r->id);
     return true;
 }
 
@@ -290,3 +1234,222 @@ int WebServer::SetFdNonblock(int fd) {
     assert(fd > 0);
     return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
 }
+
+/*
+io_uring事件循环：多发accept接收新连接，每个连接一个多发recv（数据放在缓冲环中），
+响应头与文件用一个sendmsg发送，短连接再链接shutdown与close；
+一次keep-alive的请求/响应只需要在下一次Wait时一起提交，不再需要readv、writev和两次epoll_ctl
+*/
+void WebServer::UringLoop_(Reactor* r) {
+    PinReactor_(r); // 先绑核，环与uconns的内存才会分配在本节点
+    IoUring ring;   // 环只能在使用它的线程中创建（SINGLE_ISSUER）
+    if(!ring.IsOk()) {
+        LOG_ERROR("io_uring init error on reactor:%d", r->id);
+        isClose_ = true;
+        return;
+    }
+    r->ring = &ring;
+    r->uconns.assign(MAX_FD, UringConn());
+    ring.PrepAcceptMultishot(r->listenFd, UringData_(URING_ACCEPT, 0));
+    ring.PrepPollAdd(r->wakeFd, POLLIN, UringData_(URING_WAKE, 0));
+
+    int timeMS = -1;
+    while(!isClose_) {
+        if(timeoutMS_ > 0) {
+            timeMS = r->timer->GetNextTick();
+        }
+        if(DrainStep_(r, &timeMS)) { break; }
+        int cqeCnt = ring.Wait(timeMS);
+        if(Affinity::Migrated(&r->lastCpu)) { r->migrations++; }
+        for(int i = 0; i < cqeCnt; i++) {
+            uint64_t data = ring.GetCqeData(i);
+            int res = ring.GetCqeRes(i);
+            uint32_t flags = ring.GetCqeFlags(i);
+            switch(data >> 56) {
+            case URING_ACCEPT:
+                UringAccept_(r, res, flags);
+                break;
+            case URING_RECV:
+                UringRecv_(r, data, res, flags);
+                break;
+            case URING_WAKE: {
+                uint64_t cnt;
+                ssize_t ret = read(r->wakeFd, &cnt, sizeof(cnt));
+                (void)ret;
+                ring.PrepPollAdd(r->wakeFd, POLLIN, UringData_(URING_WAKE, 0));
+                DealWsWakes_(r);
+                break;
+            }
+            case URING_CANCEL:
+                break;
+            default:
+                UringOpDone_(r, data, res);
+                break;
+            }
+        }
+        ring.CqeSeen(cqeCnt);
+    }
+    r->ring = nullptr;
+}
+
+// 由user_data找到连接，代数不一致（连接已关闭或fd已复用）返回nullptr
+HttpConn* WebServer::UringConnOf_(uint64_t data, uint64_t* tag) const {
+    int fd = ConnTable::TagFd(data);
+    if(fd < 0 || fd >= MAX_FD) { return nullptr; }
+    *tag = users_->Tag(fd);
+    if(((*tag ^ data) >> 32 & 0xFFFFFF) != 0) { return nullptr; }
+    return users_->Get(*tag);
+}
+
+void WebServer::UringAccept_(Reactor* r, int res, uint32_t flags) {
+    if(!(flags & IORING_CQE_F_MORE) && !r->draining) {
+        r->ring->PrepAcceptMultishot(r->listenFd, UringData_(URING_ACCEPT, 0));
+    }
+    if(res < 0) { return; }
+    int fd = res;
+    // 链尾的close已经释放fd并被新连接复用，但它的完成事件还没处理：先结束旧连接，否则连接数只增不减
+    uint64_t oldTag = users_->Tag(fd);
+    HttpConn* old = users_->Get(oldTag);
+    if(old && users_->Close(oldTag)) { old->OnClosed(); }
+    if(!AdmitConn_(fd)) { return; }
+    struct sockaddr_in addr = { 0 };
+    socklen_t len = sizeof(addr);
+    getpeername(fd, (struct sockaddr *)&addr, &len);
+
+    uint64_t tag = users_->Open(fd, r->id);
+    HttpConn* client = users_->Get(tag);
+    client->init(fd, addr);
+    if(timeoutMS_ > 0) {
+        r->timer->add(fd, timeoutMS_, std::bind(&WebServer::OnTimeout_, this, r, tag));
+    }
+    UringConn& uc = r->uconns[fd];
+    uc.pending = 0;
+    uc.recvArmed = true;
+    uc.closing = false;
+    uc.error = false;
+    r->ring->PrepRecvMultishot(fd, UringData_(URING_RECV, tag));
+    ServerStats::Add(ServerStats::Instance()->accepted);
+    CountSteer_(r, fd);
+}
+
+void WebServer::UringRecv_(Reactor* r, uint64_t data, int res, uint32_t flags) {
+    uint64_t tag;
+    HttpConn* client = UringConnOf_(data, &tag);
+    // 缓冲区无论连接是否有效都要放回缓冲环
+    if(flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if(client && res > 0) { client->OnRecv(r->ring->GetBuf(bid), res); }
+        r->ring->RecycleBuf(bid);
+    }
+    if(!client) { return; }
+    UringConn& uc = r->uconns[ConnTable::TagFd(tag)];
+    if(!(flags & IORING_CQE_F_MORE)) { uc.recvArmed = false; }
+    if(res == -ENOBUFS) {
+        // 缓冲环暂时用完，多发recv被终止，重新提交
+        uc.recvArmed = true;
+        r->ring->PrepRecvMultishot(client->GetFd(), UringData_(URING_RECV, tag));
+        return;
+    }
+    if(res <= 0) {
+        UringClose_(r, client, tag);
+        return;
+    }
+    client->SetIdle(false);
+    CountNode_(tag);
+    ExtentTime_(r, client);
+    if(!uc.recvArmed && !uc.closing) {
+        uc.recvArmed = true;
+        r->ring->PrepRecvMultishot(client->GetFd(), UringData_(URING_RECV, tag));
+    }
+    // 上一个响应还在发送时只缓存数据，发送完成后再处理
+    if(uc.pending == 0 && !uc.closing) {
+        UringProcess_(r, client, tag);
+    }
+}
+
+// 处理请求并把响应（响应头、文件）用一个sendmsg提交（与writev一样一次发出，避免两次send触发Nagle），
+// 短连接在其后链接shutdown与close
+void WebServer::UringProcess_(Reactor* r, HttpConn* client, uint64_t tag) {
+    int n = client->process();
+    if(n == 0 && client->ToWriteBytes() == 0) { return; }
+    if(n > 0) {
+        ServerStats::Add(ServerStats::Instance()->inlineRequests, n);
+        ServerStats::Add(ServerStats::Instance()->pipelined, n - 1);
+    }
+    UringSend_(r, client, tag);
+}
+
+// 每次最多提交sendWindow字节，完成后在UringOpDone_中提交下一段；短连接只在最后一段后链接shutdown与close
+void WebServer::UringSend_(Reactor* r, HttpConn* client, uint64_t tag) {
+    int fd = client->GetFd();
+    UringConn& uc = r->uconns[fd];
+    size_t window = HttpConn::sendWindow > 0 ? HttpConn::sendWindow : SIZE_MAX;
+    uc.iov.resize(HttpConn::MAX_IOV);
+    memset(&uc.msg, 0, sizeof(uc.msg));
+    uc.msg.msg_iovlen = client->GetIov(uc.iov.data(), HttpConn::MAX_IOV, window);
+    uc.msg.msg_iov = uc.iov.data();
+    size_t bytes = 0;
+    for(size_t i = 0; i < uc.msg.msg_iovlen; i++) { bytes += uc.iov[i].iov_len; }
+    bool last = bytes == client->ToWriteBytes();
+    bool keepAlive = client->IsKeepAlive() || !last;
+    r->ring->PrepSendmsg(fd, &uc.msg, UringData_(URING_SEND, tag), !keepAlive);
+    uc.pending++;
+    if(!last) { ServerStats::Add(ServerStats::Instance()->writeYield); }
+    if(!keepAlive) {
+        r->ring->PrepShutdown(fd, UringData_(URING_SHUTDOWN, tag), true);
+        r->ring->PrepClose(fd, UringData_(URING_CLOSE, tag));
+        uc.pending += 2;
+        uc.closing = true;
+    }
+}
+
+void WebServer::UringOpDone_(Reactor* r, uint64_t data, int res) {
+    uint64_t tag;
+    HttpConn* client = UringConnOf_(data, &tag);
+    if(!client) { return; }
+    UringConn& uc = r->uconns[ConnTable::TagFd(tag)];
+    assert(uc.pending > 0);
+    uc.pending--;
+    int op = data >> 56;
+    if(op == URING_CLOSE && res == 0) {
+        // 链尾的close已经关闭了fd
+        if(users_->Close(tag)) { client->OnClosed(); }
+        return;
+    }
+    if(op == URING_SEND && res > 0) {
+        client->OnSent(res);
+    }
+    if(res < 0 && op != URING_SHUTDOWN) {
+        uc.error = true;    // 出错或链中前一个操作失败（-ECANCELED）
+    }
+    if(uc.pending > 0) { return; }
+
+    if(uc.error || uc.closing) {
+        CloseConn_(r, client, tag);
+        return;
+    }
+    if(client->ToWriteBytes() > 0) {
+        UringSend_(r, client, tag);  // 下一段
+        return;
+    }
+    // keep-alive：发送期间收到的数据现在处理
+    if(client->HasReadBytes()) {
+        UringProcess_(r, client, tag);
+    } else {
+        client->SetIdle(true);
+    }
+}
+
+// 有在途操作时只shutdown，等操作全部完成后在UringOpDone_中关闭，
+// 否则链尾的close可能关掉已被新连接复用的fd
+void WebServer::UringClose_(Reactor* r, HttpConn* client, uint64_t tag) {
+    UringConn& uc = r->uconns[client->GetFd()];
+    if(uc.pending > 0) {
+        if(!uc.closing) {
+            uc.closing = true;
+            shutdown(client->GetFd(), SHUT_RDWR);
+        }
+        return;
+    }
+    CloseConn_(r, client, tag);
+}
@@ -14,14 +14,13 @@ void HeapTimer::SwapNode_(size_t i, size_t j)
 void HeapTimer::siftup_(size_t i) 
 {
     assert(i >= 0 && i < heap_.size());
-    size_t parent = (i-1) / 2;
-    while(parent >= 0) 
+    while(i > 0)    // 根结点没有父结点，size_t的(i-1)/2会越界
     {
+        size_t parent = (i-1) / 2;
         if(heap_[parent] > heap_[i]) 
         {
             SwapNode_(i, parent);
             i = parent;
-            parent = (i-1)/2;
         } 
         else break;
     }
@@ -131,8 +130,8 @@ void HeapTimer::tick()
         { 
             break; 
         }
+        pop();      // 先删除再回调，回调中可以为同一个id重新add
         node.cb();
-        pop();
     }
 }
 
@@ -1,5 +1,10 @@
+// 编译：g++ -std=c++17 -g -I code test.cpp $(ls code/*/*.cpp) -o test -pthread -lmysqlclient -lz
 #include "log/log.h"
 #include "pool/threadpool.h"
+#include "buffer/buffer.h"
+#include "http/httprequest.h"
+#include "http/hpack.h"
+#include <assert.h>
 #include <features.h>
 #include <iostream>
 
@@ -46,7 +51,119 @@ void TestThreadPool() {
     getchar();
 }
 
+// 按片段依次追加到读缓冲区，每追加一段解析一次，返回最后一次的结果
+HttpRequest::PARSE_RESULT ParsePieces(HttpRequest& req, Buffer& buff, std::initializer_list<std::string> pieces) {
+    HttpRequest::PARSE_RESULT res = HttpRequest::PARSE_AGAIN;
+    for(const std::string& piece: pieces) {
+        assert(res == HttpRequest::PARSE_AGAIN);
+        buff.Append(piece);
+        res = req.parse(buff);
+    }
+    return res;
+}
+
+void TestParser() {
+    {   // 请求在任意位置被拆开（包括\r与\n之间、请求体中间）到达
+        HttpRequest req;
+        Buffer buff;
+        auto res = ParsePieces(req, buff, { "POST /log", "in HTTP/1.1\r", "\nHost: a\r\nContent-Len", "gth: 7\r\n\r", "\nab", "c=1&d" });
+        assert(res == HttpRequest::PARSE_OK);
+        assert(req.method() == "POST" && req.path() == "/login" && req.version() == "1.1");
+        assert(req.GetHeader(HttpRequest::HOST) == "a" && req.GetHeader("content-length") == "7");
+        assert(req.body() == "abc=1&d");
+        assert(buff.ReadableBytes() == 0);
+    }
+    {   // 流水线：一次到达的多个请求逐个解析，剩下的留在读缓冲区中
+        HttpRequest req;
+        Buffer buff;
+        buff.Append(std::string("GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+                                "POST /b HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"
+                                "GET /c HTTP/1.0\r\n\r\nGET /d"));
+        assert(req.parse(buff) == HttpRequest::PARSE_OK && req.path() == "/a" && req.IsKeepAlive());
+        req.Init();
+        assert(req.parse(buff) == HttpRequest::PARSE_OK && req.path() == "/b" && req.body() == "abc");
+        req.Init();
+        assert(req.parse(buff) == HttpRequest::PARSE_OK && req.path() == "/c" && !req.IsKeepAlive());
+        req.Init();
+        assert(req.parse(buff) == HttpRequest::PARSE_AGAIN);
+        assert(ParsePieces(req, buff, { " HTTP/1.1\r\n\r\n" }) == HttpRequest::PARSE_OK && req.path() == "/d");
+    }
+    {   // 同时带有Content-Length与Transfer-Encoding：请求体长度有歧义，拒绝
+        HttpRequest req;
+        Buffer buff;
+        buff.Append(std::string("POST /a HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n"));
+        assert(req.parse(buff) == HttpRequest::PARSE_ERROR && req.ErrorCode() == 400);
+    }
+    {   // 请求头超过MAX_HEAD：不等空行到达就返回431
+        HttpRequest req;
+        Buffer buff;
+        buff.Append(std::string("GET /a HTTP/1.1\r\nX-Long: ") + std::string(HttpRequest::MAX_HEAD, 'a'));
+        assert(req.parse(buff) == HttpRequest::PARSE_ERROR && req.ErrorCode() == 431);
+    }
+    {   // 请求头个数超过MAX_HEADERS
+        HttpRequest req;
+        Buffer buff;
+        std::string head = "GET /a HTTP/1.1\r\n";
+        for(size_t i = 0; i <= HttpRequest::MAX_HEADERS; i++) { head += "X-" + std::to_string(i) + ": v\r\n"; }
+        buff.Append(head + "\r\n");
+        assert(req.parse(buff) == HttpRequest::PARSE_ERROR && req.ErrorCode() == 431);
+    }
+    {   // 请求行中的非法字节
+        HttpRequest req;
+        Buffer buff;
+        buff.Append(std::string("GET /a\x01 HTTP/1.1\r\n\r\n"));
+        assert(req.parse(buff) == HttpRequest::PARSE_ERROR && req.ErrorCode() == 400);
+    }
+}
+
+void TestHpack() {
+    {   // 编码的响应头解码后与原来相同
+        std::string block;
+        Hpack::EncodeStatus(200, &block);
+        Hpack::EncodeStatus(418, &block);
+        Hpack::EncodeField("content-type", "text/html", &block);
+        Hpack::EncodeField("x-custom", std::string(300, 'v'), &block);
+        Hpack::EncodeField("etag", "", &block);
+        Hpack decoder;
+        Hpack::HeaderList headers;
+        bool tooLarge = false;
+        assert(decoder.Decode((const uint8_t*)block.data(), block.size(), 1 << 16, &headers, &tooLarge) && !tooLarge);
+        Hpack::HeaderList expect = { { ":status", "200" }, { ":status", "418" }, { "content-type", "text/html" },
+                                     { "x-custom", std::string(300, 'v') }, { "etag", "" } };
+        assert(headers == expect);
+    }
+    {   // RFC 7541 C.4：同一连接上的三个请求，哈夫曼编码，后面的请求引用前面加入动态表的条目
+        static const char* BLOCKS[] = {
+            "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+            "828684be5886a8eb10649cbf",
+            "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+        };
+        Hpack::HeaderList expect[] = {
+            { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } },
+            { { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" },
+              { "cache-control", "no-cache" } },
+            { { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" },
+              { "custom-key", "custom-value" } },
+        };
+        Hpack decoder;
+        for(int i = 0; i < 3; i++) {
+            std::string hex = BLOCKS[i], block;
+            for(size_t j = 0; j < hex.size(); j += 2) { block += (char)std::stoi(hex.substr(j, 2), nullptr, 16); }
+            Hpack::HeaderList headers;
+            bool tooLarge = false;
+            assert(decoder.Decode((const uint8_t*)block.data(), block.size(), 1 << 16, &headers, &tooLarge));
+            assert(headers == expect[i]);
+        }
+        uint8_t bad[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f };  // 索引溢出
+        Hpack::HeaderList headers;
+        bool tooLarge = false;
+        assert(!decoder.Decode(bad, sizeof(bad), 1 << 16, &headers, &tooLarge));
+    }
+}
+
 int main() {
+    TestParser();
+    TestHpack();
     TestLog();
     // TestThreadPool();
 }